@@ -0,0 +1,147 @@
+#ifndef _ANDROID_APP_CMD_QUEUE_H
+#define _ANDROID_APP_CMD_QUEUE_H
+
+#include <sched.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The channel android_native_app_glue sends APP_CMD_* commands from the
+ * activity's threads to the app thread over, in place of a pipe.
+ *
+ * Commands go through a bounded lock free multi producer, single consumer
+ * ring (each slot carries a sequence number, so producers claim slots with
+ * one compare and swap and publish them in any order). The app thread still
+ * needs something it can sleep on in its ALooper, so the queue owns an
+ * eventfd that is only written when the queue goes from "nothing to read" to
+ * "something to read". A burst of commands costs one write, and the app
+ * thread reads the eventfd once when it has drained the queue, where a pipe
+ * costs a write and a read per command.
+ *
+ * Pure Linux, so it also builds on a desktop host (see src/bench.cpp).
+ */
+
+#define ANDROID_APP_CMD_QUEUE_LENGTH 64 /* Must be a power of two */
+
+struct android_app_cmd_slot {
+    uint32_t sequence;
+    int8_t cmd;
+};
+
+struct android_app_cmd_queue {
+    /* Readable whenever there may be commands to read, hand it to the looper */
+    int fd;
+
+    /* Set once the eventfd has been written, until the consumer drains */
+    uint32_t signaled;
+
+    __attribute__((aligned(64))) uint32_t head; /* Next slot to claim, producers */
+    __attribute__((aligned(64))) uint32_t tail; /* Next slot to read, consumer */
+
+    struct android_app_cmd_slot slots[ANDROID_APP_CMD_QUEUE_LENGTH];
+};
+
+/**
+ * Returns 0 on success, or -1 (with errno set) if the eventfd can't be made.
+ */
+static inline int android_app_cmd_queue_init(struct android_app_cmd_queue* queue) {
+    queue->signaled = 0;
+    queue->head = 0;
+    queue->tail = 0;
+    for (uint32_t i = 0; i < ANDROID_APP_CMD_QUEUE_LENGTH; i++) {
+        queue->slots[i].sequence = i;
+        queue->slots[i].cmd = 0;
+    }
+    queue->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return queue->fd >= 0 ? 0 : -1;
+}
+
+static inline void android_app_cmd_queue_destroy(struct android_app_cmd_queue* queue) {
+    if (queue->fd >= 0) {
+        close(queue->fd);
+    }
+    queue->fd = -1;
+}
+
+static inline void android_app_cmd_queue_signal(struct android_app_cmd_queue* queue) {
+    if (__atomic_exchange_n(&queue->signaled, 1, __ATOMIC_ACQ_REL) == 0) {
+        uint64_t one = 1;
+        ssize_t written = write(queue->fd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+/**
+ * Any thread. Only waits if the app thread has fallen a whole queue behind,
+ * where a pipe write would have blocked too.
+ */
+static inline void android_app_cmd_queue_push(struct android_app_cmd_queue* queue, int8_t cmd) {
+    struct android_app_cmd_slot* slot;
+    uint32_t pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    for (;;) {
+        slot = &queue->slots[pos & (ANDROID_APP_CMD_QUEUE_LENGTH - 1)];
+        uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(sequence - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->head, &pos, pos + 1, 1,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            sched_yield();
+            pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        }
+    }
+    slot->cmd = cmd;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+    android_app_cmd_queue_signal(queue);
+}
+
+static inline int android_app_cmd_queue_try_pop(struct android_app_cmd_queue* queue, int8_t* cmd) {
+    uint32_t pos = queue->tail;
+    struct android_app_cmd_slot* slot = &queue->slots[pos & (ANDROID_APP_CMD_QUEUE_LENGTH - 1)];
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != pos + 1) {
+        return 0;
+    }
+    *cmd = slot->cmd;
+    __atomic_store_n(&slot->sequence, pos + ANDROID_APP_CMD_QUEUE_LENGTH, __ATOMIC_RELEASE);
+    queue->tail = pos + 1;
+    return 1;
+}
+
+/**
+ * App thread only. Returns the oldest command, or -1 once the queue is empty,
+ * at which point the eventfd has been cleared until the next push.
+ */
+static inline int8_t android_app_cmd_queue_pop(struct android_app_cmd_queue* queue) {
+    int8_t cmd;
+    if (android_app_cmd_queue_try_pop(queue, &cmd)) {
+        return cmd;
+    }
+
+    /* Clear the eventfd, then look once more, a producer may have published
+     * before seeing the signal cleared. One that hasn't finished publishing
+     * yet sees it cleared and writes the eventfd again. */
+    uint64_t count;
+    ssize_t result = read(queue->fd, &count, sizeof(count));
+    (void)result;
+    __atomic_exchange_n(&queue->signaled, 0, __ATOMIC_ACQ_REL);
+    if (android_app_cmd_queue_try_pop(queue, &cmd)) {
+        android_app_cmd_queue_signal(queue);
+        return cmd;
+    }
+    return -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ANDROID_APP_CMD_QUEUE_H */
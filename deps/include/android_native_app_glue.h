@@ -26,6 +26,8 @@
 #include <android/looper.h>
 #include <android/native_activity.h>
 
+#include "android_app_cmd_queue.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -167,8 +169,7 @@ struct android_app {
     pthread_mutex_t mutex;
     pthread_cond_t cond;
 
-    int msgread;
-    int msgwrite;
+    struct android_app_cmd_queue cmdQueue;
 
     pthread_t thread;
 
@@ -313,7 +314,8 @@ enum {
 
 /**
  * Call when ALooper_pollAll() returns LOOPER_ID_MAIN, reading the next
- * app command message.
+ * app command message. Several commands can be waiting behind one wakeup,
+ * keep calling until it returns -1.
  */
 int8_t android_app_read_cmd(struct android_app* android_app);
 
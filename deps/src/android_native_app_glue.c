@@ -28,40 +28,17 @@
 
 #define APPNAME "questxrexample"
 
-#define LOGI(...) ((void)printf(__VA_ARGS__))
-#define LOGE(...) ((void)printf(__VA_ARGS__))
+#define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, APPNAME, __VA_ARGS__))
+#define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, APPNAME, __VA_ARGS__))
 
 /* For debug builds, always enable the debug traces in this library */
 
 #ifndef NDEBUG
-#  define LOGV(...)  ((void)printf(__VA_ARGS__))
+#  define LOGV(...)  ((void)__android_log_print(ANDROID_LOG_VERBOSE, APPNAME, __VA_ARGS__))
 #else
 #  define LOGV(...)  ((void)0)
 #endif
 
-static int pfd[2];
-pthread_t debug_capture_thread;
-static void * debug_capture_thread_fn( void * v )
-{
-	//struct android_app * app = (struct android_app*)v;
-    ssize_t readSize;
-    char buf[2048];
-
-    while((readSize = read(pfd[0], buf, sizeof buf - 1)) > 0) {
-        if(buf[readSize - 1] == '\n') {
-            --readSize;
-        }
-        buf[readSize] = 0;  // add null-terminator
-        __android_log_write(ANDROID_LOG_DEBUG, APPNAME, buf); // Set any log level you want
-#ifdef RDALOGFNCB
-		extern void RDALOGFNCB( int size, char * buf );
-		RDALOGFNCB( readSize, buf );
-#endif
-		//if( debug_capture_hook_function ) debug_capture_hook_function( readSize, buf );
-    }
-    return 0;
-}
-
 static void free_saved_state(struct android_app* android_app) {
     pthread_mutex_lock(&android_app->mutex);
     if (android_app->savedState != NULL) {
@@ -73,18 +50,13 @@ static void free_saved_state(struct android_app* android_app) {
 }
 
 int8_t android_app_read_cmd(struct android_app* android_app) {
-    int8_t cmd;
-    if (read(android_app->msgread, &cmd, sizeof(cmd)) == sizeof(cmd)) {
-        switch (cmd) {
-            case APP_CMD_SAVE_STATE:
-                free_saved_state(android_app);
-                break;
-        }
-        return cmd;
-    } else {
-        LOGE("No data on command pipe!");
+    int8_t cmd = android_app_cmd_queue_pop(&android_app->cmdQueue);
+    switch (cmd) {
+        case APP_CMD_SAVE_STATE:
+            free_saved_state(android_app);
+            break;
     }
-    return -1;
+    return cmd;
 }
 
 static void print_cur_config(struct android_app* android_app) {
@@ -227,11 +199,14 @@ static void process_input(struct android_app* app, struct android_poll_source* s
     }
 }
 
+// Everything queued since the last wakeup
 static void process_cmd(struct android_app* app, struct android_poll_source* source) {
-    int8_t cmd = android_app_read_cmd(app);
-    android_app_pre_exec_cmd(app, cmd);
-    if (app->onAppCmd != NULL) app->onAppCmd(app, cmd);
-    android_app_post_exec_cmd(app, cmd);
+    int8_t cmd;
+    while ((cmd = android_app_read_cmd(app)) >= 0) {
+        android_app_pre_exec_cmd(app, cmd);
+        if (app->onAppCmd != NULL) app->onAppCmd(app, cmd);
+        android_app_post_exec_cmd(app, cmd);
+    }
 }
 
 static void* android_app_entry(void* param) {
@@ -250,7 +225,7 @@ static void* android_app_entry(void* param) {
     android_app->inputPollSource.process = process_input;
 
     ALooper* looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
-    ALooper_addFd(looper, android_app->msgread, LOOPER_ID_MAIN, ALOOPER_EVENT_INPUT, NULL,
+    ALooper_addFd(looper, android_app->cmdQueue.fd, LOOPER_ID_MAIN, ALOOPER_EVENT_INPUT, NULL,
             &android_app->cmdPollSource);
     android_app->looper = looper;
 
@@ -279,33 +254,18 @@ static struct android_app* android_app_create(ANativeActivity* activity,
     pthread_cond_init(&android_app->cond, NULL);
 
 
-    pthread_attr_t attr; 
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-
-	//Capture input
-    setvbuf(stdout, 0, _IOLBF, 0); // make stdout line-buffered
-    setvbuf(stderr, 0, _IONBF, 0); // make stderr unbuffered
-    pipe(pfd);
-    dup2(pfd[1], 1);
-    dup2(pfd[1], 2);
-    pthread_create(&debug_capture_thread, &attr, debug_capture_thread_fn, android_app);
-
-
     if (savedState != NULL) {
         android_app->savedState = malloc(savedStateSize);
         android_app->savedStateSize = savedStateSize;
         memcpy(android_app->savedState, savedState, savedStateSize);
     }
 
-    int msgpipe[2];
-    if (pipe(msgpipe)) {
-        LOGE("could not create pipe: %s", strerror(errno));
+    if (android_app_cmd_queue_init(&android_app->cmdQueue)) {
+        LOGE("could not create command eventfd: %s", strerror(errno));
         return NULL;
     }
-    android_app->msgread = msgpipe[0];
-    android_app->msgwrite = msgpipe[1];
 
+    pthread_attr_t attr;
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
     pthread_create(&android_app->thread, &attr, android_app_entry, android_app);
@@ -321,9 +281,7 @@ static struct android_app* android_app_create(ANativeActivity* activity,
 }
 
 static void android_app_write_cmd(struct android_app* android_app, int8_t cmd) {
-    if (write(android_app->msgwrite, &cmd, sizeof(cmd)) != sizeof(cmd)) {
-        LOGE("Failure writing android_app cmd: %s\n", strerror(errno));
-    }
+    android_app_cmd_queue_push(&android_app->cmdQueue, cmd);
 }
 
 static void android_app_set_input(struct android_app* android_app, AInputQueue* inputQueue) {
@@ -368,8 +326,7 @@ static void android_app_free(struct android_app* android_app) {
     }
     pthread_mutex_unlock(&android_app->mutex);
 
-    close(android_app->msgread);
-    close(android_app->msgwrite);
+    android_app_cmd_queue_destroy(&android_app->cmdQueue);
     pthread_cond_destroy(&android_app->cond);
     pthread_mutex_destroy(&android_app->mutex);
     free(android_app);
@@ -0,0 +1,749 @@
+// Host side benchmarks and cross-checks for the pieces of the app that don't need a headset.
+//
+// Build and run on a plain Linux (or macOS) box with something like:
+//
+//     g++ -O2 -Isrc -Ideps/include src/bench.cpp src/jobs.cpp src/log.cpp -o build/bench -lpthread && ./build/bench
+//
+// Exits non-zero if any of the cross-checks fail.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jobs.h"
+#include "matrix.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <pthread.h>
+#include "android_app_cmd_queue.h"
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// HELPERS
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int failures = 0;
+
+// Defeats dead code elimination of benchmark results
+static volatile float sink;
+
+static uint64_t now_ns() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t rng_state = 0x12345678;
+static float random_float(float lo, float hi) {
+        rng_state ^= rng_state << 13;
+        rng_state ^= rng_state >> 17;
+        rng_state ^= rng_state << 5;
+        return lo + (hi - lo) * (float)(rng_state & 0xffffff) / (float)0xffffff;
+}
+
+static void random_quat(float *q) {
+        float len = 0.0f;
+        while (len < 0.01f) {
+                for (int i = 0; i < 4; i++) { q[i] = random_float(-1.0f, 1.0f); }
+                len = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        }
+        for (int i = 0; i < 4; i++) { q[i] /= len; }
+}
+
+static void random_pose(XrPosef *pose) {
+        random_quat((float *)&pose->orientation);
+        pose->position.x = random_float(-2.0f, 2.0f);
+        pose->position.y = random_float(-2.0f, 2.0f);
+        pose->position.z = random_float(-2.0f, 2.0f);
+}
+
+// The old translation * rotation path from the render loop
+static void pose_to_matrix_reference(float *result, const XrPosef *pose) {
+        float translation[16];
+        float rotation[16];
+        matrix_identity_scalar(translation);
+        matrix_translate_scalar(translation, translation, (const float *)&pose->position);
+        matrix_rotation_from_quat_scalar(rotation, (const float *)&pose->orientation);
+        matrix_multiply_scalar(result, translation, rotation);
+}
+
+// Well conditioned but otherwise arbitrary matrix
+static void random_matrix(float *m) {
+        for (int i = 0; i < 16; i++) { m[i] = random_float(-1.0f, 1.0f); }
+        m[0] += 4.0f;
+        m[5] += 4.0f;
+        m[10] += 4.0f;
+        m[15] += 4.0f;
+}
+
+// Arbitrary matrix with a (0, 0, 0, 1) bottom row
+static void random_affine(float *m) {
+        random_matrix(m);
+        m[3] = 0.0f;
+        m[7] = 0.0f;
+        m[11] = 0.0f;
+        m[15] = 1.0f;
+}
+
+static float max_rel_error(const float *expected, const float *actual, int count) {
+        float max_error = 0.0f;
+        for (int i = 0; i < count; i++) {
+                float scale = fmaxf(1.0f, fabsf(expected[i]));
+                max_error = fmaxf(max_error, fabsf(expected[i] - actual[i]) / scale);
+        }
+        return max_error;
+}
+
+static void check_report(const char *name, float max_error, float tolerance) {
+        bool ok = max_error <= tolerance;
+        printf("        %-40s max rel error %.3g %s\n", name, max_error, ok ? "ok" : "FAILED");
+        if (!ok) { failures++; }
+}
+
+#define BENCH_ITERATIONS (1000000)
+#define BENCH_SET_SIZE (256)
+
+// Runs body BENCH_ITERATIONS times and prints the average time per iteration
+#define BENCH(name, body)                                                                          \
+        do {                                                                                       \
+                uint64_t start = now_ns();                                                         \
+                for (int iter = 0; iter < BENCH_ITERATIONS; iter++) {                              \
+                        int idx = iter & (BENCH_SET_SIZE - 1);                                     \
+                        (void)idx;                                                                 \
+                        body;                                                                      \
+                }                                                                                  \
+                uint64_t elapsed = now_ns() - start;                                               \
+                printf("        %-40s %7.2f ns/op\n", name, (double)elapsed / BENCH_ITERATIONS);   \
+        } while (0)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// MATRIX
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void matrix_cross_check() {
+        printf("Matrix cross-check (%s):\n",
+#if defined(MATRIX_NEON)
+                "neon"
+#elif defined(MATRIX_SSE)
+                "sse"
+#else
+                "scalar"
+#endif
+        );
+
+        float identity_error = 0.0f;
+        float translate_error = 0.0f;
+        float rotation_error = 0.0f;
+        float multiply_error = 0.0f;
+        float multiply_aliased_error = 0.0f;
+        float inverse_error = 0.0f;
+        for (int n = 0; n < 1000; n++) {
+                float m0[16], m1[16], q[4], v[4], expected[16], actual[16];
+                random_matrix(m0);
+                random_matrix(m1);
+                random_quat(q);
+                for (int i = 0; i < 4; i++) { v[i] = random_float(-10.0f, 10.0f); }
+
+                matrix_identity_scalar(expected);
+                matrix_identity(actual);
+                identity_error = fmaxf(identity_error, max_rel_error(expected, actual, 16));
+
+                matrix_translate_scalar(expected, m0, v);
+                matrix_translate(actual, m0, v);
+                translate_error = fmaxf(translate_error, max_rel_error(expected, actual, 16));
+
+                matrix_rotation_from_quat_scalar(expected, q);
+                matrix_rotation_from_quat(actual, q);
+                rotation_error = fmaxf(rotation_error, max_rel_error(expected, actual, 16));
+
+                matrix_multiply_scalar(expected, m0, m1);
+                matrix_multiply(actual, m0, m1);
+                multiply_error = fmaxf(multiply_error, max_rel_error(expected, actual, 16));
+
+                // Aliased output, as used by the render loop
+                memcpy(actual, m0, sizeof(actual));
+                matrix_multiply(actual, actual, m1);
+                multiply_aliased_error = fmaxf(multiply_aliased_error, max_rel_error(expected, actual, 16));
+
+                matrix_inverse_scalar(expected, m0);
+                matrix_inverse(actual, m0);
+                inverse_error = fmaxf(inverse_error, max_rel_error(expected, actual, 16));
+        }
+
+        check_report("matrix_identity", identity_error, 0.0f);
+        check_report("matrix_translate", translate_error, 1e-6f);
+        check_report("matrix_rotation_from_quat", rotation_error, 1e-5f);
+        check_report("matrix_multiply", multiply_error, 1e-5f);
+        check_report("matrix_multiply (aliased)", multiply_aliased_error, 1e-5f);
+        check_report("matrix_inverse", inverse_error, 1e-4f);
+}
+
+static void matrix_inverse_cross_check() {
+        float rigid_error = 0.0f;
+        float rigid_scalar_error = 0.0f;
+        float affine_error = 0.0f;
+        float affine_scalar_error = 0.0f;
+        float auto_error = 0.0f;
+        float view_error = 0.0f;
+        for (int n = 0; n < 1000; n++) {
+                XrPosef pose;
+                float rigid[16], affine[16], general[16], expected[16], actual[16];
+                random_pose(&pose);
+                pose_to_matrix_reference(rigid, &pose);
+                random_affine(affine);
+                random_matrix(general);
+
+                matrix_inverse_scalar(expected, rigid);
+                matrix_inverse_rigid(actual, rigid);
+                rigid_error = fmaxf(rigid_error, max_rel_error(expected, actual, 16));
+                matrix_inverse_rigid_scalar(actual, rigid);
+                rigid_scalar_error = fmaxf(rigid_scalar_error, max_rel_error(expected, actual, 16));
+
+                matrix_view_from_pose(actual, &pose);
+                view_error = fmaxf(view_error, max_rel_error(expected, actual, 16));
+
+                matrix_inverse_scalar(expected, affine);
+                matrix_inverse_affine(actual, affine);
+                affine_error = fmaxf(affine_error, max_rel_error(expected, actual, 16));
+                matrix_inverse_affine_scalar(actual, affine);
+                affine_scalar_error = fmaxf(affine_scalar_error, max_rel_error(expected, actual, 16));
+                matrix_inverse_auto(actual, affine);
+                auto_error = fmaxf(auto_error, max_rel_error(expected, actual, 16));
+
+                matrix_inverse_scalar(expected, general);
+                matrix_inverse_auto(actual, general);
+                auto_error = fmaxf(auto_error, max_rel_error(expected, actual, 16));
+        }
+
+        check_report("matrix_inverse_rigid", rigid_error, 1e-5f);
+        check_report("matrix_inverse_rigid_scalar", rigid_scalar_error, 1e-5f);
+        check_report("matrix_inverse_affine", affine_error, 1e-5f);
+        check_report("matrix_inverse_affine_scalar", affine_scalar_error, 1e-5f);
+        check_report("matrix_inverse_auto", auto_error, 1e-4f);
+        check_report("matrix_view_from_pose", view_error, 1e-5f);
+}
+
+static void matrix_pose_cross_check() {
+        // Not a multiple of four, so the batched path's tail gets exercised too
+        const int count = 1003;
+        static XrPosef poses[count];
+        static float expected[count][16];
+        static float actual[count][16];
+        for (int i = 0; i < count; i++) {
+                random_pose(&poses[i]);
+                pose_to_matrix_reference(expected[i], &poses[i]);
+        }
+
+        float model_error = 0.0f;
+        for (int i = 0; i < count; i++) {
+                matrix_model_from_pose(actual[i], &poses[i]);
+                model_error = fmaxf(model_error, max_rel_error(expected[i], actual[i], 16));
+        }
+        check_report("matrix_model_from_pose", model_error, 1e-5f);
+
+        memset(actual, 0, sizeof(actual));
+        matrix_model_from_poses(&actual[0][0], poses, count);
+        check_report("matrix_model_from_poses", max_rel_error(&expected[0][0], &actual[0][0], count * 16), 1e-5f);
+
+        // The same poses as a structure of arrays, rows padded past count like the pose cache's
+        const int stride = count + 5;
+        static float soa[MATRIX_POSE_COMPONENTS * stride];
+        for (int i = 0; i < count; i++) {
+                soa[MATRIX_POSE_QX * stride + i] = poses[i].orientation.x;
+                soa[MATRIX_POSE_QY * stride + i] = poses[i].orientation.y;
+                soa[MATRIX_POSE_QZ * stride + i] = poses[i].orientation.z;
+                soa[MATRIX_POSE_QW * stride + i] = poses[i].orientation.w;
+                soa[MATRIX_POSE_PX * stride + i] = poses[i].position.x;
+                soa[MATRIX_POSE_PY * stride + i] = poses[i].position.y;
+                soa[MATRIX_POSE_PZ * stride + i] = poses[i].position.z;
+        }
+        memset(actual, 0, sizeof(actual));
+        matrix_model_from_poses_soa(&actual[0][0], soa, stride, count);
+        check_report("matrix_model_from_poses_soa", max_rel_error(&expected[0][0], &actual[0][0], count * 16), 1e-5f);
+}
+
+static void matrix_bench() {
+        static float as[BENCH_SET_SIZE][16];
+        static float bs[BENCH_SET_SIZE][16];
+        static float qs[BENCH_SET_SIZE][4];
+        static float out[16];
+        for (int i = 0; i < BENCH_SET_SIZE; i++) {
+                random_matrix(as[i]);
+                random_matrix(bs[i]);
+                random_quat(qs[i]);
+        }
+
+        printf("Matrix benchmarks:\n");
+        BENCH("matrix_multiply_scalar", matrix_multiply_scalar(out, as[idx], bs[idx]); sink = out[0]);
+        BENCH("matrix_multiply", matrix_multiply(out, as[idx], bs[idx]); sink = out[0]);
+        BENCH("matrix_inverse_scalar", matrix_inverse_scalar(out, as[idx]); sink = out[0]);
+        BENCH("matrix_inverse", matrix_inverse(out, as[idx]); sink = out[0]);
+        BENCH("matrix_rotation_from_quat_scalar", matrix_rotation_from_quat_scalar(out, qs[idx]); sink = out[0]);
+        BENCH("matrix_rotation_from_quat", matrix_rotation_from_quat(out, qs[idx]); sink = out[0]);
+        BENCH("matrix_translate_scalar", matrix_translate_scalar(out, as[idx], qs[idx]); sink = out[12]);
+        BENCH("matrix_translate", matrix_translate(out, as[idx], qs[idx]); sink = out[12]);
+}
+
+static void matrix_inverse_bench() {
+        static XrPosef poses[BENCH_SET_SIZE];
+        static float rigids[BENCH_SET_SIZE][16];
+        static float affines[BENCH_SET_SIZE][16];
+        static float out[16];
+        for (int i = 0; i < BENCH_SET_SIZE; i++) {
+                random_pose(&poses[i]);
+                pose_to_matrix_reference(rigids[i], &poses[i]);
+                random_affine(affines[i]);
+        }
+
+        printf("Inverse benchmarks:\n");
+        BENCH("matrix_inverse_scalar (rigid input)", matrix_inverse_scalar(out, rigids[idx]); sink = out[0]);
+        BENCH("matrix_inverse (rigid input)", matrix_inverse(out, rigids[idx]); sink = out[0]);
+        BENCH("matrix_inverse_affine", matrix_inverse_affine(out, affines[idx]); sink = out[0]);
+        BENCH("matrix_inverse_auto (affine input)", matrix_inverse_auto(out, affines[idx]); sink = out[0]);
+        BENCH("matrix_inverse_rigid", matrix_inverse_rigid(out, rigids[idx]); sink = out[0]);
+
+        // The whole per-eye view matrix setup, before and after
+        BENCH("view: pose -> matrix -> inverse (old)", {
+                pose_to_matrix_reference(out, &poses[idx]);
+                matrix_inverse_scalar(out, out);
+                sink = out[0];
+        });
+        BENCH("view: matrix_view_from_pose", matrix_view_from_pose(out, &poses[idx]); sink = out[0]);
+}
+
+static void matrix_pose_bench() {
+        static XrPosef poses[BENCH_SET_SIZE];
+        static float out[BENCH_SET_SIZE][16];
+        for (int i = 0; i < BENCH_SET_SIZE; i++) {
+                random_pose(&poses[i]);
+        }
+
+        printf("Pose to matrix benchmarks (per pose):\n");
+        BENCH("model: identity/translate/rotate/multiply", pose_to_matrix_reference(out[idx], &poses[idx]); sink = out[idx][0]);
+        BENCH("model: matrix_model_from_pose", matrix_model_from_pose(out[idx], &poses[idx]); sink = out[idx][0]);
+
+        // Same number of poses converted, in batches of the whole set
+        uint64_t start = now_ns();
+        for (int iter = 0; iter < BENCH_ITERATIONS; iter += BENCH_SET_SIZE) {
+                matrix_model_from_poses(&out[0][0], poses, BENCH_SET_SIZE);
+                sink = out[iter & (BENCH_SET_SIZE - 1)][0];
+        }
+        uint64_t elapsed = now_ns() - start;
+        printf("        %-40s %7.2f ns/op\n", "model: matrix_model_from_poses", (double)elapsed / BENCH_ITERATIONS);
+
+        static float soa[MATRIX_POSE_COMPONENTS][BENCH_SET_SIZE];
+        for (int i = 0; i < BENCH_SET_SIZE; i++) {
+                soa[MATRIX_POSE_QX][i] = poses[i].orientation.x;
+                soa[MATRIX_POSE_QY][i] = poses[i].orientation.y;
+                soa[MATRIX_POSE_QZ][i] = poses[i].orientation.z;
+                soa[MATRIX_POSE_QW][i] = poses[i].orientation.w;
+                soa[MATRIX_POSE_PX][i] = poses[i].position.x;
+                soa[MATRIX_POSE_PY][i] = poses[i].position.y;
+                soa[MATRIX_POSE_PZ][i] = poses[i].position.z;
+        }
+        start = now_ns();
+        for (int iter = 0; iter < BENCH_ITERATIONS; iter += BENCH_SET_SIZE) {
+                matrix_model_from_poses_soa(&out[0][0], &soa[0][0], BENCH_SET_SIZE, BENCH_SET_SIZE);
+                sink = out[iter & (BENCH_SET_SIZE - 1)][0];
+        }
+        elapsed = now_ns() - start;
+        printf("        %-40s %7.2f ns/op\n", "model: matrix_model_from_poses_soa", (double)elapsed / BENCH_ITERATIONS);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// JOBS
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define JOBS_BENCH_OBJECTS (16384)
+#define JOBS_BENCH_BATCH (256)
+#define JOBS_BENCH_FRAMES (200)
+
+// Synthetic per-frame transform work: spin every object about its own y axis, build its model
+// matrix and multiply it by a view_proj, like the render loop does for every box
+struct jobs_bench_scene_t {
+        const XrPosef *poses;
+        const float *view_proj;
+        float time;
+        float (*mvps)[16];
+};
+
+static void jobs_bench_transform(void *data, int begin, int end) {
+        const jobs_bench_scene_t *scene = (const jobs_bench_scene_t *)data;
+        for (int i = begin; i < end; i++) {
+                float half_angle = 0.5f * (scene->time + 0.001f * (float)i);
+                XrQuaternionf spin = { 0.0f, sinf(half_angle), 0.0f, cosf(half_angle) };
+                const XrQuaternionf *q = &scene->poses[i].orientation;
+                XrPosef pose;
+                pose.orientation.x = spin.w * q->x + spin.x * q->w + spin.y * q->z - spin.z * q->y;
+                pose.orientation.y = spin.w * q->y - spin.x * q->z + spin.y * q->w + spin.z * q->x;
+                pose.orientation.z = spin.w * q->z + spin.x * q->y - spin.y * q->x + spin.z * q->w;
+                pose.orientation.w = spin.w * q->w - spin.x * q->x - spin.y * q->y - spin.z * q->z;
+                pose.position = scene->poses[i].position;
+                float model[16];
+                matrix_model_from_pose(model, &pose);
+                matrix_multiply(scene->mvps[i], scene->view_proj, model);
+        }
+}
+
+// Every index of a parallel_for visited exactly once
+static void jobs_bench_mark(void *data, int begin, int end) {
+        std::atomic<int32_t> *marks = (std::atomic<int32_t> *)data;
+        for (int i = begin; i < end; i++) {
+                marks[i].fetch_add(1, std::memory_order_relaxed);
+        }
+}
+
+// Jobs of a diamond graph A -> (B, C) -> D stamp the order they ran in, each with a few children
+struct jobs_bench_graph_t {
+        std::atomic<int32_t> clock;
+        std::atomic<int32_t> child_runs;
+        int32_t stamps[4];
+};
+
+static void jobs_bench_child(jobs_t *jobs, job_t *job, void *data) {
+        jobs_bench_graph_t *graph = *(jobs_bench_graph_t **)data;
+        graph->child_runs.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void jobs_bench_node(jobs_t *jobs, job_t *job, void *data) {
+        jobs_bench_graph_t *graph = *(jobs_bench_graph_t **)data;
+        int node = *(int *)((char *)data + sizeof(graph));
+        graph->stamps[node] = graph->clock.fetch_add(1, std::memory_order_relaxed);
+        for (int i = 0; i < 4; i++) {
+                jobs_submit(jobs, jobs_create_with_payload(jobs, job, jobs_bench_child, &graph, sizeof(graph)));
+        }
+}
+
+static void jobs_cross_check(jobs_t *jobs) {
+        printf("Job system cross-check (%d threads):\n", jobs->thread_count);
+
+        // Parallel transforms match the same transforms done serially
+        static XrPosef poses[JOBS_BENCH_OBJECTS];
+        static float expected[JOBS_BENCH_OBJECTS][16];
+        static float actual[JOBS_BENCH_OBJECTS][16];
+        float view_proj[16];
+        for (int i = 0; i < JOBS_BENCH_OBJECTS; i++) {
+                random_pose(&poses[i]);
+        }
+        random_matrix(view_proj);
+        jobs_bench_scene_t scene = { poses, view_proj, 1.0f, expected };
+        jobs_bench_transform(&scene, 0, JOBS_BENCH_OBJECTS);
+        scene.mvps = actual;
+        jobs_parallel_for(jobs, JOBS_BENCH_OBJECTS, 64, jobs_bench_transform, &scene);
+        check_report("jobs_parallel_for transforms", max_rel_error(&expected[0][0], &actual[0][0], JOBS_BENCH_OBJECTS * 16), 0.0f);
+
+        // Batches of one, so the pool's rings wrap many times over
+        static std::atomic<int32_t> marks[100000];
+        jobs_parallel_for(jobs, 100000, 1, jobs_bench_mark, marks);
+        int bad_marks = 0;
+        for (int i = 0; i < 100000; i++) {
+                if (marks[i].load(std::memory_order_relaxed) != 1) { bad_marks++; }
+        }
+        printf("        %-40s %d indices not run once %s\n", "jobs_parallel_for batch 1", bad_marks, bad_marks ? "FAILED" : "ok");
+        if (bad_marks) { failures++; }
+
+        // Dependencies and children, many times over to shake out races
+        int bad_graphs = 0;
+        for (int iter = 0; iter < 2000; iter++) {
+                jobs_bench_graph_t graph;
+                graph.clock.store(0, std::memory_order_relaxed);
+                graph.child_runs.store(0, std::memory_order_relaxed);
+                job_t *nodes[4];
+                for (int n = 0; n < 4; n++) {
+                        struct { jobs_bench_graph_t *graph; int node; } payload = { &graph, n };
+                        nodes[n] = jobs_create_with_payload(jobs, NULL, jobs_bench_node, &payload, sizeof(payload));
+                }
+                jobs_add_dependency(nodes[1], nodes[0]);
+                jobs_add_dependency(nodes[2], nodes[0]);
+                jobs_add_dependency(nodes[3], nodes[1]);
+                jobs_add_dependency(nodes[3], nodes[2]);
+                for (int n = 3; n >= 0; n--) {
+                        jobs_submit(jobs, nodes[n]);
+                }
+                jobs_wait(jobs, nodes[3]);
+
+                // A node only finishes once its children have, so waiting on D covers every job
+                bool is_ordered = graph.stamps[0] < graph.stamps[1] && graph.stamps[0] < graph.stamps[2] &&
+                                  graph.stamps[1] < graph.stamps[3] && graph.stamps[2] < graph.stamps[3];
+                if (!is_ordered || graph.child_runs.load(std::memory_order_relaxed) != 16) { bad_graphs++; }
+        }
+        printf("        %-40s %d of 2000 out of order %s\n", "jobs task graph", bad_graphs, bad_graphs ? "FAILED" : "ok");
+        if (bad_graphs) { failures++; }
+}
+
+// Frame time of the synthetic transform workload from 1 thread up to one per core (at least 4, so
+// oversubscription shows up on small machines)
+static void jobs_bench() {
+        static XrPosef poses[JOBS_BENCH_OBJECTS];
+        static float mvps[JOBS_BENCH_OBJECTS][16];
+        float view_proj[16];
+        for (int i = 0; i < JOBS_BENCH_OBJECTS; i++) {
+                random_pose(&poses[i]);
+        }
+        random_matrix(view_proj);
+
+        int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        int max_threads = cores > 4 ? cores : 4;
+        if (max_threads > JOBS_MAX_THREADS) { max_threads = JOBS_MAX_THREADS; }
+
+        // Cross-check on a pool of its own first, so its report doesn't land inside the scaling table
+        {
+                jobs_config_t config;
+                jobs_default_config(&config, 0);
+                config.worker_count = max_threads - 1;
+                jobs_t jobs;
+                jobs_init(&jobs, &config);
+                jobs_cross_check(&jobs);
+                jobs_shutdown(&jobs);
+        }
+
+        printf("Job system scaling (%d objects, batches of %d, %d cores):\n", JOBS_BENCH_OBJECTS, JOBS_BENCH_BATCH, cores);
+        double single_ms = 0.0;
+        for (int threads = 1; threads <= max_threads; threads++) {
+                jobs_config_t config;
+                jobs_default_config(&config, 0);
+                config.worker_count = threads - 1;
+                jobs_t jobs;
+                jobs_init(&jobs, &config);
+
+                jobs_bench_scene_t scene = { poses, view_proj, 0.0f, mvps };
+                uint64_t start = now_ns();
+                for (int frame = 0; frame < JOBS_BENCH_FRAMES; frame++) {
+                        scene.time = (float)frame * (1.0f / 72.0f);
+                        jobs_parallel_for(&jobs, JOBS_BENCH_OBJECTS, JOBS_BENCH_BATCH, jobs_bench_transform, &scene);
+                        sink = mvps[frame][0];
+                }
+                double ms = (double)(now_ns() - start) * 1e-6 / JOBS_BENCH_FRAMES;
+                if (threads == 1) { single_ms = ms; }
+                printf("        %2d threads %29s %7.3f ms/frame %5.2fx\n", threads, "", ms, single_ms / ms);
+                jobs_shutdown(&jobs);
+        }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// APP COMMANDS
+//
+// A stub of android_native_app_glue's two sides. The "activity" thread sends commands the way the
+// glue's callbacks do, the "app" thread sleeps in poll() on the channel's fd the way its ALooper
+// does, and acknowledges each command under a mutex and condition variable like the glue's
+// lifecycle handshake. Run once over a pipe (the glue's old channel) and once over the eventfd
+// command queue (deps/include/android_app_cmd_queue.h).
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef __linux__
+
+#define CMD_BENCH_COUNT (20000)
+#define CMD_BENCH_PACE_NS (20000)   // Between fire and forget sends, so it's latency not throughput
+#define CMD_BENCH_QUIT ((int8_t)127)
+#define CMD_CHECK_PRODUCERS (4)
+#define CMD_CHECK_COUNT (20000)     // Per producer
+
+struct cmd_bench_t {
+        bool is_queue;
+        bool is_handshake;
+        int pipe_fds[2];
+        android_app_cmd_queue queue;
+
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        int64_t acked;
+
+        // Send times by command index, and the app thread's receive latency for each
+        uint64_t send_times[CMD_BENCH_COUNT];
+        uint64_t latencies[CMD_BENCH_COUNT];
+        int received;
+};
+
+static void cmd_bench_send(cmd_bench_t *bench, int8_t cmd) {
+        if (bench->is_queue) {
+                android_app_cmd_queue_push(&bench->queue, cmd);
+        } else {
+                ssize_t written = write(bench->pipe_fds[1], &cmd, 1);
+                (void)written;
+        }
+}
+
+// One command per call like the old glue's process_cmd, or all of them from the queue, -1 for none
+static int8_t cmd_bench_receive(cmd_bench_t *bench) {
+        if (bench->is_queue) {
+                return android_app_cmd_queue_pop(&bench->queue);
+        }
+        int8_t cmd;
+        return read(bench->pipe_fds[0], &cmd, 1) == 1 ? cmd : -1;
+}
+
+static void *cmd_bench_app_thread(void *data) {
+        cmd_bench_t *bench = (cmd_bench_t *)data;
+        struct pollfd fd = { bench->is_queue ? bench->queue.fd : bench->pipe_fds[0], POLLIN, 0 };
+        for (;;) {
+                poll(&fd, 1, -1);
+                int8_t cmd;
+                while ((cmd = cmd_bench_receive(bench)) >= 0) {
+                        if (cmd == CMD_BENCH_QUIT) { return NULL; }
+                        bench->latencies[bench->received] = now_ns() - bench->send_times[bench->received];
+                        bench->received++;
+                        if (bench->is_handshake) {
+                                pthread_mutex_lock(&bench->mutex);
+                                bench->acked++;
+                                pthread_cond_broadcast(&bench->cond);
+                                pthread_mutex_unlock(&bench->mutex);
+                        }
+                        if (!bench->is_queue) { break; }
+                }
+        }
+}
+
+static int cmd_bench_compare(const void *lhs, const void *rhs) {
+        uint64_t l = *(const uint64_t *)lhs, r = *(const uint64_t *)rhs;
+        return (l > r) - (l < r);
+}
+
+static void cmd_bench_run(bool is_queue, bool is_handshake) {
+        cmd_bench_t *bench = (cmd_bench_t *)calloc(1, sizeof(cmd_bench_t));
+        bench->is_queue = is_queue;
+        bench->is_handshake = is_handshake;
+        if (is_queue) {
+                android_app_cmd_queue_init(&bench->queue);
+        } else {
+                int result = pipe(bench->pipe_fds);
+                (void)result;
+        }
+        pthread_mutex_init(&bench->mutex, NULL);
+        pthread_cond_init(&bench->cond, NULL);
+        pthread_t app_thread;
+        pthread_create(&app_thread, NULL, cmd_bench_app_thread, bench);
+
+        uint64_t start = now_ns();
+        for (int i = 0; i < CMD_BENCH_COUNT; i++) {
+                int8_t cmd = (int8_t)(i % 16);
+                if (is_handshake) {
+                        // The glue sends under the lock, then waits for the app thread
+                        pthread_mutex_lock(&bench->mutex);
+                        bench->send_times[i] = now_ns();
+                        cmd_bench_send(bench, cmd);
+                        while (bench->acked <= i) {
+                                pthread_cond_wait(&bench->cond, &bench->mutex);
+                        }
+                        pthread_mutex_unlock(&bench->mutex);
+                } else {
+                        bench->send_times[i] = now_ns();
+                        cmd_bench_send(bench, cmd);
+                        struct timespec pace = { 0, CMD_BENCH_PACE_NS };
+                        nanosleep(&pace, NULL);
+                }
+        }
+        uint64_t elapsed = now_ns() - start;
+        cmd_bench_send(bench, CMD_BENCH_QUIT);
+        pthread_join(app_thread, NULL);
+
+        qsort(bench->latencies, CMD_BENCH_COUNT, sizeof(uint64_t), cmd_bench_compare);
+        char name[64];
+        snprintf(name, sizeof(name), "%s, %s", is_queue ? "eventfd queue" : "pipe", is_handshake ? "handshake" : "fire and forget");
+        printf("        %-32s p50 %6.2f us  p99 %7.2f us", name,
+               bench->latencies[CMD_BENCH_COUNT / 2] * 1e-3, bench->latencies[CMD_BENCH_COUNT * 99 / 100] * 1e-3);
+        if (is_handshake) {
+                printf("  round trip %6.2f us", (double)elapsed * 1e-3 / CMD_BENCH_COUNT);
+        }
+        printf("\n");
+
+        if (is_queue) {
+                android_app_cmd_queue_destroy(&bench->queue);
+        } else {
+                close(bench->pipe_fds[0]);
+                close(bench->pipe_fds[1]);
+        }
+        pthread_cond_destroy(&bench->cond);
+        pthread_mutex_destroy(&bench->mutex);
+        free(bench);
+}
+
+struct cmd_check_producer_t {
+        android_app_cmd_queue *queue;
+        int8_t cmd;
+};
+
+static void *cmd_check_producer(void *data) {
+        cmd_check_producer_t *producer = (cmd_check_producer_t *)data;
+        for (int i = 0; i < CMD_CHECK_COUNT; i++) {
+                android_app_cmd_queue_push(producer->queue, producer->cmd);
+        }
+        return NULL;
+}
+
+// Several producers hammering a consumer that sleeps on the eventfd between drains, every command
+// has to arrive exactly once, and the consumer must never sleep through one
+static void cmd_queue_cross_check() {
+        static android_app_cmd_queue queue;
+        android_app_cmd_queue_init(&queue);
+        cmd_check_producer_t producers[CMD_CHECK_PRODUCERS];
+        pthread_t threads[CMD_CHECK_PRODUCERS];
+        for (int i = 0; i < CMD_CHECK_PRODUCERS; i++) {
+                producers[i] = { &queue, (int8_t)i };
+                pthread_create(&threads[i], NULL, cmd_check_producer, &producers[i]);
+        }
+
+        int counts[CMD_CHECK_PRODUCERS] = {};
+        int total = 0, bad = 0, stalls = 0;
+        struct pollfd fd = { queue.fd, POLLIN, 0 };
+        while (total < CMD_CHECK_PRODUCERS * CMD_CHECK_COUNT) {
+                if (poll(&fd, 1, 1000) == 0) {
+                        stalls++;
+                        break;
+                }
+                int8_t cmd;
+                while ((cmd = android_app_cmd_queue_pop(&queue)) >= 0) {
+                        if (cmd < CMD_CHECK_PRODUCERS) { counts[cmd]++; } else { bad++; }
+                        total++;
+                }
+        }
+        for (int i = 0; i < CMD_CHECK_PRODUCERS; i++) {
+                pthread_join(threads[i], NULL);
+                if (counts[i] != CMD_CHECK_COUNT) { bad++; }
+        }
+        android_app_cmd_queue_destroy(&queue);
+
+        printf("App command queue cross-check (%d producers x %d commands):\n", CMD_CHECK_PRODUCERS, CMD_CHECK_COUNT);
+        printf("        %-40s %s\n", "delivered exactly once", bad ? "FAILED" : "ok");
+        printf("        %-40s %s\n", "no lost wakeups", stalls ? "FAILED" : "ok");
+        if (bad || stalls) { failures++; }
+}
+
+static void cmd_bench() {
+        printf("App command delivery latency (%d commands):\n", CMD_BENCH_COUNT);
+        cmd_bench_run(false, false);
+        cmd_bench_run(true, false);
+        cmd_bench_run(false, true);
+        cmd_bench_run(true, true);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// ENTRY POINT
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv) {
+        matrix_cross_check();
+        matrix_inverse_cross_check();
+        matrix_pose_cross_check();
+        matrix_bench();
+        matrix_inverse_bench();
+        matrix_pose_bench();
+        jobs_bench();
+#ifdef __linux__
+        cmd_queue_cross_check();
+        cmd_bench();
+#endif
+
+        if (failures) {
+                printf("%d cross-check(s) FAILED\n", failures);
+                return 1;
+        }
+        printf("All cross-checks passed\n");
+        return 0;
+}
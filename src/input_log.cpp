@@ -0,0 +1,222 @@
+// Input record and replay, see input_log.h
+
+#include "input_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Largest possible record: type, frame state, hands, sample count, samples
+#define INPUT_LOG_SAMPLE_SIZE (8 + INPUT_HAND_COUNT * 21)
+#define INPUT_LOG_MAX_RECORD_SIZE (1 + 17 + INPUT_HAND_COUNT * 36 + 2 + INPUT_LOG_MAX_SAMPLES * INPUT_LOG_SAMPLE_SIZE)
+
+// Bits of the per hand flags byte in a sample
+enum input_log_sample_bit_t {
+        INPUT_LOG_TRIGGER_CHANGED = 1 << 0,
+        INPUT_LOG_TRIGGER_ACTIVE = 1 << 1,
+        INPUT_LOG_CLICK = 1 << 2,
+        INPUT_LOG_CLICK_CHANGED = 1 << 3,
+        INPUT_LOG_CLICK_ACTIVE = 1 << 4,
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// PACKING
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void input_log_put(unsigned char *buffer, size_t *offset, const void *value, size_t size) {
+        memcpy(buffer + *offset, value, size);
+        *offset += size;
+}
+
+// Reads are bounds checked, once one runs off the end every later one fails too
+static bool input_log_get(const input_log_t *log, size_t *offset, void *value, size_t size) {
+        if (*offset + size > log->size) {
+                *offset = log->size + 1;
+                return false;
+        }
+        memcpy(value, log->data + *offset, size);
+        *offset += size;
+        return true;
+}
+
+static void input_log_put_u8(unsigned char *buffer, size_t *offset, uint8_t value) {
+        input_log_put(buffer, offset, &value, 1);
+}
+
+static uint8_t input_log_get_u8(const input_log_t *log, size_t *offset) {
+        uint8_t value = 0;
+        input_log_get(log, offset, &value, 1);
+        return value;
+}
+
+static void input_log_put_pose(unsigned char *buffer, size_t *offset, const XrPosef *pose) {
+        input_log_put(buffer, offset, &pose->orientation, 16);
+        input_log_put(buffer, offset, &pose->position, 12);
+}
+
+static void input_log_get_pose(const input_log_t *log, size_t *offset, XrPosef *pose) {
+        input_log_get(log, offset, &pose->orientation, 16);
+        input_log_get(log, offset, &pose->position, 12);
+}
+
+static void input_log_put_sample(unsigned char *buffer, size_t *offset, const input_sample_t *sample) {
+        input_log_put(buffer, offset, &sample->time, 8);
+        for (int i = 0; i < INPUT_HAND_COUNT; i++) {
+                const XrActionStateFloat *trigger = &sample->trigger_states[i];
+                const XrActionStateBoolean *click = &sample->trigger_click_states[i];
+                uint8_t bits = (trigger->changedSinceLastSync ? INPUT_LOG_TRIGGER_CHANGED : 0) |
+                               (trigger->isActive ? INPUT_LOG_TRIGGER_ACTIVE : 0) |
+                               (click->currentState ? INPUT_LOG_CLICK : 0) |
+                               (click->changedSinceLastSync ? INPUT_LOG_CLICK_CHANGED : 0) |
+                               (click->isActive ? INPUT_LOG_CLICK_ACTIVE : 0);
+                input_log_put_u8(buffer, offset, bits);
+                input_log_put(buffer, offset, &trigger->currentState, 4);
+                input_log_put(buffer, offset, &trigger->lastChangeTime, 8);
+                input_log_put(buffer, offset, &click->lastChangeTime, 8);
+        }
+}
+
+static void input_log_get_sample(const input_log_t *log, size_t *offset, input_sample_t *sample) {
+        input_log_get(log, offset, &sample->time, 8);
+        for (int i = 0; i < INPUT_HAND_COUNT; i++) {
+                XrActionStateFloat *trigger = &sample->trigger_states[i];
+                XrActionStateBoolean *click = &sample->trigger_click_states[i];
+                *trigger = { XR_TYPE_ACTION_STATE_FLOAT };
+                *click = { XR_TYPE_ACTION_STATE_BOOLEAN };
+                uint8_t bits = input_log_get_u8(log, offset);
+                trigger->changedSinceLastSync = (bits & INPUT_LOG_TRIGGER_CHANGED) ? XR_TRUE : XR_FALSE;
+                trigger->isActive = (bits & INPUT_LOG_TRIGGER_ACTIVE) ? XR_TRUE : XR_FALSE;
+                click->currentState = (bits & INPUT_LOG_CLICK) ? XR_TRUE : XR_FALSE;
+                click->changedSinceLastSync = (bits & INPUT_LOG_CLICK_CHANGED) ? XR_TRUE : XR_FALSE;
+                click->isActive = (bits & INPUT_LOG_CLICK_ACTIVE) ? XR_TRUE : XR_FALSE;
+                input_log_get(log, offset, &trigger->currentState, 4);
+                input_log_get(log, offset, &trigger->lastChangeTime, 8);
+                input_log_get(log, offset, &click->lastChangeTime, 8);
+        }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// RECORD AND REPLAY
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool input_log_open_record(input_log_t *log, const char *path) {
+        memset(log, 0, sizeof(*log));
+        log->file = fopen(path, "wb");
+        if (!log->file) { return false; }
+        setvbuf(log->file, NULL, _IOFBF, 1 << 16);
+        input_log_header_t header = { INPUT_LOG_MAGIC, INPUT_LOG_VERSION, INPUT_HAND_COUNT };
+        fwrite(&header, sizeof(header), 1, log->file);
+        return true;
+}
+
+bool input_log_open_replay(input_log_t *log, const char *path) {
+        memset(log, 0, sizeof(*log));
+        FILE *file = fopen(path, "rb");
+        if (!file) { return false; }
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        unsigned char *data = size > 0 ? (unsigned char *)malloc(size) : NULL;
+        bool is_read = data && fread(data, 1, size, file) == (size_t)size;
+        fclose(file);
+
+        input_log_header_t header;
+        bool is_valid = is_read && (size_t)size >= sizeof(header);
+        if (is_valid) {
+                memcpy(&header, data, sizeof(header));
+                is_valid = header.magic == INPUT_LOG_MAGIC && header.version == INPUT_LOG_VERSION &&
+                           header.hand_count == INPUT_HAND_COUNT;
+        }
+        if (!is_valid) {
+                free(data);
+                return false;
+        }
+        log->data = data;
+        log->size = size;
+        log->offset = sizeof(header);
+        return true;
+}
+
+void input_log_close(input_log_t *log) {
+        if (log->file) { fclose(log->file); }
+        free(log->data);
+        memset(log, 0, sizeof(*log));
+}
+
+void input_log_write_event(input_log_t *log, const input_log_event_t *event) {
+        unsigned char buffer[32];
+        size_t size = 0;
+        int32_t type = event->type;
+        int32_t state = event->state;
+        input_log_put_u8(buffer, &size, INPUT_LOG_RECORD_EVENT);
+        input_log_put(buffer, &size, &event->frame, 8);
+        input_log_put(buffer, &size, &type, 4);
+        input_log_put(buffer, &size, &state, 4);
+        fwrite(buffer, 1, size, log->file);
+        log->event_count++;
+}
+
+void input_log_write_frame(input_log_t *log, const input_log_frame_t *frame) {
+        static unsigned char buffer[INPUT_LOG_MAX_RECORD_SIZE];
+        size_t size = 0;
+        uint16_t sample_count = (uint16_t)frame->sample_count;
+        input_log_put_u8(buffer, &size, INPUT_LOG_RECORD_FRAME);
+        input_log_put(buffer, &size, &frame->display_time, 8);
+        input_log_put(buffer, &size, &frame->display_period, 8);
+        input_log_put_u8(buffer, &size, frame->should_render ? 1 : 0);
+        for (int i = 0; i < INPUT_HAND_COUNT; i++) {
+                input_log_put(buffer, &size, &frame->hand_flags[i], 8);
+                input_log_put_pose(buffer, &size, &frame->hand_poses[i]);
+        }
+        input_log_put(buffer, &size, &sample_count, 2);
+        for (int i = 0; i < sample_count; i++) {
+                input_log_put_sample(buffer, &size, &frame->samples[i]);
+        }
+        fwrite(buffer, 1, size, log->file);
+        log->frame_count++;
+}
+
+bool input_log_read(input_log_t *log, input_log_record_type_t *type, input_log_event_t *event, input_log_frame_t *frame) {
+        size_t offset = log->offset;
+        uint8_t record_type = input_log_get_u8(log, &offset);
+        if (record_type == INPUT_LOG_RECORD_EVENT) {
+                int32_t event_type = 0, state = 0;
+                input_log_get(log, &offset, &event->frame, 8);
+                input_log_get(log, &offset, &event_type, 4);
+                input_log_get(log, &offset, &state, 4);
+                event->type = (XrStructureType)event_type;
+                event->state = (XrSessionState)state;
+        } else if (record_type == INPUT_LOG_RECORD_FRAME) {
+                uint16_t sample_count = 0;
+                input_log_get(log, &offset, &frame->display_time, 8);
+                input_log_get(log, &offset, &frame->display_period, 8);
+                frame->should_render = input_log_get_u8(log, &offset) != 0;
+                for (int i = 0; i < INPUT_HAND_COUNT; i++) {
+                        input_log_get(log, &offset, &frame->hand_flags[i], 8);
+                        input_log_get_pose(log, &offset, &frame->hand_poses[i]);
+                }
+                input_log_get(log, &offset, &sample_count, 2);
+                if (sample_count > INPUT_LOG_MAX_SAMPLES) { return false; }
+                frame->sample_count = sample_count;
+                for (int i = 0; i < sample_count; i++) {
+                        input_log_get_sample(log, &offset, &frame->samples[i]);
+                }
+        } else {
+                return false;
+        }
+        if (offset > log->size) { return false; }
+
+        log->offset = offset;
+        *type = (input_log_record_type_t)record_type;
+        if (record_type == INPUT_LOG_RECORD_EVENT) {
+                log->event_count++;
+        } else {
+                log->frame_count++;
+        }
+        return true;
+}
+
+void input_log_rewind(input_log_t *log) {
+        log->offset = sizeof(input_log_header_t);
+        log->event_count = 0;
+        log->frame_count = 0;
+}
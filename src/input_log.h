@@ -0,0 +1,91 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// INPUT LOG
+//
+// A compact binary record of everything the frame loop observes from the runtime, so a session
+// seen on the headset can be run again, bit for bit, on the host. Two kinds of record, in the
+// order the frame loop saw them:
+//
+//      event   an OpenXR event from xrPollEvent, with the frame it arrived before
+//      frame   one xrWaitFrame: the frame state, both hands' located poses, and every input sample
+//              the frame loop consumed for it
+//
+// The file is an input_log_header_t followed by records, each a one byte type then its fields
+// packed back to back in native (little endian, on both targets) byte order, no padding.
+//
+// Recording buffers through stdio and writes from the main thread as it goes. Replaying reads the
+// whole log into memory up front.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "openxr/openxr.h"
+#include "input_ring.h"
+
+#define INPUT_LOG_MAGIC (0x4c495851u) // "QXIL"
+#define INPUT_LOG_VERSION (1)
+#define INPUT_LOG_MAX_SAMPLES (INPUT_RING_LENGTH) // Per frame, the most one drain can return
+
+struct input_log_header_t {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t hand_count;
+};
+
+enum input_log_record_type_t {
+        INPUT_LOG_RECORD_EVENT = 1,
+        INPUT_LOG_RECORD_FRAME = 2,
+};
+
+struct input_log_event_t {
+        int64_t frame;        // Frames waited before it arrived
+        XrStructureType type;
+        XrSessionState state; // For XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED, otherwise unknown
+};
+
+struct input_log_frame_t {
+        XrTime display_time;
+        XrDuration display_period;
+        bool should_render;
+        XrSpaceLocationFlags hand_flags[INPUT_HAND_COUNT];
+        XrPosef hand_poses[INPUT_HAND_COUNT];
+        int sample_count;
+        input_sample_t samples[INPUT_LOG_MAX_SAMPLES];
+};
+
+struct input_log_t {
+        // Recording
+        FILE *file;
+
+        // Replaying
+        unsigned char *data;
+        size_t size;
+        size_t offset;
+
+        int64_t event_count; // Written or read so far
+        int64_t frame_count;
+};
+
+inline bool input_log_is_recording(const input_log_t *log) { return log->file != NULL; }
+inline bool input_log_is_replaying(const input_log_t *log) { return log->data != NULL; }
+
+// Start a new log at path, returns false if it can't be created
+bool input_log_open_record(input_log_t *log, const char *path);
+
+// Load the log at path for replay, returns false if it can't be read or isn't an input log
+bool input_log_open_replay(input_log_t *log, const char *path);
+
+// Flush and close a recording, or free a replay
+void input_log_close(input_log_t *log);
+
+void input_log_write_event(input_log_t *log, const input_log_event_t *event);
+void input_log_write_frame(input_log_t *log, const input_log_frame_t *frame);
+
+// Read the next record, filling in event or frame to match its type. Returns false at the end of
+// the log, or at a truncated record (e.g. the recording app was killed mid write).
+bool input_log_read(input_log_t *log, input_log_record_type_t *type, input_log_event_t *event, input_log_frame_t *frame);
+
+// Back to the first record
+void input_log_rewind(input_log_t *log);
@@ -0,0 +1,69 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// INPUT RING
+//
+// Controller action states sampled faster than the display rate, passed from the input thread to
+// the frame loop through a single producer single consumer ring. Every sample is stamped with when
+// it was taken, so the frame loop can walk each press and release since its last frame in order,
+// rather than only seeing whatever state the controller happens to be in when it looks.
+//
+// head and tail only ever grow (wrapping is fine, only their difference matters), sample n lives in
+// slot n % INPUT_RING_LENGTH. If the frame loop falls a whole ring behind, new samples are dropped
+// and counted rather than overwriting ones it hasn't seen yet.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <stdint.h>
+
+#include "openxr/openxr.h"
+
+#define INPUT_HAND_COUNT (2)
+#define INPUT_RING_LENGTH (256) // Must be a power of two, half a second at 500Hz
+
+struct input_sample_t {
+        int64_t time; // CLOCK_MONOTONIC ns, taken just after xrSyncActions
+        XrActionStateFloat trigger_states[INPUT_HAND_COUNT];
+        XrActionStateBoolean trigger_click_states[INPUT_HAND_COUNT];
+};
+
+struct input_ring_t {
+        // Written by the producer
+        alignas(64) std::atomic<uint32_t> head;
+        std::atomic<uint32_t> dropped_count;
+
+        // Written by the consumer
+        alignas(64) std::atomic<uint32_t> tail;
+
+        input_sample_t samples[INPUT_RING_LENGTH];
+};
+
+// Only while neither side is using the ring
+inline void input_ring_reset(input_ring_t *ring) {
+        ring->head.store(0, std::memory_order_relaxed);
+        ring->dropped_count.store(0, std::memory_order_relaxed);
+        ring->tail.store(0, std::memory_order_relaxed);
+}
+
+// Producer only. Returns false, and counts the sample as dropped, when the ring is full.
+inline bool input_ring_push(input_ring_t *ring, const input_sample_t *sample) {
+        uint32_t head = ring->head.load(std::memory_order_relaxed);
+        uint32_t tail = ring->tail.load(std::memory_order_acquire);
+        if (head - tail == INPUT_RING_LENGTH) {
+                ring->dropped_count.fetch_add(1, std::memory_order_relaxed);
+                return false;
+        }
+        ring->samples[head % INPUT_RING_LENGTH] = *sample;
+        ring->head.store(head + 1, std::memory_order_release);
+        return true;
+}
+
+// Consumer only. Takes the oldest sample, returns false when there isn't one.
+inline bool input_ring_pop(input_ring_t *ring, input_sample_t *sample) {
+        uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint32_t head = ring->head.load(std::memory_order_acquire);
+        if (head == tail) { return false; }
+        *sample = ring->samples[tail % INPUT_RING_LENGTH];
+        ring->tail.store(tail + 1, std::memory_order_release);
+        return true;
+}
@@ -0,0 +1,330 @@
+// Work stealing job system, see jobs.h
+
+#include "jobs.h"
+
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "sync.h"
+
+// Times an idle worker looks for work (yielding in between) before going to sleep
+#define JOBS_SPIN_COUNT (64)
+
+struct jobs_range_t {
+        jobs_range_func_t func;
+        void *data;
+        int begin;
+        int end;
+        int batch;
+};
+
+static_assert(sizeof(jobs_range_t) <= JOBS_PAYLOAD_SIZE, "range must fit in a job's payload");
+
+static thread_local jobs_thread_t *jobs_current_thread = nullptr;
+
+static void jobs_pin_to_cpu(int cpu) {
+        if (cpu < 0) { return; }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+                LOG_WARN("Jobs: couldn't pin thread to cpu %d\n", cpu);
+        }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEQUE
+//
+// Chase-Lev with the C11 orderings from "Correct and Efficient Work-Stealing for Weak Memory Models"
+// (Le et al. 2013), except the slots are stored with release and stolen with acquire rather than
+// relying on the push fence, which is free on x86 and ARMv8 and keeps ThreadSanitizer happy. Fixed
+// size, pushing onto a full deque is a bug.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void jobs_deque_push(jobs_deque_t *d, job_t *job) {
+        int64_t b = d->bottom.load(std::memory_order_relaxed);
+        int64_t t = d->top.load(std::memory_order_acquire);
+        assert(b - t < JOBS_DEQUE_SIZE);
+        d->jobs[b & (JOBS_DEQUE_SIZE - 1)].store(job, std::memory_order_release);
+        d->bottom.store(b + 1, std::memory_order_release);
+}
+
+static job_t *jobs_deque_pop(jobs_deque_t *d) {
+        int64_t b = d->bottom.load(std::memory_order_relaxed) - 1;
+        d->bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = d->top.load(std::memory_order_relaxed);
+        job_t *job = NULL;
+        if (t <= b) {
+                job = d->jobs[b & (JOBS_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+                if (t == b) {
+                        // Last one, race the thieves for it
+                        if (!d->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                                job = NULL;
+                        }
+                        d->bottom.store(b + 1, std::memory_order_relaxed);
+                }
+        } else {
+                d->bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+}
+
+static job_t *jobs_deque_steal(jobs_deque_t *d) {
+        int64_t t = d->top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = d->bottom.load(std::memory_order_acquire);
+        if (t >= b) { return NULL; }
+        job_t *job = d->jobs[t & (JOBS_DEQUE_SIZE - 1)].load(std::memory_order_acquire);
+        if (!d->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return NULL;
+        }
+        return job;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SCHEDULING
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Make a job runnable on the calling thread's deque, waking a sleeping worker to come steal it
+static void jobs_push(jobs_t *jobs, job_t *job) {
+        jobs_thread_t *self = jobs_current_thread;
+        assert(self && self->jobs == jobs);
+        jobs_deque_push(&self->deque, job);
+
+        // Pairs with the sleeper registering itself then looking for work once more
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (jobs->sleeper_count.load(std::memory_order_relaxed) > 0) {
+                jobs->wake_signal.fetch_add(1, std::memory_order_release);
+                sync_wake_one(&jobs->wake_signal);
+        }
+}
+
+// Our own newest job, otherwise the oldest job of another thread, starting from a random one
+static job_t *jobs_find(jobs_t *jobs, jobs_thread_t *self) {
+        job_t *job = jobs_deque_pop(&self->deque);
+        if (job) { return job; }
+
+        self->rng_state ^= self->rng_state << 13;
+        self->rng_state ^= self->rng_state >> 17;
+        self->rng_state ^= self->rng_state << 5;
+        int start = (int)(self->rng_state % (uint32_t)jobs->thread_count);
+        for (int i = 0; i < jobs->thread_count; i++) {
+                int victim = (start + i) % jobs->thread_count;
+                if (victim == self->index) { continue; }
+                job = jobs_deque_steal(&jobs->threads[victim].deque);
+                if (job) { return job; }
+        }
+        return NULL;
+}
+
+// Once a job and all its children are done, release its dependents and tell its parent. The fields
+// are read first, a finished job's slot can be reused as soon as the count hits zero.
+static void jobs_finish(jobs_t *jobs, job_t *job) {
+        while (job) {
+                job_t *parent = job->parent;
+                int32_t dependent_count = job->dependent_count;
+                job_t *dependents[JOBS_MAX_DEPENDENTS];
+                memcpy(dependents, job->dependents, dependent_count * sizeof(job_t *));
+
+                if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) { return; }
+                for (int i = 0; i < dependent_count; i++) {
+                        if (dependents[i]->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                                jobs_push(jobs, dependents[i]);
+                        }
+                }
+                job = parent;
+        }
+}
+
+static void jobs_run(jobs_t *jobs, job_t *job) {
+        job->func(jobs, job, job->data);
+        jobs_finish(jobs, job);
+}
+
+static void *jobs_worker(void *arg) {
+        jobs_thread_t *self = (jobs_thread_t *)arg;
+        jobs_t *jobs = self->jobs;
+        jobs_current_thread = self;
+        jobs_pin_to_cpu(self->cpu);
+
+        int idle_count = 0;
+        while (!jobs->is_quitting.load(std::memory_order_acquire)) {
+                job_t *job = jobs_find(jobs, self);
+                if (job) {
+                        jobs_run(jobs, job);
+                        idle_count = 0;
+                        continue;
+                }
+                if (++idle_count < JOBS_SPIN_COUNT) {
+                        sched_yield();
+                        continue;
+                }
+
+                // Register as a sleeper, then look once more so a push in between isn't missed
+                uint32_t signal = jobs->wake_signal.load(std::memory_order_acquire);
+                jobs->sleeper_count.fetch_add(1, std::memory_order_seq_cst);
+                job = jobs_find(jobs, self);
+                if (!job && !jobs->is_quitting.load(std::memory_order_acquire)) {
+                        sync_wait(&jobs->wake_signal, signal);
+                }
+                jobs->sleeper_count.fetch_sub(1, std::memory_order_relaxed);
+                if (job) { jobs_run(jobs, job); }
+                idle_count = 0;
+        }
+        return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void jobs_default_config(jobs_config_t *config, int reserve_cores) {
+        memset(config, 0, sizeof(*config));
+        int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        int workers = cores - 1 - reserve_cores;
+        if (workers < 0) { workers = 0; }
+        if (workers > JOBS_MAX_THREADS - 1) { workers = JOBS_MAX_THREADS - 1; }
+        config->worker_count = workers;
+        for (int i = 0; i < JOBS_MAX_THREADS - 1; i++) {
+                config->worker_cpus[i] = -1;
+        }
+        config->caller_cpu = -1;
+}
+
+void jobs_init(jobs_t *jobs, const jobs_config_t *config) {
+        assert(config->worker_count >= 0 && config->worker_count < JOBS_MAX_THREADS);
+        assert(!jobs_current_thread);
+        jobs->thread_count = config->worker_count + 1;
+        jobs->threads = (jobs_thread_t *)aligned_alloc(64, jobs->thread_count * sizeof(jobs_thread_t));
+        assert(jobs->threads);
+        memset((void *)jobs->threads, 0, jobs->thread_count * sizeof(jobs_thread_t));
+        jobs->wake_signal.store(0, std::memory_order_relaxed);
+        jobs->sleeper_count.store(0, std::memory_order_relaxed);
+        jobs->is_quitting.store(false, std::memory_order_relaxed);
+
+        for (int i = 0; i < jobs->thread_count; i++) {
+                jobs_thread_t *t = &jobs->threads[i];
+                t->jobs = jobs;
+                t->index = i;
+                t->rng_state = 0x9e3779b9u * (uint32_t)(i + 1);
+                t->cpu = i == 0 ? config->caller_cpu : config->worker_cpus[i - 1];
+        }
+
+        jobs_current_thread = &jobs->threads[0];
+        jobs_pin_to_cpu(config->caller_cpu);
+        for (int i = 1; i < jobs->thread_count; i++) {
+                int create_result = pthread_create(&jobs->threads[i].thread, NULL, jobs_worker, &jobs->threads[i]);
+                assert(create_result == 0);
+                char name[16];
+                snprintf(name, sizeof(name), "jobs_%d", i % 100);
+                pthread_setname_np(jobs->threads[i].thread, name);
+        }
+}
+
+void jobs_shutdown(jobs_t *jobs) {
+        jobs->is_quitting.store(true, std::memory_order_release);
+        jobs->wake_signal.fetch_add(1, std::memory_order_release);
+        sync_wake(&jobs->wake_signal);
+        for (int i = 1; i < jobs->thread_count; i++) {
+                pthread_join(jobs->threads[i].thread, NULL);
+        }
+        free(jobs->threads);
+        jobs->threads = NULL;
+        jobs_current_thread = nullptr;
+}
+
+int jobs_thread_index(const jobs_t *jobs) {
+        jobs_thread_t *self = jobs_current_thread;
+        return self && self->jobs == jobs ? self->index : -1;
+}
+
+job_t *jobs_create_child(jobs_t *jobs, job_t *parent, job_func_t func, void *data) {
+        jobs_thread_t *self = jobs_current_thread;
+        assert(self && self->jobs == jobs);
+
+        // Skip slots still in use, e.g. a big range another thread stole a while ago
+        job_t *job = NULL;
+        for (int i = 0; i < JOBS_POOL_SIZE && !job; i++) {
+                job_t *slot = &self->pool[self->pool_next++ & (JOBS_POOL_SIZE - 1)];
+                if (slot->unfinished.load(std::memory_order_acquire) == 0) { job = slot; }
+        }
+        assert(job); // Every job this thread has made is still unfinished
+        job->func = func;
+        job->data = data;
+        job->parent = parent;
+        job->unfinished.store(1, std::memory_order_relaxed);
+        job->pending.store(1, std::memory_order_relaxed);
+        job->dependent_count = 0;
+        if (parent) {
+                parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+        }
+        return job;
+}
+
+job_t *jobs_create(jobs_t *jobs, job_func_t func, void *data) {
+        return jobs_create_child(jobs, NULL, func, data);
+}
+
+job_t *jobs_create_with_payload(jobs_t *jobs, job_t *parent, job_func_t func, const void *payload, int size) {
+        assert(size <= JOBS_PAYLOAD_SIZE);
+        job_t *job = jobs_create_child(jobs, parent, func, NULL);
+        memcpy(job->payload, payload, size);
+        job->data = job->payload;
+        return job;
+}
+
+void jobs_add_dependency(job_t *job, job_t *prerequisite) {
+        assert(prerequisite->dependent_count < JOBS_MAX_DEPENDENTS);
+        prerequisite->dependents[prerequisite->dependent_count++] = job;
+        job->pending.fetch_add(1, std::memory_order_relaxed);
+}
+
+void jobs_submit(jobs_t *jobs, job_t *job) {
+        if (job->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                jobs_push(jobs, job);
+        }
+}
+
+void jobs_wait(jobs_t *jobs, job_t *job) {
+        jobs_thread_t *self = jobs_current_thread;
+        assert(self && self->jobs == jobs);
+        while (!jobs_is_finished(job)) {
+                job_t *next = jobs_find(jobs, self);
+                if (next) {
+                        jobs_run(jobs, next);
+                } else {
+                        sched_yield();
+                }
+        }
+}
+
+// Split off the upper half of the range as a child until it's small enough, then run what's left
+static void jobs_range_job(jobs_t *jobs, job_t *job, void *data) {
+        jobs_range_t range = *(const jobs_range_t *)data;
+        while (range.end - range.begin > range.batch) {
+                jobs_range_t upper = range;
+                upper.begin = range.begin + (range.end - range.begin) / 2;
+                jobs_submit(jobs, jobs_create_with_payload(jobs, job, jobs_range_job, &upper, sizeof(upper)));
+                range.end = upper.begin;
+        }
+        range.func(range.data, range.begin, range.end);
+}
+
+void jobs_parallel_for(jobs_t *jobs, int count, int batch, jobs_range_func_t func, void *data) {
+        if (count <= 0) { return; }
+        if (batch < 1) { batch = 1; }
+        if (count <= batch || jobs->thread_count == 1) {
+                func(data, 0, count);
+                return;
+        }
+        jobs_range_t range = { func, data, 0, count, batch };
+        job_t *root = jobs_create_with_payload(jobs, NULL, jobs_range_job, &range, sizeof(range));
+        jobs_submit(jobs, root);
+        jobs_wait(jobs, root);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// JOB SYSTEM
+//
+// A fixed pool of worker threads for spreading per-frame CPU work (transforms, culling, animation)
+// across cores. Every thread in the pool, including the one that called jobs_init, owns a work
+// stealing deque: it pushes and pops jobs at the bottom of its own, and idle threads steal from the
+// top of someone else's. Workers that find nothing to do sleep on a futex until new work is pushed.
+//
+// Jobs form a graph two ways. A child job keeps its parent unfinished until it finishes too, which
+// is how jobs_parallel_for splits a range. A dependency holds a job back until its prerequisite has
+// finished, for ordering stages like animate -> transform -> cull.
+//
+// Jobs come out of a per-thread ring of JOBS_POOL_SIZE, nothing is allocated after jobs_init, and
+// slots still in use are skipped when the ring wraps. A thread can have at most JOBS_POOL_SIZE
+// unfinished jobs of its own making, which is plenty for a frame's worth of work. Only threads in
+// the pool can create, submit and wait on jobs, i.e. the thread that called jobs_init and the jobs
+// themselves.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <pthread.h>
+#include <stdint.h>
+
+#define JOBS_MAX_THREADS (16)   // Including the thread that calls jobs_init
+#define JOBS_POOL_SIZE (1024)   // Jobs per thread, must be a power of two
+#define JOBS_DEQUE_SIZE (4096)  // Ready jobs per thread, must be a power of two
+#define JOBS_MAX_DEPENDENTS (6)
+#define JOBS_PAYLOAD_SIZE (32)
+
+struct jobs_t;
+struct job_t;
+
+typedef void (*job_func_t)(jobs_t *jobs, job_t *job, void *data);
+typedef void (*jobs_range_func_t)(void *data, int begin, int end);
+
+// Two cache lines, so jobs being finished on different threads don't share one
+struct alignas(64) job_t {
+        job_func_t func;
+        void *data;
+        job_t *parent;
+        std::atomic<int32_t> unfinished;  // Itself plus unfinished children
+        std::atomic<int32_t> pending;     // Unfinished prerequisites, plus one until submitted
+        int32_t dependent_count;
+        job_t *dependents[JOBS_MAX_DEPENDENTS];
+
+        // Small arguments can live in the job itself, see jobs_create_with_payload
+        alignas(16) unsigned char payload[JOBS_PAYLOAD_SIZE];
+};
+
+static_assert(sizeof(job_t) == 128, "job_t should be two cache lines");
+
+// Chase-Lev deque, the owner pushes and pops at the bottom, thieves take from the top
+struct alignas(64) jobs_deque_t {
+        std::atomic<int64_t> top;
+        alignas(64) std::atomic<int64_t> bottom;
+        alignas(64) std::atomic<job_t *> jobs[JOBS_DEQUE_SIZE];
+};
+
+struct jobs_thread_t {
+        jobs_deque_t deque;
+        job_t pool[JOBS_POOL_SIZE];
+        uint32_t pool_next;
+        uint32_t rng_state; // For picking steal victims
+        pthread_t thread;
+        int cpu;            // Pinned core, or -1
+        jobs_t *jobs;
+        int index;
+};
+
+struct jobs_config_t {
+        // Worker threads to start, on top of the calling thread. 0 runs everything on the caller.
+        int worker_count;
+
+        // Core to pin each worker to, -1 leaves it to the scheduler. On big.LITTLE SoCs pinning
+        // the frame's workers to the big cores keeps them off the slow ones.
+        int worker_cpus[JOBS_MAX_THREADS - 1];
+
+        // Core to pin the calling thread to, -1 leaves it alone
+        int caller_cpu;
+};
+
+struct jobs_t {
+        jobs_thread_t *threads; // [thread_count], 0 is the calling thread
+        int thread_count;
+
+        // Workers sleep on wake_signal, which is bumped when work is pushed while any are asleep
+        std::atomic<uint32_t> wake_signal;
+        std::atomic<int32_t> sleeper_count;
+        std::atomic<bool> is_quitting;
+};
+
+// One worker per online core, leaving reserve_cores free for other threads (e.g. the render thread),
+// nothing pinned
+void jobs_default_config(jobs_config_t *config, int reserve_cores);
+
+// Start the workers, the calling thread becomes thread 0 of the pool
+void jobs_init(jobs_t *jobs, const jobs_config_t *config);
+
+// Stop and join the workers, every job must be finished
+void jobs_shutdown(jobs_t *jobs);
+
+// A new unsubmitted job. With a parent the parent doesn't finish until this does, and must not
+// have finished already.
+job_t *jobs_create(jobs_t *jobs, job_func_t func, void *data);
+job_t *jobs_create_child(jobs_t *jobs, job_t *parent, job_func_t func, void *data);
+
+// As above, but data points at size bytes copied into the job itself
+job_t *jobs_create_with_payload(jobs_t *jobs, job_t *parent, job_func_t func, const void *payload, int size);
+
+// Hold job back until prerequisite has finished, both must still be unsubmitted
+void jobs_add_dependency(job_t *job, job_t *prerequisite);
+
+// Queue a job, it runs once all its prerequisites have finished
+void jobs_submit(jobs_t *jobs, job_t *job);
+
+// Run other jobs until job (and all its children) have finished
+void jobs_wait(jobs_t *jobs, job_t *job);
+
+inline bool jobs_is_finished(const job_t *job) {
+        return job->unfinished.load(std::memory_order_acquire) == 0;
+}
+
+// The calling thread's index into jobs->threads, 0 for the thread that called jobs_init, or -1 if
+// it isn't in the pool
+int jobs_thread_index(const jobs_t *jobs);
+
+// Call func over [0, count) in ranges of at most batch, spread across the pool, and wait for them.
+// Ranges are split in half recursively so idle threads steal big pieces first.
+void jobs_parallel_for(jobs_t *jobs, int count, int batch, jobs_range_func_t func, void *data);
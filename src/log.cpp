@@ -0,0 +1,444 @@
+// Logging, see log.h
+
+#include "log.h"
+
+#include <atomic>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+
+#include "sync.h"
+
+// Each message is a header word (payload length in the low 16 bits, level in the next 8, structured
+// in the top bit) and the time it was logged, then its payload, packed back to back and wrapping
+// around the end of the ring. The payload is the text, or the format ID and encoded arguments.
+#define LOG_HEADER_BYTES (12)
+#define LOG_HEADER_STRUCTURED (1u << 31)
+
+struct log_ring_t {
+        log_ring_t *next;
+
+        // Byte counts that only ever grow, the producer owns head and the drain thread tail
+        alignas(64) std::atomic<uint32_t> head;
+        std::atomic<uint32_t> dropped_count;
+        alignas(64) std::atomic<uint32_t> tail;
+        uint32_t dropped_seen; // Drain thread only
+
+        unsigned char data[LOG_RING_BYTES];
+};
+
+struct log_state_t {
+        const char *tag;
+        FILE *file;
+        std::atomic<bool> is_running;
+        std::atomic<bool> is_quitting;
+        std::atomic<uint32_t> is_sleeping; // The drain thread sleeps on this once the rings are empty
+        pthread_t thread;
+};
+
+static std::atomic<log_ring_t *> log_rings(nullptr);
+static thread_local log_ring_t *log_thread_ring = nullptr;
+static log_state_t log_state;
+
+// Structured call sites by ID, ID 0 is never handed out. Each is published before any message that
+// uses it, and the drain thread writes each one to the file before its first message.
+static std::atomic<log_format_t *> log_formats[LOG_MAX_FORMATS];
+static std::atomic<uint32_t> log_format_count(1);
+static bool log_formats_written[LOG_MAX_FORMATS];
+
+static int64_t log_now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static log_ring_t *log_get_thread_ring() {
+        log_ring_t *ring = log_thread_ring;
+        if (ring) { return ring; }
+
+        ring = (log_ring_t *)calloc(1, sizeof(log_ring_t));
+        if (!ring) { return NULL; }
+
+        // Lock free push onto the global list, rings live until the process exits
+        log_ring_t *head = log_rings.load(std::memory_order_relaxed);
+        do {
+                ring->next = head;
+        } while (!log_rings.compare_exchange_weak(head, ring, std::memory_order_release, std::memory_order_relaxed));
+
+        log_thread_ring = ring;
+        return ring;
+}
+
+static void log_ring_copy_in(log_ring_t *ring, uint32_t offset, const void *data, uint32_t size) {
+        uint32_t start = offset & (LOG_RING_BYTES - 1);
+        uint32_t first = size < LOG_RING_BYTES - start ? size : LOG_RING_BYTES - start;
+        memcpy(ring->data + start, data, first);
+        memcpy(ring->data, (const unsigned char *)data + first, size - first);
+}
+
+static void log_ring_copy_out(const log_ring_t *ring, uint32_t offset, void *data, uint32_t size) {
+        uint32_t start = offset & (LOG_RING_BYTES - 1);
+        uint32_t first = size < LOG_RING_BYTES - start ? size : LOG_RING_BYTES - start;
+        memcpy(data, ring->data + start, first);
+        memcpy((unsigned char *)data + first, ring->data, size - first);
+}
+
+// text is NUL terminated at length
+static void log_sink_text(int level, char *text, int length) {
+#ifdef __ANDROID__
+        static const int priorities[] = { ANDROID_LOG_DEBUG, ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR };
+        if (length > 0 && text[length - 1] == '\n') { text[length - 1] = '\0'; }
+        __android_log_write(priorities[level], log_state.tag ? log_state.tag : "log", text);
+#else
+        fwrite(text, 1, length, level >= LOG_LEVEL_WARN ? stderr : stdout);
+#endif
+}
+
+static void log_file_put(const void *data, size_t size) {
+        fwrite(data, 1, size, log_state.file);
+}
+
+// Text goes to the file as well, so it has the whole log
+static void log_sink(int level, int64_t time, char *text, int length) {
+        if (log_state.file) {
+                uint8_t type = LOG_FILE_TEXT, file_level = (uint8_t)level;
+                uint16_t file_length = (uint16_t)length;
+                log_file_put(&type, 1);
+                log_file_put(&time, 8);
+                log_file_put(&file_level, 1);
+                log_file_put(&file_length, 2);
+                log_file_put(text, length);
+        }
+        log_sink_text(level, text, length);
+}
+
+// A structured message goes to the file as it is, or is formatted here without one
+static void log_sink_args(int64_t time, uint32_t id, const unsigned char *args, uint32_t size, char *text, int text_size) {
+        log_format_t *format = id < LOG_MAX_FORMATS ? log_formats[id].load(std::memory_order_acquire) : NULL;
+        if (!format) { return; }
+        if (!log_state.file) {
+                int length = log_format_args(text, text_size, format->format, args, size);
+                log_sink_text(format->level, text, length);
+                return;
+        }
+        if (!log_formats_written[id]) {
+                uint8_t type = LOG_FILE_FORMAT, level = (uint8_t)format->level;
+                uint16_t length = (uint16_t)strlen(format->format);
+                log_file_put(&type, 1);
+                log_file_put(&id, 4);
+                log_file_put(&level, 1);
+                log_file_put(&length, 2);
+                log_file_put(format->format, length);
+                log_formats_written[id] = true;
+        }
+        uint8_t type = LOG_FILE_ARGS;
+        uint16_t length = (uint16_t)size;
+        log_file_put(&type, 1);
+        log_file_put(&time, 8);
+        log_file_put(&id, 4);
+        log_file_put(&length, 2);
+        log_file_put(args, size);
+}
+
+// Write out every message queued so far, returns how many there were
+static int log_drain() {
+        static char text[LOG_MESSAGE_MAX + 64];
+        static unsigned char payload[LOG_MESSAGE_MAX + 4];
+        int count = 0;
+        for (log_ring_t *ring = log_rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+                uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+                uint32_t head = ring->head.load(std::memory_order_seq_cst);
+                while (tail != head) {
+                        uint32_t header;
+                        int64_t time;
+                        log_ring_copy_out(ring, tail, &header, 4);
+                        log_ring_copy_out(ring, tail + 4, &time, 8);
+                        uint32_t length = header & 0xffff;
+                        int level = (int)((header >> 16) & 0xff);
+                        if (header & LOG_HEADER_STRUCTURED) {
+                                uint32_t id;
+                                log_ring_copy_out(ring, tail + LOG_HEADER_BYTES, payload, length);
+                                memcpy(&id, payload, 4);
+                                log_sink_args(time, id, payload + 4, length - 4, text, sizeof(text));
+                        } else {
+                                log_ring_copy_out(ring, tail + LOG_HEADER_BYTES, text, length);
+                                text[length] = '\0';
+                                log_sink(level, time, text, (int)length);
+                        }
+                        tail += LOG_HEADER_BYTES + length;
+                        count++;
+                }
+                ring->tail.store(tail, std::memory_order_release);
+
+                uint32_t dropped = ring->dropped_count.load(std::memory_order_relaxed);
+                if (dropped != ring->dropped_seen) {
+                        int length = snprintf(text, sizeof(text), "Log: dropped %u messages, ring full\n", dropped - ring->dropped_seen);
+                        log_sink(LOG_LEVEL_WARN, log_now(), text, length);
+                        ring->dropped_seen = dropped;
+                        count++;
+                }
+        }
+        if (count > 0) {
+#ifndef __ANDROID__
+                fflush(stdout);
+#endif
+                if (log_state.file) { fflush(log_state.file); }
+        }
+        return count;
+}
+
+static void *log_drain_thread(void *data) {
+        pthread_setname_np(pthread_self(), "log");
+        for (;;) {
+                bool is_quitting = log_state.is_quitting.load(std::memory_order_acquire);
+                int count = log_drain();
+                if (is_quitting) { break; }
+                if (count > 0) {
+                        struct timespec period = { 0, LOG_DRAIN_PERIOD_NS };
+                        nanosleep(&period, NULL);
+                        continue;
+                }
+
+                // Nothing since the last look. Say we're going to sleep before looking once more, so a
+                // message published in between either gets drained here or wakes us.
+                log_state.is_sleeping.store(1, std::memory_order_seq_cst);
+                if (log_drain() == 0 && !log_state.is_quitting.load(std::memory_order_acquire)) {
+                        while (log_state.is_sleeping.load(std::memory_order_acquire)) {
+                                sync_wait(&log_state.is_sleeping, 1);
+                        }
+                }
+                log_state.is_sleeping.store(0, std::memory_order_relaxed);
+        }
+        return NULL;
+}
+
+static void log_wake_drain() {
+        if (log_state.is_sleeping.load(std::memory_order_seq_cst) && log_state.is_sleeping.exchange(0)) {
+                sync_wake(&log_state.is_sleeping);
+        }
+}
+
+void log_start(const char *tag) {
+        if (log_state.is_running.load(std::memory_order_relaxed)) { return; }
+        log_state.tag = tag;
+        log_state.is_quitting.store(false, std::memory_order_relaxed);
+        log_state.is_sleeping.store(0, std::memory_order_relaxed);
+        if (pthread_create(&log_state.thread, NULL, log_drain_thread, NULL) == 0) {
+                log_state.is_running.store(true, std::memory_order_release);
+        }
+}
+
+void log_stop() {
+        if (log_state.is_running.load(std::memory_order_relaxed)) {
+                log_state.is_running.store(false, std::memory_order_release);
+                log_state.is_quitting.store(true, std::memory_order_release);
+                log_state.is_sleeping.store(0, std::memory_order_seq_cst);
+                sync_wake(&log_state.is_sleeping);
+                pthread_join(log_state.thread, NULL);
+        }
+        if (log_state.file) {
+                fclose(log_state.file);
+                log_state.file = NULL;
+        }
+}
+
+bool log_open_file(const char *path) {
+        FILE *file = fopen(path, "wb");
+        if (!file) { return false; }
+        setvbuf(file, NULL, _IOFBF, 1 << 16);
+        log_file_header_t header = { LOG_FILE_MAGIC, LOG_FILE_VERSION };
+        fwrite(&header, sizeof(header), 1, file);
+        log_state.file = file;
+        return true;
+}
+
+// Reserve and fill a record in the calling thread's ring, or count it dropped
+static void log_push(int level, bool is_structured, const void *prefix, uint32_t prefix_size, const void *payload, uint32_t payload_size) {
+        log_ring_t *ring = log_get_thread_ring();
+        if (!ring) { return; }
+        uint32_t length = prefix_size + payload_size;
+        uint32_t size = LOG_HEADER_BYTES + length;
+        uint32_t head = ring->head.load(std::memory_order_relaxed);
+        uint32_t tail = ring->tail.load(std::memory_order_acquire);
+        if (LOG_RING_BYTES - (head - tail) < size) {
+                ring->dropped_count.fetch_add(1, std::memory_order_relaxed);
+                return;
+        }
+        uint32_t header = length | ((uint32_t)level << 16) | (is_structured ? LOG_HEADER_STRUCTURED : 0);
+        int64_t time = log_now();
+        log_ring_copy_in(ring, head, &header, 4);
+        log_ring_copy_in(ring, head + 4, &time, 8);
+        log_ring_copy_in(ring, head + LOG_HEADER_BYTES, prefix, prefix_size);
+        log_ring_copy_in(ring, head + LOG_HEADER_BYTES + prefix_size, payload, payload_size);
+        ring->head.store(head + size, std::memory_order_seq_cst);
+        log_wake_drain();
+}
+
+void log_write(int level, const char *format, ...) {
+        char text[LOG_MESSAGE_MAX];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+        if (length < 0) { return; }
+        if (length >= (int)sizeof(text)) { length = sizeof(text) - 1; }
+
+        if (!log_state.is_running.load(std::memory_order_acquire)) {
+                log_sink(level, log_now(), text, length);
+                return;
+        }
+        log_push(level, false, NULL, 0, text, (uint32_t)length);
+}
+
+// Hand out an ID the first time a call site logs. Two threads racing on it both claim one, the
+// loser's stays unused.
+static uint32_t log_register_format(log_format_t *format) {
+        uint32_t id = format->id.load(std::memory_order_acquire);
+        if (id) { return id; }
+        uint32_t claimed = log_format_count.fetch_add(1, std::memory_order_relaxed);
+        if (claimed >= LOG_MAX_FORMATS) { return 0; }
+        log_formats[claimed].store(format, std::memory_order_release);
+        if (format->id.compare_exchange_strong(id, claimed, std::memory_order_acq_rel)) {
+                return claimed;
+        }
+        return id;
+}
+
+void log_write_args(log_format_t *format, const log_args_t *args) {
+        uint32_t id = log_register_format(format);
+        if (id && log_state.is_running.load(std::memory_order_acquire)) {
+                log_push(format->level, true, &id, 4, args->data, args->size);
+                return;
+        }
+
+        // Out of IDs or no drain thread, format it here
+        char text[LOG_MESSAGE_MAX];
+        int length = log_format_args(text, sizeof(text), format->format, args->data, args->size);
+        if (!log_state.is_running.load(std::memory_order_acquire)) {
+                log_sink(format->level, log_now(), text, length);
+        } else {
+                log_push(format->level, false, NULL, 0, text, (uint32_t)length);
+        }
+}
+
+int64_t log_dropped_count() {
+        int64_t count = 0;
+        for (log_ring_t *ring = log_rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+                count += ring->dropped_count.load(std::memory_order_relaxed);
+        }
+        return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFERRED FORMATTING
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct log_arg_t {
+        log_arg_type_t type;
+        union {
+                long long i;
+                unsigned long long u;
+                double d;
+                uint64_t p;
+        };
+        const char *string;
+        uint16_t length;
+};
+
+static bool log_next_arg(const unsigned char *args, uint32_t size, uint32_t *offset, log_arg_t *arg) {
+        if (*offset + 1 > size) { return false; }
+        arg->type = (log_arg_type_t)args[*offset];
+        *offset += 1;
+        if (arg->type == LOG_ARG_STRING) {
+                if (*offset + 2 > size) { return false; }
+                memcpy(&arg->length, args + *offset, 2);
+                if (*offset + 2 + arg->length > size) { return false; }
+                arg->string = (const char *)args + *offset + 2;
+                *offset += 2 + arg->length;
+                return true;
+        }
+        if (*offset + 8 > size) { return false; }
+        memcpy(&arg->u, args + *offset, 8);
+        *offset += 8;
+        return true;
+}
+
+// Walks the format, handing each conversion and its argument to snprintf on its own. Length
+// modifiers in the format are replaced, every integer was widened to 64 bits when it was recorded.
+int log_format_args(char *text, int text_size, const char *format, const unsigned char *args, uint32_t size) {
+        int length = 0;
+        uint32_t offset = 0;
+        const char *p = format;
+        char spec[32];
+        char string[LOG_MESSAGE_MAX];
+        while (*p && length < text_size - 1) {
+                if (*p != '%') {
+                        text[length++] = *p++;
+                        continue;
+                }
+                if (p[1] == '%') {
+                        text[length++] = '%';
+                        p += 2;
+                        continue;
+                }
+
+                // %[flags][width][.precision][length]conversion
+                const char *start = p++;
+                while (*p && strchr("-+ #0", *p)) { p++; }
+                while (*p >= '0' && *p <= '9') { p++; }
+                if (*p == '.') {
+                        p++;
+                        while (*p >= '0' && *p <= '9') { p++; }
+                }
+                int spec_length = (int)(p - start);
+                while (*p && strchr("hlLqjzt", *p)) { p++; }
+                char conversion = *p;
+                if (!conversion) { break; }
+                p++;
+                if (spec_length > (int)sizeof(spec) - 4) { spec_length = sizeof(spec) - 4; }
+                memcpy(spec, start, spec_length);
+
+                log_arg_t arg = {};
+                int room = text_size - length;
+                int written = 0;
+                if (!log_next_arg(args, size, &offset, &arg)) {
+                        written = snprintf(text + length, room, "<missing>");
+                } else if (strchr("diouxXc", conversion) && (arg.type == LOG_ARG_INT || arg.type == LOG_ARG_UINT)) {
+                        if (conversion == 'c') {
+                                spec[spec_length] = 'c';
+                                spec[spec_length + 1] = '\0';
+                                written = snprintf(text + length, room, spec, (int)arg.i);
+                        } else {
+                                spec[spec_length] = 'l';
+                                spec[spec_length + 1] = 'l';
+                                spec[spec_length + 2] = conversion;
+                                spec[spec_length + 3] = '\0';
+                                written = snprintf(text + length, room, spec, arg.i);
+                        }
+                } else if (strchr("fFeEgGaA", conversion) && arg.type == LOG_ARG_DOUBLE) {
+                        spec[spec_length] = conversion;
+                        spec[spec_length + 1] = '\0';
+                        written = snprintf(text + length, room, spec, arg.d);
+                } else if (conversion == 's' && arg.type == LOG_ARG_STRING) {
+                        memcpy(string, arg.string, arg.length);
+                        string[arg.length] = '\0';
+                        spec[spec_length] = 's';
+                        spec[spec_length + 1] = '\0';
+                        written = snprintf(text + length, room, spec, string);
+                } else if (conversion == 'p' && arg.type == LOG_ARG_POINTER) {
+                        written = snprintf(text + length, room, "%p", (void *)(uintptr_t)arg.p);
+                } else {
+                        written = snprintf(text + length, room, "<bad %%%c>", conversion);
+                }
+                if (written > 0) { length += written < room ? written : room - 1; }
+        }
+        text[length] = '\0';
+        return length;
+}
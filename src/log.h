@@ -0,0 +1,193 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// LOGGING
+//
+// printf style logging that never blocks the calling thread. A message is formatted on the caller's
+// stack and copied into that thread's own ring (allocated on its first message and linked into a
+// global list with a single compare and swap, like trace.h). A drain thread empties the rings into
+// logcat on Android, stdout/stderr on the host, so the caller never takes the stdio lock or makes a
+// write syscall. If a ring is full the message is dropped and counted, the drain thread reports how
+// many were lost.
+//
+// The drain thread looks at the rings every LOG_DRAIN_PERIOD_NS while messages are coming in, and
+// otherwise sleeps until the next one wakes it. Order is kept per thread, not across threads.
+//
+// The SLOG_* macros are structured: rather than formatting, the caller records the ID of its call
+// site's format string and the raw arguments, and the drain thread formats them. With a binary log
+// file open (log_open_file) they are never formatted on the device at all, the file takes the format
+// strings once and the raw records after, and src/log_decode.cpp turns it into text on the host.
+// Arguments are numbers, pointers and C strings (copied, so they needn't outlive the call), and the
+// format is checked against them at compile time like printf.
+//
+// Messages below LOG_LEVEL compile to nothing, build with e.g. -DLOG_LEVEL=LOG_LEVEL_WARN. Before
+// log_start and after log_stop messages are written straight away on the calling thread.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+#define LOG_LEVEL_DEBUG (0)
+#define LOG_LEVEL_INFO (1)
+#define LOG_LEVEL_WARN (2)
+#define LOG_LEVEL_ERROR (3)
+#define LOG_LEVEL_NONE (4)
+
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#define LOG_RING_BYTES (1 << 16)   // Per thread, must be a power of two
+#define LOG_MESSAGE_MAX (4096)     // Longer messages are truncated, logcat cuts lines about here anyway
+#define LOG_DRAIN_PERIOD_NS (10000000ll)
+#define LOG_MAX_FORMATS (1024)     // Structured call sites, past this they're formatted by the caller
+
+#define LOG_FILE_MAGIC (0x4c425851u) // "QXBL"
+#define LOG_FILE_VERSION (1)
+
+// Binary log file: a log_file_header_t, then records, each a one byte log_file_record_t and its
+// fields packed back to back in native (little endian) byte order
+//
+//      FORMAT  u32 id, u8 level, u16 length, format string
+//      TEXT    i64 time, u8 level, u16 length, text
+//      ARGS    i64 time, u32 id, u16 length, arguments
+//
+// Times are CLOCK_MONOTONIC ns. Arguments are each a log_arg_type_t byte then an 8 byte value, or a
+// u16 length and the bytes for strings.
+struct log_file_header_t {
+        uint32_t magic;
+        uint32_t version;
+};
+
+enum log_file_record_t {
+        LOG_FILE_FORMAT = 1,
+        LOG_FILE_TEXT = 2,
+        LOG_FILE_ARGS = 3,
+};
+
+enum log_arg_type_t {
+        LOG_ARG_INT = 1,
+        LOG_ARG_UINT = 2,
+        LOG_ARG_DOUBLE = 3,
+        LOG_ARG_STRING = 4,
+        LOG_ARG_POINTER = 5,
+};
+
+// A structured call site, registered on its first message
+struct log_format_t {
+        const char *format;
+        int level;
+        std::atomic<uint32_t> id; // 0 until registered
+};
+
+struct log_args_t {
+        uint32_t size;
+        unsigned char data[LOG_MESSAGE_MAX];
+};
+
+// Start the drain thread, tag is the logcat tag on Android and must outlive the log
+void log_start(const char *tag);
+
+// Write out everything still queued and stop the drain thread, once other threads have stopped
+// logging. Closes the binary log file.
+void log_stop();
+
+// Send everything to a binary log file at path, rather than formatting structured messages. Call
+// before log_start. Returns false if it can't be created.
+bool log_open_file(const char *path);
+
+void log_write(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// Messages lost to full rings so far
+int64_t log_dropped_count();
+
+void log_write_args(log_format_t *format, const log_args_t *args);
+
+// Format encoded arguments with a printf format string, as snprintf would have. Used by the drain
+// thread and the decoder.
+int log_format_args(char *text, int text_size, const char *format, const unsigned char *args, uint32_t size);
+
+inline void log_args_put(log_args_t *args, log_arg_type_t type, const void *value, uint32_t size) {
+        if (args->size + 1 + size > sizeof(args->data)) { return; }
+        args->data[args->size] = (unsigned char)type;
+        memcpy(args->data + args->size + 1, value, size);
+        args->size += 1 + size;
+}
+
+inline void log_args_add(log_args_t *args, long long value) { log_args_put(args, LOG_ARG_INT, &value, 8); }
+inline void log_args_add(log_args_t *args, long value) { log_args_add(args, (long long)value); }
+inline void log_args_add(log_args_t *args, int value) { log_args_add(args, (long long)value); }
+inline void log_args_add(log_args_t *args, unsigned long long value) { log_args_put(args, LOG_ARG_UINT, &value, 8); }
+inline void log_args_add(log_args_t *args, unsigned long value) { log_args_add(args, (unsigned long long)value); }
+inline void log_args_add(log_args_t *args, unsigned value) { log_args_add(args, (unsigned long long)value); }
+inline void log_args_add(log_args_t *args, double value) { log_args_put(args, LOG_ARG_DOUBLE, &value, 8); }
+
+inline void log_args_add(log_args_t *args, const char *value) {
+        if (!value) { value = "(null)"; }
+        size_t length = strlen(value);
+        size_t room = sizeof(args->data) - args->size;
+        if (room < 3) { return; }
+        uint16_t clamped = (uint16_t)(length < room - 3 ? length : room - 3);
+        args->data[args->size] = LOG_ARG_STRING;
+        memcpy(args->data + args->size + 1, &clamped, 2);
+        memcpy(args->data + args->size + 3, value, clamped);
+        args->size += 3 + clamped;
+}
+inline void log_args_add(log_args_t *args, char *value) { log_args_add(args, (const char *)value); }
+inline void log_args_add(log_args_t *args, const unsigned char *value) { log_args_add(args, (const char *)value); }
+inline void log_args_add(log_args_t *args, unsigned char *value) { log_args_add(args, (const char *)value); }
+
+template <typename T>
+inline void log_args_add(log_args_t *args, T *value) {
+        uint64_t bits = (uint64_t)(uintptr_t)value;
+        log_args_put(args, LOG_ARG_POINTER, &bits, 8);
+}
+
+inline void log_args_add_all(log_args_t *args) {}
+
+template <typename T, typename... Rest>
+inline void log_args_add_all(log_args_t *args, T value, Rest... rest) {
+        log_args_add(args, value);
+        log_args_add_all(args, rest...);
+}
+
+template <typename... Args>
+inline void log_write_structured(log_format_t *format, Args... values) {
+        log_args_t args;
+        args.size = 0;
+        log_args_add_all(&args, values...);
+        log_write_args(format, &args);
+}
+
+// Never called, lets the compiler check a structured message's arguments against its format
+inline void log_check_format(const char *format, ...) __attribute__((format(printf, 1, 2)));
+inline void log_check_format(const char *format, ...) {}
+
+#define LOG_AT(level, ...)                                                                         \
+        do {                                                                                       \
+                if ((level) >= LOG_LEVEL) { log_write((level), __VA_ARGS__); }                     \
+        } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#define SLOG_AT(level, format, ...)                                                                \
+        do {                                                                                       \
+                if ((level) >= LOG_LEVEL) {                                                        \
+                        static log_format_t log_call_site = { (format), (level), { 0 } };          \
+                        if (0) { log_check_format((format), ##__VA_ARGS__); }                     \
+                        log_write_structured(&log_call_site, ##__VA_ARGS__);                       \
+                }                                                                                  \
+        } while (0)
+
+#define SLOG_DEBUG(...) SLOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define SLOG_INFO(...) SLOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define SLOG_WARN(...) SLOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define SLOG_ERROR(...) SLOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
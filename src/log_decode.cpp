@@ -0,0 +1,131 @@
+// Turns a binary log file (see log.h) back into text, one line per message with its time since the
+// first message and level.
+//
+// Build and run on the host with something like:
+//
+//     g++ -O2 -Isrc src/log_decode.cpp src/log.cpp -o build/log_decode -lpthread && ./build/log_decode log.qxrbin
+//
+// Pull the file off the headset first, e.g. adb pull /sdcard/Android/data/<package>/files/log.qxrbin
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+
+struct decode_t {
+        const unsigned char *data;
+        size_t size;
+        size_t offset;
+};
+
+// Reads past the end fail, and every one after them
+static bool decode_get(decode_t *d, void *value, size_t size) {
+        if (d->offset + size > d->size) {
+                d->offset = d->size + 1;
+                return false;
+        }
+        memcpy(value, d->data + d->offset, size);
+        d->offset += size;
+        return true;
+}
+
+static void decode_print(int64_t time, int64_t start_time, int level, const char *text, int length) {
+        static const char letters[] = { 'D', 'I', 'W', 'E' };
+        double seconds = (double)(time - start_time) / 1e9;
+        char letter = level >= 0 && level < 4 ? letters[level] : '?';
+        if (length > 0 && text[length - 1] == '\n') { length--; }
+        printf("[%12.6f] %c %.*s\n", seconds, letter, length, text);
+}
+
+int main(int argc, char **argv) {
+        if (argc != 2) {
+                fprintf(stderr, "usage: %s log.qxrbin\n", argv[0]);
+                return 2;
+        }
+        FILE *file = fopen(argv[1], "rb");
+        if (!file) {
+                fprintf(stderr, "Can't open %s\n", argv[1]);
+                return 1;
+        }
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        unsigned char *data = size > 0 ? (unsigned char *)malloc(size) : NULL;
+        bool is_read = data && fread(data, 1, size, file) == (size_t)size;
+        fclose(file);
+
+        decode_t d = { data, is_read ? (size_t)size : 0, 0 };
+        log_file_header_t header;
+        if (!decode_get(&d, &header, sizeof(header)) || header.magic != LOG_FILE_MAGIC || header.version != LOG_FILE_VERSION) {
+                fprintf(stderr, "%s is not a version %d log file\n", argv[1], LOG_FILE_VERSION);
+                free(data);
+                return 1;
+        }
+
+        // Formats by ID, as the file defines them
+        static const char *formats[LOG_MAX_FORMATS];
+        static int levels[LOG_MAX_FORMATS];
+        static char text[LOG_MESSAGE_MAX + 64];
+        static unsigned char payload[1 << 16];
+        int64_t start_time = 0;
+        bool is_started = false;
+        int message_count = 0;
+        while (d.offset < d.size) {
+                uint8_t type = 0, level = 0;
+                uint16_t length = 0;
+                uint32_t id = 0;
+                int64_t time = 0;
+                decode_get(&d, &type, 1);
+                if (type == LOG_FILE_FORMAT) {
+                        decode_get(&d, &id, 4);
+                        decode_get(&d, &level, 1);
+                        decode_get(&d, &length, 2);
+                        if (id >= LOG_MAX_FORMATS || d.offset + length > d.size) { break; }
+                        char *format = (char *)malloc(length + 1);
+                        decode_get(&d, format, length);
+                        format[length] = '\0';
+                        free((void *)formats[id]);
+                        formats[id] = format;
+                        levels[id] = level;
+                        continue;
+                }
+                if (type != LOG_FILE_TEXT && type != LOG_FILE_ARGS) {
+                        fprintf(stderr, "Unknown record %d at offset %zu\n", type, d.offset - 1);
+                        break;
+                }
+
+                decode_get(&d, &time, 8);
+                if (type == LOG_FILE_TEXT) {
+                        decode_get(&d, &level, 1);
+                } else {
+                        decode_get(&d, &id, 4);
+                }
+                decode_get(&d, &length, 2);
+                if (!decode_get(&d, payload, length)) { break; }
+                if (!is_started) {
+                        start_time = time;
+                        is_started = true;
+                }
+
+                if (type == LOG_FILE_TEXT) {
+                        decode_print(time, start_time, level, (const char *)payload, length);
+                } else if (id < LOG_MAX_FORMATS && formats[id]) {
+                        int text_length = log_format_args(text, sizeof(text), formats[id], payload, length);
+                        decode_print(time, start_time, levels[id], text, text_length);
+                } else {
+                        printf("[%12.6f] ? <undefined format %u>\n", (double)(time - start_time) / 1e9, id);
+                }
+                message_count++;
+        }
+        if (d.offset > d.size) {
+                fprintf(stderr, "Truncated after %d messages\n", message_count);
+        }
+
+        for (int i = 0; i < LOG_MAX_FORMATS; i++) {
+                free((void *)formats[i]);
+        }
+        free(data);
+        return d.offset > d.size ? 1 : 0;
+}
@@ -6,39 +6,165 @@
 
 #define APPNAME "questxrexample"
 
+// Render both eyes in a single pass with OVR_multiview when the driver supports it. Build with
+// -DENABLE_MULTIVIEW=0 to always use the swapchain per view path.
+#ifndef ENABLE_MULTIVIEW
+#define ENABLE_MULTIVIEW 1
+#endif
+
+// Use a renderbuffer for depth instead of a texture in the swapchain per view path. Depth is never
+// sampled, and together with the invalidate at the end of each pass it lets tiled GPUs keep depth
+// in tile memory and never write it out. Multiview always needs a layered depth texture.
+#ifndef ENABLE_TRANSIENT_DEPTH
+#define ENABLE_TRANSIENT_DEPTH 1
+#endif
+
+// Time every stage of app_update and print rolling percentiles every few seconds, see telemetry.h.
+// Build with -DENABLE_TELEMETRY=0 to compile the instrumentation out.
+#ifndef ENABLE_TELEMETRY
+#define ENABLE_TELEMETRY 1
+#endif
+
+// Time each view's passes on the GPU with GL_EXT_disjoint_timer_query when the driver has it, the
+// results go into the telemetry alongside the CPU stages. Build with -DENABLE_GPU_TIMERS=0 to skip.
+#ifndef ENABLE_GPU_TIMERS
+#define ENABLE_GPU_TIMERS 1
+#endif
+
+// Record a Chrome/Perfetto trace of the frame loop, written to app storage (or the working directory
+// on the host) at shutdown, see trace.h. Off by default, build with -DENABLE_TRACE=1.
+#ifndef ENABLE_TRACE
+#define ENABLE_TRACE 0
+#endif
+
+// Submit frames from a dedicated render thread, one frame behind the main thread: the main thread
+// pumps events, waits on xrWaitFrame and samples input for the next frame while the render thread
+// begins, draws and ends the previous one, see FRAME HANDOFF. Build with -DENABLE_RENDER_THREAD=0 to
+// render inline on the main thread.
+#ifndef ENABLE_RENDER_THREAD
+#define ENABLE_RENDER_THREAD 1
+#endif
+
+// Locate the controllers again once per frame, just before the draws, and rebuild their model
+// matrices, so the boxes use the freshest pose the runtime has rather than the one sampled after
+// xrWaitFrame. Every view draws the same latched pose, so the eyes can't disagree.
+// The telemetry reports pose ages at submission either way. Build with -DENABLE_LATE_LATCH=0 to
+// render with the poses sampled on the main thread.
+#ifndef ENABLE_LATE_LATCH
+#define ENABLE_LATE_LATCH 1
+#endif
+
+// Sample the controller action states on a dedicated thread at INPUT_SAMPLE_RATE_HZ, faster than the
+// display, and hand every sample to the frame loop through a ring, see input_ring.h. Trigger presses
+// and releases shorter than a frame then still reach the frame, with the time they happened. Build
+// with -DENABLE_INPUT_THREAD=0 to sample once per frame on the main thread.
+#ifndef ENABLE_INPUT_THREAD
+#define ENABLE_INPUT_THREAD 1
+#endif
+
+// Record everything the frame loop observes from the runtime (events, frame states, controller poses
+// and input samples) to input.qxrlog in app storage, to replay on the host, see input_log.h. Off by
+// default, build with -DENABLE_INPUT_RECORD=1. The host takes --record and --replay instead.
+#ifndef ENABLE_INPUT_RECORD
+#define ENABLE_INPUT_RECORD 0
+#endif
+
+// Write the log to log.qxrbin in app storage as well, with the SLOG_* messages left as format IDs and
+// raw arguments for src/log_decode.cpp to format on the host, see log.h. Off by default, build with
+// -DENABLE_LOG_FILE=1. The host takes --log-file instead.
+#ifndef ENABLE_LOG_FILE
+#define ENABLE_LOG_FILE 0
+#endif
+
+// Save linked programs with glGetProgramBinary to app storage and load them from there on the next
+// launch rather than compiling their GLSL again, see program_cache.h. Build with
+// -DENABLE_PROGRAM_CACHE=0 to always compile. The host takes --no-program-cache too.
+#ifndef ENABLE_PROGRAM_CACHE
+#define ENABLE_PROGRAM_CACHE 1
+#endif
+
+// Start every shader compile and link during init without waiting on any, and let drivers with
+// GL_KHR_parallel_shader_compile finish them on their own threads while the OpenXR setup runs, see
+// SHADER REGISTRY. Build with -DENABLE_PARALLEL_SHADER_COMPILE=0 to leave the driver's threads alone.
+#ifndef ENABLE_PARALLEL_SHADER_COMPILE
+#define ENABLE_PARALLEL_SHADER_COMPILE 1
+#endif
+
+// Run init as a graph of stages, with the OpenXR ones that don't need the GL context (instance,
+// system, views, actions, spaces) on the job workers alongside the EGL and shader setup on the main
+// thread, and log how long each stage took, see INIT GRAPH. Build with -DENABLE_INIT_GRAPH=0 to run
+// the same stages one after another on the main thread.
+#ifndef ENABLE_INIT_GRAPH
+#define ENABLE_INIT_GRAPH 1
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // INCLUDES
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#include "android_native_app_glue.h"
-#include <jni.h>
-#include <android/native_activity.h>
-
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <GLES3/gl3.h>
-#include <android/log.h>
+#include <GLES2/gl2ext.h>
 
-#define XR_USE_PLATFORM_ANDROID
+// Older NDK headers predate GL_KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (GL_APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) (GLuint count);
+#endif
+
+#include "platform.h"
 #define XR_USE_GRAPHICS_API_OPENGL_ES
 #include "openxr/openxr.h"
 #include "openxr/openxr_platform.h"
 
+#include "input_log.h"
+#include "input_ring.h"
+#include "jobs.h"
+#include "log.h"
+#include "matrix.h"
+#include "pose_cache.h"
+#include "program_cache.h"
+#include "sync.h"
+#include "telemetry.h"
+#include "trace.h"
+#ifdef XR_MOCK
+#include "xr_mock.h"
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // SHADER SOURCE STRINGS
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Every shader gets the version string first, then MULTIVIEW_DEFINES_SRC for the vertex shaders of
+// the multiview programs. In multiview mode the vertex shaders read both view_proj matrices from
+// one uniform block and pick theirs with gl_ViewID_OVR.
+const char *SHADER_VERSION_SRC = "#version 320 es\n";
+
+const char *MULTIVIEW_DEFINES_SRC = R"glsl(
+#extension GL_OVR_multiview2 : require
+#define MULTIVIEW
+)glsl";
+
 const char *BACKGROUND_VERT_SRC = R"glsl(
-#version 320 es
 precision highp float;
 
+#ifdef MULTIVIEW
+layout(num_views = 2) in;
+layout(std140, binding = 0) uniform view_block { mat4 view_proj[2]; };
+#else
 layout(location = 0) uniform mat4 view_proj;
+#endif
 
 layout(location = 0) out vec3 world_pos;
 
@@ -46,12 +172,15 @@ void main() {
         const vec2 positions[3] = vec2[3](vec2(-1000,-1000), vec2(3000,-1000), vec2(-1000, 3000));
         vec2 pos = positions[gl_VertexID];
         world_pos = vec3(pos.x, 0.0, pos.y);
+#ifdef MULTIVIEW
+        gl_Position = view_proj[gl_ViewID_OVR] * vec4(world_pos, 1.0);
+#else
         gl_Position = view_proj * vec4(world_pos, 1.0);
+#endif
 }
 )glsl";
 
 const char *BACKGROUND_FRAG_SRC = R"glsl(
-#version 320 es
 precision highp float;
 
 layout(location = 1) uniform vec3 cam_pos;
@@ -78,10 +207,15 @@ void main() {
 )glsl";
 
 const char *BOX_VERT_SRC = R"glsl(
-#version 320 es
 precision highp float;
 
+#ifdef MULTIVIEW
+layout(num_views = 2) in;
+layout(std140, binding = 0) uniform view_block { mat4 view_proj[2]; };
+layout(location = 0) uniform mat4 model;
+#else
 layout(location = 0) uniform mat4 mvp;
+#endif
 layout(location = 1) uniform vec2 trigger_state;
 layout(location = 0) out vec3 vc;
 
@@ -111,14 +245,17 @@ void main() {
         float t = -(cos(3.14159 * trigger_state.x) - 1.0) / 2.0; // Ease
         vec3 pos = vec3(mix(1.0, 1.2, t)) * cube_positions[element];
 
+#ifdef MULTIVIEW
+        gl_Position = view_proj[gl_ViewID_OVR] * (model * vec4(pos, 1.0));
+#else
         gl_Position = vec4(mvp * vec4(pos, 1.0));
+#endif
         vc = mix(vec3(0, 0, 1), vec3(1, 0, 0), trigger_state.x);
 }
 )glsl";
 
 
 const char *BOX_FRAG_SRC = R"glsl(
-#version 320 es
 precision highp float;
 
 layout(location = 0) in vec3 vc;
@@ -130,217 +267,190 @@ void main() {
 )glsl";
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// MATRIX HELPERS
-//
-// Based on code from https://github.com/felselva/mathc
-// Copyright © 2018 Felipe Ferreira da Silva
-// https://github.com/felselva/mathc/blob/master/LICENSE
+// APPLICATION STATE
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void matrix_identity(float *result) {
-	result[0] = (1.0);
-	result[1] = (0.0);
-	result[2] = (0.0);
-	result[3] = (0.0);
-	result[4] = (0.0);
-	result[5] = (1.0);
-	result[6] = (0.0);
-	result[7] = (0.0);
-	result[8] = (0.0);
-	result[9] = (0.0);
-	result[10] = (1.0);
-	result[11] = (0.0);
-	result[12] = (0.0);
-	result[13] = (0.0);
-	result[14] = (0.0);
-	result[15] = (1.0);
-}
-
-void matrix_translate(float *result, float* m0, float* v0) {
-	result[0] = m0[0];
-	result[1] = m0[1];
-	result[2] = m0[2];
-	result[3] = m0[3];
-	result[4] = m0[4];
-	result[5] = m0[5];
-	result[6] = m0[6];
-	result[7] = m0[7];
-	result[8] = m0[8];
-	result[9] = m0[9];
-	result[10] = m0[10];
-	result[11] = m0[11];
-	result[12] = m0[12] + v0[0];
-	result[13] = m0[13] + v0[1];
-	result[14] = m0[14] + v0[2];
-	result[15] = m0[15];
-}
-
-void matrix_rotation_from_quat(float *result, float *q0) {
-	float xx = q0[0] * q0[0];
-	float yy = q0[1] * q0[1];
-	float zz = q0[2] * q0[2];
-	float xy = q0[0] * q0[1];
-	float zw = q0[2] * q0[3];
-	float xz = q0[0] * q0[2];
-	float yw = q0[1] * q0[3];
-	float yz = q0[1] * q0[2];
-	float xw = q0[0] * q0[3];
-	result[0] = (1.0) - (2.0) * (yy + zz);
-	result[1] = (2.0) * (xy + zw);
-	result[2] = (2.0) * (xz - yw);
-	result[3] = (0.0);
-	result[4] = (2.0) * (xy - zw);
-	result[5] = (1.0) - (2.0) * (xx + zz);
-	result[6] = (2.0) * (yz + xw);
-	result[7] = (0.0);
-	result[8] = (2.0) * (xz + yw);
-	result[9] = (2.0) * (yz - xw);
-	result[10] = (1.0) - (2.0) * (xx + yy);
-	result[11] = (0.0);
-	result[12] = (0.0);
-	result[13] = (0.0);
-	result[14] = (0.0);
-	result[15] = (1.0);
-}
-
-void matrix_inverse(float *result, float *m0) {
-	float inverse[16];
-	float inverted_determinant;
-	float m11 = m0[0];
-	float m21 = m0[1];
-	float m31 = m0[2];
-	float m41 = m0[3];
-	float m12 = m0[4];
-	float m22 = m0[5];
-	float m32 = m0[6];
-	float m42 = m0[7];
-	float m13 = m0[8];
-	float m23 = m0[9];
-	float m33 = m0[10];
-	float m43 = m0[11];
-	float m14 = m0[12];
-	float m24 = m0[13];
-	float m34 = m0[14];
-	float m44 = m0[15];
-	inverse[0] = m22 * m33 * m44 - m22 * m43 * m34 - m23 * m32 * m44 + m23 * m42 * m34 + m24 * m32 * m43 - m24 * m42 * m33;
-	inverse[4] = -m12 * m33 * m44 + m12 * m43 * m34 + m13 * m32 * m44 - m13 * m42 * m34 - m14 * m32 * m43 + m14 * m42 * m33;
-	inverse[8] = m12 * m23 * m44 - m12 * m43 * m24 - m13 * m22 * m44 + m13 * m42 * m24 + m14 * m22 * m43 - m14 * m42 * m23;
-	inverse[12] = -m12 * m23 * m34 + m12 * m33 * m24 + m13 * m22 * m34 - m13 * m32 * m24 - m14 * m22 * m33 + m14 * m32 * m23;
-	inverse[1] = -m21 * m33 * m44 + m21 * m43 * m34 + m23 * m31 * m44 - m23 * m41 * m34 - m24 * m31 * m43 + m24 * m41 * m33;
-	inverse[5] =m11 * m33 * m44 -m11 * m43 * m34 - m13 * m31 * m44 + m13 * m41 * m34 + m14 * m31 * m43 - m14 * m41 * m33;
-	inverse[9] = -m11 * m23 * m44 +m11 * m43 * m24 + m13 * m21 * m44 - m13 * m41 * m24 - m14 * m21 * m43 + m14 * m41 * m23;
-	inverse[13] =m11 * m23 * m34 -m11 * m33 * m24 - m13 * m21 * m34 + m13 * m31 * m24 + m14 * m21 * m33 - m14 * m31 * m23;
-	inverse[2] = m21 * m32 * m44 - m21 * m42 * m34 - m22 * m31 * m44 + m22 * m41 * m34 + m24 * m31 * m42 - m24 * m41 * m32;
-	inverse[6] = -m11 * m32 * m44 +m11 * m42 * m34 + m12 * m31 * m44 - m12 * m41 * m34 - m14 * m31 * m42 + m14 * m41 * m32;
-	inverse[10] =m11 * m22 * m44 -m11 * m42 * m24 - m12 * m21 * m44 + m12 * m41 * m24 + m14 * m21 * m42 - m14 * m41 * m22;
-	inverse[14] = -m11 * m22 * m34 +m11 * m32 * m24 + m12 * m21 * m34 - m12 * m31 * m24 - m14 * m21 * m32 + m14 * m31 * m22;
-	inverse[3] = -m21 * m32 * m43 + m21 * m42 * m33 + m22 * m31 * m43 - m22 * m41 * m33 - m23 * m31 * m42 + m23 * m41 * m32;
-	inverse[7] = m11 * m32 * m43 - m11 * m42 * m33 - m12 * m31 * m43 + m12 * m41 * m33 + m13 * m31 * m42 - m13 * m41 * m32;
-	inverse[11] = -m11 * m22 * m43 + m11 * m42 * m23 + m12 * m21 * m43 - m12 * m41 * m23 - m13 * m21 * m42 + m13 * m41 * m22;
-	inverse[15] = m11 * m22 * m33 - m11 * m32 * m23 - m12 * m21 * m33 + m12 * m31 * m23 + m13 * m21 * m32 - m13 * m31 * m22;
-	inverted_determinant = (1.0) / (m11 * inverse[0] + m21 * inverse[4] + m31 * inverse[8] + m41 * inverse[12]);
-	result[0] = inverse[0] * inverted_determinant;
-	result[1] = inverse[1] * inverted_determinant;
-	result[2] = inverse[2] * inverted_determinant;
-	result[3] = inverse[3] * inverted_determinant;
-	result[4] = inverse[4] * inverted_determinant;
-	result[5] = inverse[5] * inverted_determinant;
-	result[6] = inverse[6] * inverted_determinant;
-	result[7] = inverse[7] * inverted_determinant;
-	result[8] = inverse[8] * inverted_determinant;
-	result[9] = inverse[9] * inverted_determinant;
-	result[10] = inverse[10] * inverted_determinant;
-	result[11] = inverse[11] * inverted_determinant;
-	result[12] = inverse[12] * inverted_determinant;
-	result[13] = inverse[13] * inverted_determinant;
-	result[14] = inverse[14] * inverted_determinant;
-	result[15] = inverse[15] * inverted_determinant;
-}
-
-void matrix_proj_opengl(float *proj, float left, float right, float up, float down, float near, float far) {
-        assert(near < far);
-
-        const float tan_left = tan(left);
-        const float tan_right = tan(right);
-
-        const float tan_down = tan(down);
-        const float tan_up = tan(up);
-
-        const float tan_width = tan_right - tan_left;
-        const float tan_height = (tan_up - tan_down);
-
-        const float offset = near;
-
-        proj[0] = 2 / tan_width;
-        proj[4] = 0;
-        proj[8] = (tan_right + tan_left) / tan_width;
-        proj[12] = 0;
-
-        proj[1] = 0;
-        proj[5] = 2 / tan_height;
-        proj[9] = (tan_up + tan_down) / tan_height;
-        proj[13] = 0;
-
-        proj[2] = 0;
-        proj[6] = 0;
-        proj[10] = -(far + offset) / (far - near);
-        proj[14] = -(far * (near + offset)) / (far - near);
-
-        proj[3] = 0;
-        proj[7] = 0;
-        proj[11] = -1;
-        proj[15] = 0;
-}
-
-void matrix_multiply(float *result, float *m0, float *m1) {
-	float multiplied[16];
-	multiplied[0] = m0[0] * m1[0] + m0[4] * m1[1] + m0[8] * m1[2] + m0[12] * m1[3];
-	multiplied[1] = m0[1] * m1[0] + m0[5] * m1[1] + m0[9] * m1[2] + m0[13] * m1[3];
-	multiplied[2] = m0[2] * m1[0] + m0[6] * m1[1] + m0[10] * m1[2] + m0[14] * m1[3];
-	multiplied[3] = m0[3] * m1[0] + m0[7] * m1[1] + m0[11] * m1[2] + m0[15] * m1[3];
-	multiplied[4] = m0[0] * m1[4] + m0[4] * m1[5] + m0[8] * m1[6] + m0[12] * m1[7];
-	multiplied[5] = m0[1] * m1[4] + m0[5] * m1[5] + m0[9] * m1[6] + m0[13] * m1[7];
-	multiplied[6] = m0[2] * m1[4] + m0[6] * m1[5] + m0[10] * m1[6] + m0[14] * m1[7];
-	multiplied[7] = m0[3] * m1[4] + m0[7] * m1[5] + m0[11] * m1[6] + m0[15] * m1[7];
-	multiplied[8] = m0[0] * m1[8] + m0[4] * m1[9] + m0[8] * m1[10] + m0[12] * m1[11];
-	multiplied[9] = m0[1] * m1[8] + m0[5] * m1[9] + m0[9] * m1[10] + m0[13] * m1[11];
-	multiplied[10] = m0[2] * m1[8] + m0[6] * m1[9] + m0[10] * m1[10] + m0[14] * m1[11];
-	multiplied[11] = m0[3] * m1[8] + m0[7] * m1[9] + m0[11] * m1[10] + m0[15] * m1[11];
-	multiplied[12] = m0[0] * m1[12] + m0[4] * m1[13] + m0[8] * m1[14] + m0[12] * m1[15];
-	multiplied[13] = m0[1] * m1[12] + m0[5] * m1[13] + m0[9] * m1[14] + m0[13] * m1[15];
-	multiplied[14] = m0[2] * m1[12] + m0[6] * m1[13] + m0[10] * m1[14] + m0[14] * m1[15];
-	multiplied[15] = m0[3] * m1[12] + m0[7] * m1[13] + m0[11] * m1[14] + m0[15] * m1[15];
-	result[0] = multiplied[0];
-	result[1] = multiplied[1];
-	result[2] = multiplied[2];
-	result[3] = multiplied[3];
-	result[4] = multiplied[4];
-	result[5] = multiplied[5];
-	result[6] = multiplied[6];
-	result[7] = multiplied[7];
-	result[8] = multiplied[8];
-	result[9] = multiplied[9];
-	result[10] = multiplied[10];
-	result[11] = multiplied[11];
-	result[12] = multiplied[12];
-	result[13] = multiplied[13];
-	result[14] = multiplied[14];
-	result[15] = multiplied[15];
-}
+// The programs the renderer draws with, see SHADER REGISTRY
+enum app_program_t {
+        APP_PROGRAM_BOX,
+        APP_PROGRAM_BACKGROUND,
+        APP_PROGRAM_COUNT,
+};
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// APPLICATION STATE
-////////////////////////////////////////////////////////////////////////////////////////////////////
+enum shader_program_state_t {
+        SHADER_PROGRAM_BUILDING, // Compile and link issued, the driver may still be working on them
+        SHADER_PROGRAM_READY,
+        SHADER_PROGRAM_FAILED,   // Logged when resolved, drawing with it draws nothing
+};
+
+struct shader_program_t {
+        const char *name;
+        const char *vert_src;
+        const char *frag_src;
+        shader_program_state_t state;
+        bool is_multiview;      // Which vertex shader variant it was started with
+        bool is_cached;         // Loaded from the program cache
+        bool is_store_pending;  // Resolved, not yet saved to the program cache
+        uint64_t key;           // Program cache key, when the cache is on
+        uint32_t vert_shd;      // Until resolved, when built from source
+        uint32_t frag_shd;
+        uint32_t program;
+};
+
+// The stages of the main thread's app_update we time, and the events we count, see telemetry.h.
+// PUSH_FRAME is time spent blocked on a full frame queue, i.e. waiting for the render thread.
+// SYNC_ACTIONS is only on the main thread without the input thread.
+enum app_stage_t {
+        APP_STAGE_PUMP_EVENTS,
+        APP_STAGE_SYNC_ACTIONS,
+        APP_STAGE_WAIT_FRAME,
+        APP_STAGE_GET_INPUTS,
+        APP_STAGE_TRANSFORMS,
+        APP_STAGE_PUSH_FRAME,
+        APP_STAGE_FRAME,
+        APP_STAGE_COUNT,
+};
+
+const char *APP_STAGE_NAMES[APP_STAGE_COUNT] = {
+        "pump_events",
+        "sync_actions",
+        "wait_frame",
+        "get_inputs",
+        "transforms",
+        "push_frame",
+        "frame",
+};
+
+// The stages of the render thread's frames. POP_FRAME is time spent idle waiting for the main thread
+// and isn't part of FRAME. The GPU stages come from timer queries rather than the CPU clock. The
+// pose ages are how old the controller poses were at xrEndFrame, INPUT_POSE_AGE for the ones
+// sampled on the main thread and POSE_AGE for the ones actually drawn (the same without late latch).
+enum render_stage_t {
+        RENDER_STAGE_POP_FRAME,
+        RENDER_STAGE_BEGIN_FRAME,
+        RENDER_STAGE_LOCATE_VIEWS,
+        RENDER_STAGE_LATE_LATCH,
+        RENDER_STAGE_DRAW,
+        RENDER_STAGE_END_FRAME,
+        RENDER_STAGE_FRAME,
+        RENDER_STAGE_GPU_CLEAR,
+        RENDER_STAGE_GPU_BOXES,
+        RENDER_STAGE_GPU_BACKGROUND,
+        RENDER_STAGE_GPU_VIEW_0,
+        RENDER_STAGE_GPU_VIEW_1,
+        RENDER_STAGE_INPUT_POSE_AGE,
+        RENDER_STAGE_POSE_AGE,
+        RENDER_STAGE_COUNT,
+};
+
+const char *RENDER_STAGE_NAMES[RENDER_STAGE_COUNT] = {
+        "pop_frame",
+        "begin_frame",
+        "locate_views",
+        "late_latch",
+        "draw",
+        "end_frame",
+        "frame",
+        "gpu_clear",
+        "gpu_boxes",
+        "gpu_background",
+        "gpu_view_0",
+        "gpu_view_1",
+        "input_pose_age",
+        "pose_age",
+};
+
+// Frames the runtime told us not to render, split by whether the session was visible at the time
+// (hidden means the runtime's not showing us, visible means it dropped a frame it could've shown),
+// and frames whose predicted display time skipped at least one display period. Trigger edges are
+// presses and releases seen, input dropped is samples lost to a full input ring.
+enum app_counter_t {
+        APP_COUNTER_NOT_RENDERED,
+        APP_COUNTER_NOT_RENDERED_HIDDEN,
+        APP_COUNTER_NOT_RENDERED_VISIBLE,
+        APP_COUNTER_MISSED_DISPLAY,
+        APP_COUNTER_TRIGGER_EDGES,
+        APP_COUNTER_INPUT_DROPPED,
+        APP_COUNTER_COUNT,
+};
+
+const char *APP_COUNTER_NAMES[APP_COUNTER_COUNT] = {
+        "not_rendered",
+        "not_rendered_hidden",
+        "not_rendered_visible",
+        "missed_display",
+        "trigger_edges",
+        "input_dropped",
+};
 
 // Some array length defines for readability
 #define HAND_COUNT (2)
 #define MAX_VIEWS (4)
 #define MAX_SWAPCHAIN_LENGTH (3)
 
+// Objects per job when per-frame work is spread across the job system, below this it runs inline
+#define TRANSFORM_BATCH (64)
+
+// How often the input thread samples the controllers (the host can override it with --input-hz), and
+// how many trigger presses and releases a frame keeps, any more are only counted
+#define INPUT_SAMPLE_RATE_HZ (500)
+#define MAX_INPUT_EDGES (16)
+
+// Without a running session, how long the event pump sleeps between looks for runtime events, which
+// don't come through anything we can block on
+#define IDLE_POLL_MS (100)
+
+static_assert(INPUT_HAND_COUNT == HAND_COUNT, "input samples should cover every hand");
+
+// A trigger click pressed or released. change_time is the runtime's lastChangeTime, sample_time when
+// we saw it (CLOCK_MONOTONIC ns).
+struct input_edge_t {
+        XrTime change_time;
+        int64_t sample_time;
+        int hand;
+        bool is_pressed;
+};
+
+// GPU timestamps taken in each view's pass, the pass times are the differences between them
+enum gpu_mark_t {
+        GPU_MARK_BEGIN,
+        GPU_MARK_CLEARED,
+        GPU_MARK_BOXES,
+        GPU_MARK_BACKGROUND,
+        GPU_MARK_COUNT,
+};
+
+// Frames of timer queries in flight, a frame's results are read back this many frames later so
+// reading them never waits on the GPU
+#define GPU_TIMER_FRAMES (4)
+
+// Frames in flight between the main and render threads. Two lets the main thread wait on and sample
+// the next frame while the render thread submits the current one, more would only add latency.
+#define FRAME_PACKET_COUNT (2)
+
+// Everything the render thread needs from the main thread to submit a frame, copied in by value so
+// the main thread can move on to the next frame straight away. The render thread owns a packet
+// until it's done with it, so late latching updates the poses in place.
+struct frame_packet_t {
+        XrFrameState frame_state;
+        bool should_render;
+        bool is_exit; // Tells the render thread to stop instead of rendering
+
+        // Controller inputs and per-frame transforms (computed once per frame, shared by every view).
+        // The times are when the hands were located, on the main thread and most recently.
+        int64_t input_pose_time;
+        int64_t pose_time;
+        XrSpaceLocation hand_locations[HAND_COUNT];
+        XrActionStateFloat trigger_states[HAND_COUNT];
+        XrActionStateBoolean trigger_click_states[HAND_COUNT];
+        input_edge_t trigger_edges[MAX_INPUT_EDGES]; // Since the frame before, oldest first
+        int trigger_edge_count;
+        float hand_models[HAND_COUNT][16];
+};
+
 struct app_t {
-        // Native app glue
-        android_app *app;
-        bool is_window_init;
+        // OS specifics, see platform.h
+        platform_t *platform;
 
         // EGL state required to initialise OpenXR
         EGLDisplay egl_display;
@@ -352,6 +462,7 @@ struct app_t {
         XrInstance instance;
         XrSystemId system;
         XrSession session;
+        PFN_xrLocateSpacesKHR xr_locate_spaces; // NULL without XR_KHR_locate_spaces
 
         // Views
         uint32_t view_count;
@@ -379,7 +490,8 @@ struct app_t {
         XrAction vibrate_action;
         XrAction menu_action;
 
-        // Swapchains
+        // Swapchains, one per view, or a single array swapchain with a layer per view when multiview
+        uint32_t swapchain_count;
         int32_t swapchain_widths[MAX_VIEWS];
         int32_t swapchain_heights[MAX_VIEWS];
         uint32_t swapchain_lengths[MAX_VIEWS];
@@ -387,15 +499,84 @@ struct app_t {
 	XrSwapchainImageOpenGLESKHR swapchain_images[MAX_VIEWS][MAX_SWAPCHAIN_LENGTH];
 
         // OpenGL state
-        uint32_t box_program;
-        uint32_t background_program;
-        uint32_t framebuffer;
+        shader_program_t programs[APP_PROGRAM_COUNT];
+        bool is_program_cache;   // Set before app_init, cleared there if the driver can't do binaries
+        bool is_parallel_shader_compile;
+        int programs_loaded;     // From the program cache
+        int programs_compiled;   // From source
+        int64_t shaders_start_time;
+        uint32_t framebuffers[MAX_VIEWS][MAX_SWAPCHAIN_LENGTH]; // One per swapchain image
         uint32_t depth_targets[MAX_VIEWS];
+        bool is_depth_renderbuffer;
+
+        // Multiview (single pass stereo) state
+        bool is_multiview;
+        uint32_t view_proj_buffer;
+        PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC gl_framebuffer_texture_multiview;
+
+        // GPU timer queries, a pool of GPU_TIMER_FRAMES frames used round robin
+        bool is_gpu_timer;
+        PFNGLQUERYCOUNTEREXTPROC gl_query_counter;
+        PFNGLGETQUERYOBJECTUI64VEXTPROC gl_get_query_object_ui64v;
+        uint32_t gpu_timer_queries[GPU_TIMER_FRAMES][MAX_VIEWS][GPU_MARK_COUNT];
+        uint32_t gpu_timer_view_counts[GPU_TIMER_FRAMES]; // Views timed in each frame, 0 when free
+        uint32_t gpu_timer_frame;
 
         // Current Controller Inputs
+        int64_t hand_locate_time;
         XrSpaceLocation hand_locations[HAND_COUNT];
         XrActionStateFloat trigger_states[HAND_COUNT];
         XrActionStateBoolean trigger_click_states[HAND_COUNT];
+        input_edge_t trigger_edges[MAX_INPUT_EDGES];
+        int trigger_edge_count;
+
+        // Input sampling thread, sampling while the session runs and parked in between. Samples go
+        // through input_ring, see INPUT SAMPLING.
+        input_ring_t input_ring;
+        int64_t input_sample_period_ns;
+        uint32_t input_dropped_seen;
+        std::atomic<uint32_t> input_request; // Bumped by the main thread, odd while it should sample
+        std::atomic<uint32_t> input_parked;  // The last even input_request the thread parked for
+        std::atomic<bool> is_input_quitting;
+        bool is_input_thread;                // Created, at the first session begin
+        bool is_input_running;               // Between app_start_input_thread and app_stop_input_thread
+        pthread_t input_thread;
+
+        // Input record and replay, see INPUT RECORD AND REPLAY. A frame's record is filled in as its
+        // inputs arrive. is_replay stays set once the log runs out, the render thread reads it.
+        int64_t frames_waited;
+        input_log_t record_log;
+        input_log_t replay_log;
+        bool is_replay;
+        input_log_frame_t record_frame;
+        input_log_frame_t replay_frame;
+
+        // Tracked spaces located once per frame, the hands are the first HAND_COUNT. The main thread
+        // samples them after xrWaitFrame, the render thread late latches with its own copy.
+        pose_cache_t pose_cache;
+        pose_cache_t late_pose_cache;
+
+        // Per-frame Transforms (computed once per frame, shared by every view)
+        float hand_models[HAND_COUNT][16];
+
+        // Worker pool for per-frame CPU work, the main thread is thread 0. job_worker_count is set
+        // before app_init, -1 for one per core.
+        jobs_t jobs;
+        int job_worker_count;
+
+        // Frame timing telemetry for each thread, allocated once at init
+        telemetry_t *telemetry;
+        telemetry_t *render_telemetry;
+        XrTime last_display_time;
+
+        // Frame packets handed from the main thread to the render thread, a single producer single
+        // consumer ring. Each side only writes its own counter, see FRAME HANDOFF.
+        frame_packet_t frame_packets[FRAME_PACKET_COUNT];
+        std::atomic<uint32_t> frames_pushed;
+        std::atomic<uint32_t> frames_done;
+        std::atomic<uint32_t> is_push_waiting; // The main thread is asleep on frames_done
+        std::atomic<uint32_t> is_pop_waiting;  // The render thread is asleep on frames_pushed
+        pthread_t render_thread;
 
         // Session State
         XrSessionState session_state;
@@ -405,6 +586,13 @@ struct app_t {
         bool is_session_ready;
         bool is_session_begin_ever;
 
+        // Idle between sessions, see app_update_pump_events. A stretch starts at the first pump
+        // without a session, wall and process CPU times are taken then to report at its end.
+        bool is_idle;
+        int64_t idle_pump_count;
+        int64_t idle_start_time;
+        int64_t idle_start_cpu_time;
+
         // Frame Submission
         uint32_t view_submit_count;
         XrCompositionLayerProjection projection_layer;
@@ -415,75 +603,17 @@ struct app_t {
 // APPLICATION INIT
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-// Callback handling android commands
-extern "C" void app_android_handle_cmd(android_app *app, int32_t cmd) {
-        app_t *a = (app_t *)app->userData;
-
-        switch (cmd) {
-        case APP_CMD_DESTROY:
-                // Handle application shutdown
-                ANativeActivity_finish(app->activity);
-                // TODO: call app_shutdown
-                break;
-        case APP_CMD_INIT_WINDOW:
-                if (!a->is_window_init) {
-                        a->is_window_init = true;
-                        printf( "Got start event\n" );
-                }
-                else {
-                        // TODO: Handle Resume
-                }
-                break;
-        case APP_CMD_TERM_WINDOW:
-                // Turns up when focus is lost
-                // Seems like the main loop just xrWaitFrame hitches
-        	break;
-        case APP_CMD_SAVE_STATE:
-                printf("Saving application state\n");
-                app->savedState = malloc(sizeof(app_t));
-                memcpy(app->savedState, a, sizeof(app_t));
-                app->savedStateSize = sizeof(app_t);
-                break;
-        case APP_CMD_RESUME:
-                // Nope, that doesn't work
-                // printf("Resumed, loading state\n");
-                // memcpy(a, app->savedState, sizeof(app_t));
-                break;
-        // TODO: APP_CMD_SAVE_STATE
-        default:
-                printf("event not handled: %d\n", cmd);
-        }
-}
-
-// Sets command callback and userdata on the android app object and blocks until the window is ready
-void app_set_callbacks_and_wait(app_t *a, android_app *app) {
-        a->app = app;
-        app->userData = a;
-        app->onAppCmd = app_android_handle_cmd;
-        
-        int events;
-        while (!a->is_window_init) {
-                struct android_poll_source *source;
-                if ( ALooper_pollAll( 0, 0, &events, (void **)&source ) >= 0 ) {
-                        if (source != NULL) {
-                                source->process(app, source);
-                        }
-                }
-        }
-        printf("Window Initialized\n");
-}
-
 // Initialise EGL resources and context, needed later to pass to OpenXR
 void app_init_egl(app_t *a) {
         // Display
-        a->egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        a->egl_display = platform_get_egl_display(a->platform);
         assert(a->egl_display != EGL_NO_DISPLAY);
         EGLint egl_major, egl_minor;
         int egl_init_success = eglInitialize(a->egl_display, &egl_major, &egl_minor);
         assert(egl_init_success);
-        printf("EGL Version: \"%s\"\n", eglQueryString(a->egl_display, EGL_VERSION));
-        printf("EGL Vendor: \"%s\"\n", eglQueryString(a->egl_display, EGL_VENDOR));
-        printf("EGL Extensions: \"%s\"\n", eglQueryString(a->egl_display, EGL_EXTENSIONS));
+        SLOG_INFO("EGL Version: \"%s\"\n", eglQueryString(a->egl_display, EGL_VERSION));
+        SLOG_INFO("EGL Vendor: \"%s\"\n", eglQueryString(a->egl_display, EGL_VENDOR));
+        SLOG_INFO("EGL Extensions: \"%s\"\n", eglQueryString(a->egl_display, EGL_EXTENSIONS));
 
         // Config
         EGLint num_config;
@@ -497,56 +627,100 @@ void app_init_egl(app_t *a) {
                 EGL_DEPTH_SIZE, 16, // Maybe 32?
                 //EGL_SAMPLES, 1,
                 EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+                EGL_SURFACE_TYPE, platform_get_egl_surface_type(a->platform),
                 EGL_NONE
         };
         eglChooseConfig(a->egl_display, config_attribute_list, &a->egl_config, 1, &num_config);
-        printf("Config: %d\n", num_config);
+        SLOG_INFO("Config: %d\n", num_config);
 
         // Context
-        printf("Creating Context\n");
+        SLOG_INFO("Creating Context\n");
         static const EGLint context_attribute_list[] = {
                 EGL_CONTEXT_CLIENT_VERSION, 2,
                 EGL_NONE
         };
         a->egl_context = eglCreateContext(a->egl_display, a->egl_config, EGL_NO_CONTEXT, context_attribute_list);
         assert(a->egl_context != EGL_NO_CONTEXT);
-        printf("Context Created %p\n", a->egl_context);
+        SLOG_INFO("Context Created %p\n", a->egl_context);
 
         // Surface
-        assert(a->app->window);
-        int win_width = ANativeWindow_getWidth(a->app->window);
-        int win_height = ANativeWindow_getHeight(a->app->window);
-        printf("Width/Height: %dx%d\n", win_width, win_height);
-        EGLint window_attribute_list[] = { EGL_NONE };
-        a->egl_surface = eglCreateWindowSurface(a->egl_display, a->egl_config, a->app->window, window_attribute_list);
-        printf("Got Surface: %p\n", a->egl_surface);
-        assert(a->egl_surface != EGL_NO_SURFACE);
+        a->egl_surface = platform_create_egl_surface(a->platform, a->egl_display, a->egl_config);
 
         // Make Current
         int egl_make_current_success = eglMakeCurrent(a->egl_display, a->egl_surface, a->egl_surface, a->egl_context);
         assert(egl_make_current_success);
 
         // Make some OpenGL calls
-        printf("GL Vendor: \"%s\"\n", glGetString(GL_VENDOR));
-        printf("GL Renderer: \"%s\"\n", glGetString(GL_RENDERER));
-        printf("GL Version: \"%s\"\n", glGetString(GL_VERSION));
-        printf("GL Extensions: \"%s\"\n", glGetString(GL_EXTENSIONS));
+        SLOG_INFO("GL Vendor: \"%s\"\n", glGetString(GL_VENDOR));
+        SLOG_INFO("GL Renderer: \"%s\"\n", glGetString(GL_RENDERER));
+        SLOG_INFO("GL Version: \"%s\"\n", glGetString(GL_VERSION));
+        SLOG_INFO("GL Extensions: \"%s\"\n", glGetString(GL_EXTENSIONS));
+}
+
+// Returns true if the current GL context exposes the named extension
+bool app_has_gl_extension(const char *name) {
+        GLint extension_count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+        for (int i = 0; i < extension_count; i++) {
+                if (!strcmp(name, (const char *)glGetStringi(GL_EXTENSIONS, i))) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+// Check for the optional GL extensions we make use of, and load their entry points
+void app_init_opengl_extensions(app_t *a) {
+        a->is_multiview = false;
+        if (ENABLE_MULTIVIEW && app_has_gl_extension("GL_OVR_multiview2")) {
+                a->gl_framebuffer_texture_multiview = (PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC)eglGetProcAddress("glFramebufferTextureMultiviewOVR");
+                a->is_multiview = a->gl_framebuffer_texture_multiview != NULL;
+        }
+        SLOG_INFO("Multiview: %s\n", a->is_multiview ? "enabled" : "disabled");
+
+        // Timestamps need a non zero counter width, some drivers expose the extension without them
+        a->is_gpu_timer = false;
+        if (ENABLE_GPU_TIMERS && app_has_gl_extension("GL_EXT_disjoint_timer_query")) {
+                a->gl_query_counter = (PFNGLQUERYCOUNTEREXTPROC)eglGetProcAddress("glQueryCounterEXT");
+                a->gl_get_query_object_ui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+                PFNGLGETQUERYIVEXTPROC gl_get_queryiv = (PFNGLGETQUERYIVEXTPROC)eglGetProcAddress("glGetQueryivEXT");
+                GLint timestamp_bits = 0;
+                if (gl_get_queryiv) {
+                        gl_get_queryiv(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &timestamp_bits);
+                }
+                a->is_gpu_timer = a->gl_query_counter && a->gl_get_query_object_ui64v && timestamp_bits > 0;
+        }
+        SLOG_INFO("GPU Timers: %s\n", a->is_gpu_timer ? "enabled" : "disabled");
+}
+
+// Create the pool of timer queries
+void app_init_opengl_gpu_timers(app_t *a) {
+        if (!a->is_gpu_timer) { return; }
+        glGenQueries(GPU_TIMER_FRAMES * MAX_VIEWS * GPU_MARK_COUNT, &a->gpu_timer_queries[0][0][0]);
+        memset(a->gpu_timer_view_counts, 0, sizeof(a->gpu_timer_view_counts));
+        a->gpu_timer_frame = 0;
+}
+
+void app_destroy_opengl_gpu_timers(app_t *a) {
+        if (!a->is_gpu_timer) { return; }
+        glDeleteQueries(GPU_TIMER_FRAMES * MAX_VIEWS * GPU_MARK_COUNT, &a->gpu_timer_queries[0][0][0]);
+}
+
+// Returns true if the runtime's extension list has the named extension
+bool app_has_xr_extension(const XrExtensionProperties *extension_properties, uint32_t extension_count, const char *name) {
+        for (int i = 0; i < extension_count; i++) {
+                if (!strcmp(name, extension_properties[i].extensionName)) {
+                        return true;
+                }
+        }
+        return false;
 }
 
-// Initialise the loader, ensure we have the extensions we need, and create the OpenXR instance
+// Ensure we have the extensions we need, and create the OpenXR instance. The loader must be
+// initialised first.
 void app_init_xr_create_instance(app_t *a) {
         XrResult result;
 
-        // Loader
-        PFN_xrInitializeLoaderKHR loader_func;
-	result = xrGetInstanceProcAddr(XR_NULL_HANDLE, "xrInitializeLoaderKHR", (PFN_xrVoidFunction*)&loader_func);
-        assert(XR_SUCCEEDED(result));
-	XrLoaderInitInfoAndroidKHR init_data = { XR_TYPE_LOADER_INIT_INFO_ANDROID_KHR };
-	init_data.applicationVM = a->app->activity->vm;
-	init_data.applicationContext = a->app->activity->clazz;
-	result = loader_func((XrLoaderInitInfoBaseHeaderKHR*)&init_data);
-        assert(XR_SUCCEEDED(result));
-
         // Enumerate Extensions
         XrExtensionProperties extension_properties[128];
 	uint32_t extension_count = 0;
@@ -559,27 +733,39 @@ void app_init_xr_create_instance(app_t *a) {
         }
         result = xrEnumerateInstanceExtensionProperties(NULL, extension_count, &extension_count, extension_properties);
         assert(XR_SUCCEEDED(result));
-        printf("OpenXR Extension Count: %d\n", extension_count);
+        SLOG_INFO("OpenXR Extension Count: %d\n", extension_count);
         for (int i=0; i < extension_count; i++) {
-                printf("        %s\n", extension_properties[i].extensionName);
+                SLOG_DEBUG("        %s\n", extension_properties[i].extensionName);
         }
 
-        // Check for GLES Extension
-	bool is_gles_supported = false;
-	for(int i = 0; i < extension_count; i++ ) {
-		if (!strcmp("XR_KHR_opengl_es_enable", extension_properties[i].extensionName)) {
-			is_gles_supported = true;
-		}
-	}
-        assert(is_gles_supported);
-        printf("OpenXR OpenGL ES extension found\n");
+        // Check for GLES Extension (and the EGL binding extension on the host)
+#ifdef XR_USE_PLATFORM_ANDROID
+	const char* const required_extensions[] = {"XR_KHR_opengl_es_enable"};
+#else
+	const char* const required_extensions[] = {"XR_KHR_opengl_es_enable", "XR_MNDX_egl_enable"};
+#endif
+        const uint32_t required_extension_count = sizeof(required_extensions) / sizeof(required_extensions[0]);
+        const char *enabledExtensions[8];
+        uint32_t enabled_extension_count = 0;
+        for (int j = 0; j < required_extension_count; j++) {
+                bool is_supported = app_has_xr_extension(extension_properties, extension_count, required_extensions[j]);
+                assert(is_supported);
+                SLOG_INFO("OpenXR %s extension found\n", required_extensions[j]);
+                enabledExtensions[enabled_extension_count++] = required_extensions[j];
+        }
+
+        // Optional extensions, used when the runtime has them
+        bool is_locate_spaces = app_has_xr_extension(extension_properties, extension_count, XR_KHR_LOCATE_SPACES_EXTENSION_NAME);
+        if (is_locate_spaces) {
+                SLOG_INFO("OpenXR %s extension found\n", XR_KHR_LOCATE_SPACES_EXTENSION_NAME);
+                enabledExtensions[enabled_extension_count++] = XR_KHR_LOCATE_SPACES_EXTENSION_NAME;
+        }
 
         // Create Instance
-	const char* const enabledExtensions[] = {"XR_KHR_opengl_es_enable"};
 	XrInstanceCreateInfo instance_desc = { XR_TYPE_INSTANCE_CREATE_INFO };
 	instance_desc.next = NULL;
 	instance_desc.createFlags = 0;
-	instance_desc.enabledExtensionCount = 1;
+	instance_desc.enabledExtensionCount = enabled_extension_count;
 	instance_desc.enabledExtensionNames = enabledExtensions;
 	instance_desc.enabledApiLayerCount = 0;
 	instance_desc.enabledApiLayerNames = NULL;
@@ -591,17 +777,30 @@ void app_init_xr_create_instance(app_t *a) {
 	result = xrCreateInstance(&instance_desc, &a->instance);
         assert(XR_SUCCEEDED(result));
 
+        // Batched space location, see pose_cache.h
+        a->xr_locate_spaces = NULL;
+        if (is_locate_spaces) {
+                result = xrGetInstanceProcAddr(a->instance, "xrLocateSpacesKHR", (PFN_xrVoidFunction *)&a->xr_locate_spaces);
+                assert(XR_SUCCEEDED(result));
+        }
+        SLOG_INFO("OpenXR Batched Space Location: %s\n", a->xr_locate_spaces ? "yes" : "no");
+
         // Instance Properties
         XrInstanceProperties instance_props = { XR_TYPE_INSTANCE_PROPERTIES };
         instance_props.next = NULL;
         result = xrGetInstanceProperties(a->instance, &instance_props);
         assert(XR_SUCCEEDED(result));
-        printf("Runtime Name: %s\n", instance_props.runtimeName);
-        printf("Runtime Name: %s\n", instance_props.runtimeName);
-        printf("Runtime Version: %d.%d.%d\n",
+        SLOG_INFO("Runtime Name: %s\n", instance_props.runtimeName);
+        SLOG_INFO("Runtime Name: %s\n", instance_props.runtimeName);
+        SLOG_INFO("Runtime Version: %d.%d.%d\n",
                 XR_VERSION_MAJOR(instance_props.runtimeVersion),
                 XR_VERSION_MINOR(instance_props.runtimeVersion),
                 XR_VERSION_PATCH(instance_props.runtimeVersion));
+}
+
+// Print the API layers the loader knows about
+void app_init_xr_enum_layers(app_t *a) {
+        XrResult result;
 
         // Enumerate API Layers
         XrApiLayerProperties layer_props[64];
@@ -614,9 +813,9 @@ void app_init_xr_create_instance(app_t *a) {
         }
         result = xrEnumerateApiLayerProperties(layer_count, &layer_count, layer_props);
         assert(XR_SUCCEEDED(result));
-        printf("OpenXR API Layers: %d\n", layer_count);
+        SLOG_INFO("OpenXR API Layers: %d\n", layer_count);
         for (int i=0; i < layer_count; i++) {
-                printf("        %s, %s\n", layer_props[i].layerName, layer_props[i].description);
+                SLOG_DEBUG("        %s, %s\n", layer_props[i].layerName, layer_props[i].description);
         }
 }
 
@@ -633,12 +832,12 @@ void app_init_xr_get_system(app_t *a) {
         result = xrGetSystemProperties(a->instance, a->system, &system_props);
         assert(XR_SUCCEEDED(result));
 
-        printf("System properties for system \"%s\":\n", system_props.systemName);
-        printf("	maxLayerCount: %d\n", system_props.graphicsProperties.maxLayerCount);
-        printf("	maxSwapChainImageHeight: %d\n", system_props.graphicsProperties.maxSwapchainImageHeight);
-        printf("	maxSwapChainImageWidth: %d\n", system_props.graphicsProperties.maxSwapchainImageWidth);
-        printf("	Orientation Tracking: %s\n", system_props.trackingProperties.orientationTracking ? "true" : "false");
-        printf("	Position Tracking: %s\n", system_props.trackingProperties.positionTracking ? "true" : "false");
+        SLOG_INFO("System properties for system \"%s\":\n", system_props.systemName);
+        SLOG_INFO("	maxLayerCount: %d\n", system_props.graphicsProperties.maxLayerCount);
+        SLOG_INFO("	maxSwapChainImageHeight: %d\n", system_props.graphicsProperties.maxSwapchainImageHeight);
+        SLOG_INFO("	maxSwapChainImageWidth: %d\n", system_props.graphicsProperties.maxSwapchainImageWidth);
+        SLOG_INFO("	Orientation Tracking: %s\n", system_props.trackingProperties.orientationTracking ? "true" : "false");
+        SLOG_INFO("	Position Tracking: %s\n", system_props.trackingProperties.positionTracking ? "true" : "false");
 }
 
 // Enumerate the views (perspectives we need to render) and print their properties
@@ -655,15 +854,15 @@ void app_init_xr_enum_views(app_t *a) {
         }
         result = xrEnumerateViewConfigurationViews(a->instance, a->system, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, a->view_count, &a->view_count, a->view_configs);
         assert(XR_SUCCEEDED(result));
-        printf("%d view_configs:\n", a->view_count);
+        SLOG_INFO("%d view_configs:\n", a->view_count);
         for (int i = 0; i < a->view_count; i++) {
-                printf("	view_configs[%d]:\n", i);
-                printf("		recommendedImageRectWidth: %d\n", a->view_configs[i].recommendedImageRectWidth);
-                printf("		maxImageRectWidth: %d\n", a->view_configs[i].maxImageRectWidth);
-                printf("		recommendedImageRectHeight: %d\n", a->view_configs[i].recommendedImageRectHeight);
-                printf("		maxImageRectHeight: %d\n", a->view_configs[i].maxImageRectHeight);
-                printf("		recommendedSwapchainSampleCount: %d\n", a->view_configs[i].recommendedSwapchainSampleCount);
-                printf("		maxSwapchainSampleCount: %d\n", a->view_configs[i].maxSwapchainSampleCount);
+                SLOG_INFO("	view_configs[%d]:\n", i);
+                SLOG_INFO("		recommendedImageRectWidth: %d\n", a->view_configs[i].recommendedImageRectWidth);
+                SLOG_INFO("		maxImageRectWidth: %d\n", a->view_configs[i].maxImageRectWidth);
+                SLOG_INFO("		recommendedImageRectHeight: %d\n", a->view_configs[i].recommendedImageRectHeight);
+                SLOG_INFO("		maxImageRectHeight: %d\n", a->view_configs[i].maxImageRectHeight);
+                SLOG_INFO("		recommendedSwapchainSampleCount: %d\n", a->view_configs[i].recommendedSwapchainSampleCount);
+                SLOG_INFO("		maxSwapchainSampleCount: %d\n", a->view_configs[i].maxSwapchainSampleCount);
         }
 }
 
@@ -680,7 +879,12 @@ void app_init_xr_create_session(app_t *a) {
 	const XrVersion egl_version = XR_MAKE_VERSION(3, 2, 0);
         assert(egl_version >= xr_gles_reqs.minApiVersionSupported && egl_version <= xr_gles_reqs.maxApiVersionSupported);
 
+#ifdef XR_USE_PLATFORM_ANDROID
 	XrGraphicsBindingOpenGLESAndroidKHR gl_binding = { XR_TYPE_GRAPHICS_BINDING_OPENGL_ES_ANDROID_KHR };
+#else
+	XrGraphicsBindingEGLMNDX gl_binding = { XR_TYPE_GRAPHICS_BINDING_EGL_MNDX };
+	gl_binding.getProcAddress = eglGetProcAddress;
+#endif
 	gl_binding.display = a->egl_display;
 	gl_binding.config = a->egl_config;
 	gl_binding.context = a->egl_context;
@@ -705,20 +909,20 @@ void app_init_xr_create_stage_space(app_t *a) {
         }
         result = xrEnumerateReferenceSpaces(a->session, reference_spaces_count, &reference_spaces_count, reference_spaces);
         assert(XR_SUCCEEDED(result));
-        printf("Reference Spaces:\n");
+        SLOG_INFO("Reference Spaces:\n");
         for (int i = 0; i < reference_spaces_count; i++) {
                 switch (reference_spaces[i]) {
                 case XR_REFERENCE_SPACE_TYPE_VIEW:
-                        printf("	XR_REFERENCE_SPACE_TYPE_VIEW\n");
+                        SLOG_INFO("	XR_REFERENCE_SPACE_TYPE_VIEW\n");
                         break;
                 case XR_REFERENCE_SPACE_TYPE_LOCAL:
-                        printf("	XR_REFERENCE_SPACE_TYPE_LOCAL\n");
+                        SLOG_INFO("	XR_REFERENCE_SPACE_TYPE_LOCAL\n");
                         break;
                 case XR_REFERENCE_SPACE_TYPE_STAGE:
-                        printf("	XR_REFERENCE_SPACE_TYPE_STAGE\n");
+                        SLOG_INFO("	XR_REFERENCE_SPACE_TYPE_STAGE\n");
                         break;
                 default:
-                        printf("	XR_REFERENCE_SPACE_TYPE_%d\n", reference_spaces[i]);
+                        SLOG_INFO("	XR_REFERENCE_SPACE_TYPE_%d\n", reference_spaces[i]);
                         break;
                 }
         }
@@ -733,7 +937,7 @@ void app_init_xr_create_stage_space(app_t *a) {
         assert(XR_SUCCEEDED(result));
 }
 
-// Create the action set, actions, interaction profile, and attach the action set to the session
+// Create the action set, actions and interaction profile, which only need the instance
 void app_init_xr_create_actions(app_t *a) {
         XrResult result;
 
@@ -851,6 +1055,11 @@ void app_init_xr_create_actions(app_t *a) {
         suggested_bindings.countSuggestedBindings = sizeof(bindings) / sizeof(bindings[0]);
         result = xrSuggestInteractionProfileBindings(a->instance, &suggested_bindings);
         assert(XR_SUCCEEDED(result));
+}
+
+// Create the hand spaces, and attach the action set to the session
+void app_init_xr_attach_actions(app_t *a) {
+        XrResult result;
 
         // Hand Spaces
 	XrActionSpaceCreateInfo action_space_desc = { XR_TYPE_ACTION_SPACE_CREATE_INFO };
@@ -874,7 +1083,19 @@ void app_init_xr_create_actions(app_t *a) {
         assert(XR_SUCCEEDED(result));
 }
 
-// Choose a swapchain format, and create a swapchain per view
+// Register the spaces located every frame, relative to the stage. Each thread that locates them
+// gets its own cache.
+void app_init_xr_pose_caches(app_t *a) {
+        pose_cache_init(&a->pose_cache, a->session, a->stage_space, a->xr_locate_spaces);
+        pose_cache_init(&a->late_pose_cache, a->session, a->stage_space, a->xr_locate_spaces);
+        for (int i = 0; i < HAND_COUNT; i++) {
+                int index = pose_cache_add(&a->pose_cache, a->hand_spaces[i]);
+                assert(index == i);
+                pose_cache_add(&a->late_pose_cache, a->hand_spaces[i]);
+        }
+}
+
+// Choose a swapchain format, and create a swapchain per view (or one array swapchain for multiview)
 void app_init_xr_create_swapchains(app_t *a) {
         XrResult result;
 
@@ -899,7 +1120,25 @@ void app_init_xr_create_swapchains(app_t *a) {
                 }
         }
 
-	for (int i = 0; i < a->view_count; i++) {
+        // Multiview renders every view into its own layer of a single array swapchain, which needs
+        // the views to be the same size and to match the num_views baked into the shaders
+        if (a->is_multiview) {
+                for (int i = 1; i < a->view_count; i++) {
+                        if (a->view_configs[i].recommendedImageRectWidth != a->view_configs[0].recommendedImageRectWidth ||
+                            a->view_configs[i].recommendedImageRectHeight != a->view_configs[0].recommendedImageRectHeight) {
+                                a->is_multiview = false;
+                        }
+                }
+                if (a->view_count != 2) {
+                        a->is_multiview = false;
+                }
+                if (!a->is_multiview) {
+                        SLOG_INFO("Multiview: disabled, views are not a matching pair\n");
+                }
+        }
+        a->swapchain_count = a->is_multiview ? 1 : a->view_count;
+
+	for (int i = 0; i < a->swapchain_count; i++) {
                 // Create Swapchain
 		XrSwapchainCreateInfo swapchain_desc = { XR_TYPE_SWAPCHAIN_CREATE_INFO };
 		swapchain_desc.createFlags = 0;
@@ -909,7 +1148,7 @@ void app_init_xr_create_swapchains(app_t *a) {
 		swapchain_desc.width = a->view_configs[i].recommendedImageRectWidth;
 		swapchain_desc.height = a->view_configs[i].recommendedImageRectHeight;
 		swapchain_desc.faceCount = 1;
-		swapchain_desc.arraySize = 1;
+		swapchain_desc.arraySize = a->is_multiview ? a->view_count : 1;
 		swapchain_desc.mipCount = 1;
 		result = xrCreateSwapchain(a->session, &swapchain_desc, &a->swapchains[i]);
                 assert(XR_SUCCEEDED(result));
@@ -928,124 +1167,807 @@ void app_init_xr_create_swapchains(app_t *a) {
                 assert(XR_SUCCEEDED(result));
 	}
 
-        printf("Swapchains:\n");
-        for (int i = 0; i < a->view_count; i++) {
-                printf("        width: %d\n", a->swapchain_widths[i]);
-                printf("        height: %d\n", a->swapchain_heights[i]);
-                printf("        length: %d\n", a->swapchain_lengths[i]);
+        SLOG_INFO("Swapchains:\n");
+        for (int i = 0; i < a->swapchain_count; i++) {
+                SLOG_INFO("        width: %d\n", a->swapchain_widths[i]);
+                SLOG_INFO("        height: %d\n", a->swapchain_heights[i]);
+                SLOG_INFO("        length: %d\n", a->swapchain_lengths[i]);
+                SLOG_INFO("        layers: %d\n", a->is_multiview ? a->view_count : 1);
         }
 }
 
-// Create a framebuffer, and a depth buffer per view
+// Create a depth buffer per swapchain (a layered one for multiview), and a framebuffer per swapchain
+// image with its attachments already in place, so the frame loop only has to bind one. The
+// swapchains are made once at init and kept for the life of the app, nothing recreates them.
 void app_init_opengl_framebuffers(app_t *a) {
-        glGenFramebuffers(1, &a->framebuffer);
+        if (a->is_multiview) {
+                a->is_depth_renderbuffer = false;
+                glGenTextures(1, &a->depth_targets[0]);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, a->depth_targets[0]);
+                glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH24_STENCIL8, a->swapchain_widths[0], a->swapchain_heights[0], a->view_count);
+
+                glGenBuffers(1, &a->view_proj_buffer);
+                glBindBuffer(GL_UNIFORM_BUFFER, a->view_proj_buffer);
+                glBufferData(GL_UNIFORM_BUFFER, 2 * 16 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+                glBindBufferBase(GL_UNIFORM_BUFFER, 0, a->view_proj_buffer);
+        } else {
+                a->is_depth_renderbuffer = ENABLE_TRANSIENT_DEPTH;
+                for (int i=0; i < a->swapchain_count; i++) {
+                        int width = a->swapchain_widths[i];
+                        int height = a->swapchain_heights[i];
+
+                        if (a->is_depth_renderbuffer) {
+                                glGenRenderbuffers(1, &a->depth_targets[i]);
+                                glBindRenderbuffer(GL_RENDERBUFFER, a->depth_targets[i]);
+                                glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+                        } else {
+                                glGenTextures(1, &a->depth_targets[i]);
+                                glBindTexture(GL_TEXTURE_2D, a->depth_targets[i]);
+                                glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+                        }
+                }
+        }
 
-        for (int i=0; i < a->view_count; i++) {
-                int width = a->swapchain_widths[i];
-                int height = a->swapchain_heights[i];
+        for (int i = 0; i < a->swapchain_count; i++) {
+                glGenFramebuffers(a->swapchain_lengths[i], a->framebuffers[i]);
+                for (int j = 0; j < a->swapchain_lengths[i]; j++) {
+                        uint32_t colour_tex = a->swapchain_images[i][j].image;
+                        glBindFramebuffer(GL_FRAMEBUFFER, a->framebuffers[i][j]);
+                        if (a->is_multiview) {
+                                a->gl_framebuffer_texture_multiview(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colour_tex, 0, 0, a->view_count);
+                                a->gl_framebuffer_texture_multiview(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, a->depth_targets[i], 0, 0, a->view_count);
+                        } else if (a->is_depth_renderbuffer) {
+                                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour_tex, 0);
+                                glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, a->depth_targets[i]);
+                        } else {
+                                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour_tex, 0);
+                                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, a->depth_targets[i], 0);
+                        }
 
-                glGenTextures(1, &a->depth_targets[i]);
-                glBindTexture(GL_TEXTURE_2D, a->depth_targets[i]);
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
-                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, a->depth_targets[i], 0);
+                        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+                        if (status != GL_FRAMEBUFFER_COMPLETE) {
+                                SLOG_ERROR("Framebuffer [%d][%d] incomplete: 0x%x\n", i, j, status);
+                        }
+                        assert(status == GL_FRAMEBUFFER_COMPLETE);
+                }
         }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-// Compile the OpenGL shaders into programs
-void app_init_opengl_shaders(app_t *a) {
-        glEnable(GL_DEPTH_TEST);  
+// Delete the framebuffers and depth buffers, at shutdown
+void app_destroy_opengl_framebuffers(app_t *a) {
+        for (int i = 0; i < a->swapchain_count; i++) {
+                glDeleteFramebuffers(a->swapchain_lengths[i], a->framebuffers[i]);
+                if (a->is_depth_renderbuffer) {
+                        glDeleteRenderbuffers(1, &a->depth_targets[i]);
+                } else {
+                        glDeleteTextures(1, &a->depth_targets[i]);
+                }
+        }
+        if (a->is_multiview) {
+                glDeleteBuffers(1, &a->view_proj_buffer);
+        }
+        memset(a->framebuffers, 0, sizeof(a->framebuffers));
+        memset(a->depth_targets, 0, sizeof(a->depth_targets));
+}
 
-        // Box Program
-        uint32_t vert_shd = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vert_shd, 1, &BOX_VERT_SRC, NULL);
-        glCompileShader(vert_shd);
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SHADER REGISTRY
+//
+// Every program is started during init, straight after the GL context exists: loaded from the
+// program cache, or compiled and linked from source without looking at the results, which would
+// make each compile finish before the next starts. Drivers with GL_KHR_parallel_shader_compile
+// build them on their own threads meanwhile, and the rest of init (the OpenXR instance, session and
+// swapchains) runs on. At the end of init every program the driver has finished is resolved:
+// checked, logged and saved to the program cache. Anything still building is resolved on first use,
+// by app_get_program, which waits for it then, and is polled after every frame from then on. Saving
+// to the cache reads the binary back and writes a file, so a program resolved mid frame is only
+// saved at the next poll, between frames.
+//
+// Without the extension there is no asking whether a build has finished without waiting on it, so
+// everything is resolved at the end of init, still after the OpenXR setup.
+//
+// Programs belong to whichever thread has the GL context, the main thread during init and the
+// render thread after.
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Start compiling a shader from the version string, optional multiview defines, and source
+uint32_t app_init_opengl_shader(GLenum type, const char *src, bool is_multiview) {
+        const char *srcs[3] = { SHADER_VERSION_SRC, is_multiview ? MULTIVIEW_DEFINES_SRC : "", src };
+        uint32_t shd = glCreateShader(type);
+        glShaderSource(shd, 3, srcs, NULL);
+        glCompileShader(shd);
+        return shd;
+}
+
+void app_log_shader_errors(uint32_t shd, const char *name, const char *type) {
         int success;
-        glGetShaderiv(vert_shd, GL_COMPILE_STATUS, &success);
+        glGetShaderiv(shd, GL_COMPILE_STATUS, &success);
         if (!success) {
                 char info_log[512];
-                glGetShaderInfoLog(vert_shd, 512, NULL, info_log);
-                printf("Vertex shader compilation failed:\n %s\n", info_log);
+                glGetShaderInfoLog(shd, 512, NULL, info_log);
+                SLOG_ERROR("%s %s shader compilation failed:\n %s\n", name, type, info_log);
         }
+}
 
-        uint32_t frag_shd = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(frag_shd, 1, &BOX_FRAG_SRC, NULL);
-        glCompileShader(frag_shd);
+// Load a program from the program cache, or start compiling and linking it. Only the vertex shader
+// differs in multiview mode. The key covers every string the compiler is handed, so the multiview
+// variant keys apart.
+void app_shaders_begin(app_t *a, shader_program_t *p) {
+        p->is_multiview = a->is_multiview;
+        p->is_cached = false;
+        p->is_store_pending = false;
+        p->vert_shd = 0;
+        p->frag_shd = 0;
+        if (a->is_program_cache) {
+                p->key = program_cache_driver_hash();
+                p->key = program_cache_hash_string(p->key, SHADER_VERSION_SRC);
+                p->key = program_cache_hash_string(p->key, p->is_multiview ? MULTIVIEW_DEFINES_SRC : "");
+                p->key = program_cache_hash_string(p->key, p->vert_src);
+                p->key = program_cache_hash_string(p->key, SHADER_VERSION_SRC);
+                p->key = program_cache_hash_string(p->key, p->frag_src);
+                char path[512];
+                snprintf(path, sizeof(path), "%s/program_%s.qxrprog", platform_get_storage_path(a->platform), p->name);
+                p->program = program_cache_load(path, p->key);
+                if (p->program) {
+                        p->is_cached = true;
+                        p->state = SHADER_PROGRAM_READY;
+                        a->programs_loaded++;
+                        return;
+                }
+        }
 
-        glGetShaderiv(frag_shd, GL_COMPILE_STATUS, &success);
-        if (!success) {
-                char info_log[512];
-                glGetShaderInfoLog(frag_shd, 512, NULL, info_log);
-                printf("Fragment shader compilation failed:\n %s\n", info_log);
+        p->vert_shd = app_init_opengl_shader(GL_VERTEX_SHADER, p->vert_src, p->is_multiview);
+        p->frag_shd = app_init_opengl_shader(GL_FRAGMENT_SHADER, p->frag_src, false);
+        p->program = glCreateProgram();
+        if (a->is_program_cache) {
+                glProgramParameteri(p->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         }
+        glAttachShader(p->program, p->vert_shd);
+        glAttachShader(p->program, p->frag_shd);
+        glLinkProgram(p->program);
+        p->state = SHADER_PROGRAM_BUILDING;
+        a->programs_compiled++;
+}
 
-        a->box_program = glCreateProgram();
-        glAttachShader(a->box_program, vert_shd);
-        glAttachShader(a->box_program, frag_shd);
-        glLinkProgram(a->box_program);
+// Whether resolving a program would return without waiting on the driver
+bool app_shaders_is_complete(app_t *a, const shader_program_t *p) {
+        if (p->state != SHADER_PROGRAM_BUILDING || !a->is_parallel_shader_compile) { return true; }
+        int is_complete = GL_FALSE;
+        glGetProgramiv(p->program, GL_COMPLETION_STATUS_KHR, &is_complete);
+        return is_complete == GL_TRUE;
+}
 
-        glGetProgramiv(a->box_program, GL_LINK_STATUS, &success);
-        if (!success) {
+// Finish a program built from source, waiting for the driver if it's still going: check it and log
+// any errors. Saving it to the program cache is left to app_shaders_store.
+void app_shaders_resolve(app_t *a, shader_program_t *p) {
+        if (p->state != SHADER_PROGRAM_BUILDING) { return; }
+        bool is_waiting = !app_shaders_is_complete(a, p);
+        int success;
+        glGetProgramiv(p->program, GL_LINK_STATUS, &success);
+        if (success) {
+                p->state = SHADER_PROGRAM_READY;
+                p->is_store_pending = a->is_program_cache;
+        } else {
+                app_log_shader_errors(p->vert_shd, p->name, "Vertex");
+                app_log_shader_errors(p->frag_shd, p->name, "Fragment");
                 char info_log[512];
-                glGetProgramInfoLog(a->box_program, 512, NULL, info_log);
-                printf("Program Linking failed:\n %s\n", info_log);
+                glGetProgramInfoLog(p->program, 512, NULL, info_log);
+                SLOG_ERROR("%s program linking failed:\n %s\n", p->name, info_log);
+                p->state = SHADER_PROGRAM_FAILED;
         }
+        glDeleteShader(p->vert_shd);
+        glDeleteShader(p->frag_shd);
+        p->vert_shd = 0;
+        p->frag_shd = 0;
+        SLOG_INFO("Program %s: resolved %.3f ms after init started it%s\n", p->name,
+                (telemetry_now() - a->shaders_start_time) * 1e-6, is_waiting ? ", waited" : "");
+}
 
-        glDeleteShader(vert_shd);
-        glDeleteShader(frag_shd);
+// Save a resolved program to the program cache, if it hasn't been yet
+void app_shaders_store(app_t *a, shader_program_t *p) {
+        if (!p->is_store_pending) { return; }
+        p->is_store_pending = false;
+        char path[512];
+        snprintf(path, sizeof(path), "%s/program_%s.qxrprog", platform_get_storage_path(a->platform), p->name);
+        if (!program_cache_store(path, p->key, p->program)) {
+                SLOG_WARN("Program cache: can't write %s\n", path);
+        }
+}
 
-        // Background Program
-        vert_shd = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vert_shd, 1, &BACKGROUND_VERT_SRC, NULL);
-        glCompileShader(vert_shd);
+// Resolve every program that has finished building, without waiting on any, and save whatever has
+// been resolved to the program cache. Swapchain creation can still turn multiview off after the
+// programs started, so any started for the other mode begins again here. Called at the end of init
+// and after every frame, never during one.
+void app_shaders_poll(app_t *a) {
+        for (int i = 0; i < APP_PROGRAM_COUNT; i++) {
+                shader_program_t *p = &a->programs[i];
+                if (p->is_multiview != a->is_multiview) {
+                        if (p->is_cached) {
+                                a->programs_loaded--;
+                        } else {
+                                a->programs_compiled--;
+                        }
+                        glDeleteShader(p->vert_shd);
+                        glDeleteShader(p->frag_shd);
+                        glDeleteProgram(p->program);
+                        app_shaders_begin(a, p);
+                }
+                if (app_shaders_is_complete(a, p)) {
+                        app_shaders_resolve(a, p);
+                }
+                app_shaders_store(a, p);
+        }
+}
 
-        glGetShaderiv(vert_shd, GL_COMPILE_STATUS, &success);
-        if (!success) {
-                char info_log[512];
-                glGetShaderInfoLog(vert_shd, 512, NULL, info_log);
-                printf("Vertex shader compilation failed:\n %s\n", info_log);
+// The GL program to draw with, finishing it first if the driver is still building it. It's saved to
+// the program cache at the next app_shaders_poll, not here in the middle of the frame.
+inline uint32_t app_get_program(app_t *a, app_program_t id) {
+        shader_program_t *p = &a->programs[id];
+        if (p->state == SHADER_PROGRAM_BUILDING) {
+                app_shaders_resolve(a, p);
         }
+        return p->program;
+}
+
+// Start building every program, see SHADER REGISTRY
+void app_init_opengl_shaders(app_t *a) {
+        glEnable(GL_DEPTH_TEST);  
 
-        frag_shd = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(frag_shd, 1, &BACKGROUND_FRAG_SRC, NULL);
-        glCompileShader(frag_shd);
+        a->shaders_start_time = telemetry_now();
+        if (a->is_program_cache && !program_cache_is_supported()) {
+                SLOG_INFO("Program cache: no binary formats, compiling\n");
+                a->is_program_cache = false;
+        }
 
-        glGetShaderiv(frag_shd, GL_COMPILE_STATUS, &success);
-        if (!success) {
-                char info_log[512];
-                glGetShaderInfoLog(frag_shd, 512, NULL, info_log);
-                printf("Fragment shader compilation failed:\n %s\n", info_log);
+        // Let the driver use as many compiler threads as it likes
+        a->is_parallel_shader_compile = false;
+        if (ENABLE_PARALLEL_SHADER_COMPILE && app_has_gl_extension("GL_KHR_parallel_shader_compile")) {
+                PFNGLMAXSHADERCOMPILERTHREADSKHRPROC gl_max_shader_compiler_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)eglGetProcAddress("glMaxShaderCompilerThreadsKHR");
+                if (gl_max_shader_compiler_threads) {
+                        gl_max_shader_compiler_threads(0xffffffff);
+                        a->is_parallel_shader_compile = true;
+                }
         }
+        SLOG_INFO("Parallel Shader Compile: %s\n", a->is_parallel_shader_compile ? "enabled" : "disabled");
+
+        // In multiview mode these are the multiview variants, which take a model matrix and read
+        // the view_proj matrices from the uniform block
+        a->programs[APP_PROGRAM_BOX] = { "box", BOX_VERT_SRC, BOX_FRAG_SRC };
+        a->programs[APP_PROGRAM_BACKGROUND] = { "background", BACKGROUND_VERT_SRC, BACKGROUND_FRAG_SRC };
+        for (int i = 0; i < APP_PROGRAM_COUNT; i++) {
+                app_shaders_begin(a, &a->programs[i]);
+        }
+        SLOG_INFO("Programs: %d from cache, %d building, %.3f ms\n", a->programs_loaded, a->programs_compiled,
+                (telemetry_now() - a->shaders_start_time) * 1e-6);
+}
 
-        a->background_program = glCreateProgram();
-        glAttachShader(a->background_program, vert_shd);
-        glAttachShader(a->background_program, frag_shd);
-        glLinkProgram(a->background_program);
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// INIT GRAPH
+//
+// Init is a fixed graph of stages, each one of the app_init_* functions above and the stages it
+// needs finished first. Most of the OpenXR setup only talks to the runtime, each call a round trip
+// to the compositor process, and needs nothing from EGL or GL: those stages run as jobs on the
+// worker pool as soon as their prerequisites are done, while the main thread brings up EGL and
+// starts the shaders. Stages that need the GL context current (EGL itself, shaders, swapchains,
+// framebuffers and timers), or the JNI environment for the loader, and the session, which the
+// runtime binds to the context, always run on the main thread.
+//
+// Every worker stage is a job made before any is submitted, so the edges between worker stages are
+// job dependencies and a worker starts a stage's successors the moment it finishes, whatever the
+// main thread is busy with. An edge from a main stage holds its job back by not submitting it until
+// that stage is done. The main thread runs the earliest main stage that's ready, and when none is
+// sleeps on a futex until a worker stage finishes. With no workers it runs the worker stages the
+// next main stage needs itself instead, with jobs_wait. A stage's writes to app_t are seen by later
+// stages through the job's completion.
+//
+// Every stage's start and duration is logged at the end, against the time init started, with
+// where it ran. Stages are listed in an order that satisfies the graph, which is the order
+// -DENABLE_INIT_GRAPH=0 runs them in.
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-        glGetProgramiv(a->background_program, GL_LINK_STATUS, &success);
-        if (!success) {
-                char info_log[512];
-                glGetProgramInfoLog(a->background_program, 512, NULL, info_log);
-                printf("Program Linking failed:\n %s\n", info_log);
+enum app_init_stage_t {
+        APP_INIT_XR_LOADER,
+        APP_INIT_EGL,
+        APP_INIT_GL_EXTENSIONS,
+        APP_INIT_SHADERS,
+        APP_INIT_XR_INSTANCE,
+        APP_INIT_XR_LAYERS,
+        APP_INIT_XR_SYSTEM,
+        APP_INIT_XR_VIEWS,
+        APP_INIT_XR_ACTIONS,
+        APP_INIT_XR_SESSION,
+        APP_INIT_XR_STAGE_SPACE,
+        APP_INIT_XR_ATTACH_ACTIONS,
+        APP_INIT_XR_POSE_CACHES,
+        APP_INIT_XR_SWAPCHAINS,
+        APP_INIT_GL_FRAMEBUFFERS,
+        APP_INIT_GPU_TIMERS,
+        APP_INIT_SHADERS_POLL,
+        APP_INIT_STAGE_COUNT,
+};
+
+#define APP_INIT_BIT(stage) (1u << (stage))
+
+struct app_init_stage_desc_t {
+        const char *name;
+        void (*func)(app_t *a);
+        bool is_main;            // Needs the GL context or the JNI environment
+        uint32_t prerequisites;  // APP_INIT_BITs of the stages that must finish first
+};
+
+static void app_init_xr_loader(app_t *a) {
+        platform_init_xr_loader(a->platform);
+}
+
+static const app_init_stage_desc_t APP_INIT_STAGES[APP_INIT_STAGE_COUNT] = {
+        { "xr_loader", app_init_xr_loader, true, 0 },
+        { "egl", app_init_egl, true, 0 },
+        { "gl_extensions", app_init_opengl_extensions, true, APP_INIT_BIT(APP_INIT_EGL) },
+        { "shaders", app_init_opengl_shaders, true, APP_INIT_BIT(APP_INIT_GL_EXTENSIONS) },
+        { "xr_instance", app_init_xr_create_instance, false, APP_INIT_BIT(APP_INIT_XR_LOADER) },
+        { "xr_layers", app_init_xr_enum_layers, false, APP_INIT_BIT(APP_INIT_XR_LOADER) },
+        { "xr_system", app_init_xr_get_system, false, APP_INIT_BIT(APP_INIT_XR_INSTANCE) },
+        { "xr_views", app_init_xr_enum_views, false, APP_INIT_BIT(APP_INIT_XR_SYSTEM) },
+        { "xr_actions", app_init_xr_create_actions, false, APP_INIT_BIT(APP_INIT_XR_INSTANCE) },
+        { "xr_session", app_init_xr_create_session, true, APP_INIT_BIT(APP_INIT_EGL) | APP_INIT_BIT(APP_INIT_XR_SYSTEM) },
+        { "xr_stage_space", app_init_xr_create_stage_space, false, APP_INIT_BIT(APP_INIT_XR_SESSION) },
+        { "xr_attach_actions", app_init_xr_attach_actions, false, APP_INIT_BIT(APP_INIT_XR_SESSION) | APP_INIT_BIT(APP_INIT_XR_ACTIONS) },
+        { "xr_pose_caches", app_init_xr_pose_caches, false, APP_INIT_BIT(APP_INIT_XR_STAGE_SPACE) | APP_INIT_BIT(APP_INIT_XR_ATTACH_ACTIONS) },
+        { "xr_swapchains", app_init_xr_create_swapchains, true, APP_INIT_BIT(APP_INIT_XR_SESSION) | APP_INIT_BIT(APP_INIT_XR_VIEWS) | APP_INIT_BIT(APP_INIT_GL_EXTENSIONS) },
+        { "gl_framebuffers", app_init_opengl_framebuffers, true, APP_INIT_BIT(APP_INIT_XR_SWAPCHAINS) },
+        { "gpu_timers", app_init_opengl_gpu_timers, true, APP_INIT_BIT(APP_INIT_GL_EXTENSIONS) },
+        { "shaders_poll", app_shaders_poll, true, APP_INIT_BIT(APP_INIT_SHADERS) | APP_INIT_BIT(APP_INIT_XR_SWAPCHAINS) },
+};
+
+struct app_init_graph_t;
+
+// One stage's progress through a run of the graph
+struct app_init_run_t {
+        app_init_graph_t *graph;
+        app_init_stage_t stage;
+        job_t *job;                 // Worker stages only
+        bool is_started;            // Run, or for a worker stage submitted
+        std::atomic<bool> is_done;
+        int thread;                 // Index into the job pool's threads it ran on, 0 is the main thread
+        int64_t start_time;
+        int64_t end_time;
+};
+
+struct app_init_graph_t {
+        app_t *a;
+        app_init_run_t runs[APP_INIT_STAGE_COUNT];
+        std::atomic<uint32_t> stages_done; // Bumped as each worker stage finishes, the main thread sleeps on it
+};
+
+static bool app_init_is_main_stage(int stage) {
+        return APP_INIT_STAGES[stage].is_main || !ENABLE_INIT_GRAPH;
+}
+
+static void app_init_run_stage(app_init_run_t *run) {
+        const app_init_stage_desc_t *desc = &APP_INIT_STAGES[run->stage];
+        app_t *a = run->graph->a;
+        run->thread = jobs_thread_index(&a->jobs);
+        run->start_time = telemetry_now();
+        trace_scope_t scope = trace_begin(desc->name, 0);
+        desc->func(a);
+        trace_end(&scope);
+        run->end_time = telemetry_now();
+        run->is_done.store(true, std::memory_order_release);
+}
+
+static void app_init_stage_job(jobs_t *jobs, job_t *job, void *data) {
+        app_init_run_t *run = (app_init_run_t *)data;
+        app_init_run_stage(run);
+        run->graph->stages_done.fetch_add(1, std::memory_order_release);
+        sync_wake(&run->graph->stages_done);
+}
+
+// Run every stage, see INIT GRAPH
+void app_init_run_graph(app_init_graph_t *g) {
+        app_t *a = g->a;
+        uint32_t worker_stages = 0;
+        for (int i = 0; i < APP_INIT_STAGE_COUNT; i++) {
+                if (app_init_is_main_stage(i)) { continue; }
+                g->runs[i].job = jobs_create(&a->jobs, app_init_stage_job, &g->runs[i]);
+                worker_stages |= APP_INIT_BIT(i);
+                for (int j = 0; j < i; j++) {
+                        if (APP_INIT_STAGES[i].prerequisites & worker_stages & APP_INIT_BIT(j)) {
+                                jobs_add_dependency(g->runs[i].job, g->runs[j].job);
+                        }
+                }
         }
 
-        glDeleteShader(vert_shd);
-        glDeleteShader(frag_shd);
+        const uint32_t all_done = APP_INIT_BIT(APP_INIT_STAGE_COUNT) - 1;
+        uint32_t main_done = 0;
+        while (true) {
+                // Worker stages go as soon as their main prerequisites are done, the job system holds
+                // them back until their worker ones are too
+                for (int i = 0; i < APP_INIT_STAGE_COUNT; i++) {
+                        app_init_run_t *run = &g->runs[i];
+                        if (!run->job || run->is_started) { continue; }
+                        if ((APP_INIT_STAGES[i].prerequisites & ~worker_stages & ~main_done) == 0) {
+                                run->is_started = true;
+                                jobs_submit(&a->jobs, run->job);
+                        }
+                }
+
+                // Read before looking at which stages are done, so a stage finishing in between
+                // changes it and the futex wait below returns straight away
+                uint32_t signal = g->stages_done.load(std::memory_order_acquire);
+                uint32_t done = main_done;
+                for (int i = 0; i < APP_INIT_STAGE_COUNT; i++) {
+                        if (g->runs[i].job && g->runs[i].is_done.load(std::memory_order_acquire)) {
+                                done |= APP_INIT_BIT(i);
+                        }
+                }
+                if (done == all_done) { break; }
+
+                // The earliest main stage that's ready, and the earliest that isn't
+                int ready_main = -1, next_main = -1;
+                for (int i = 0; i < APP_INIT_STAGE_COUNT; i++) {
+                        if (!app_init_is_main_stage(i) || g->runs[i].is_started) { continue; }
+                        if (next_main < 0) { next_main = i; }
+                        if ((APP_INIT_STAGES[i].prerequisites & ~done) == 0) {
+                                ready_main = i;
+                                break;
+                        }
+                }
+                if (ready_main >= 0) {
+                        g->runs[ready_main].is_started = true;
+                        app_init_run_stage(&g->runs[ready_main]);
+                        main_done |= APP_INIT_BIT(ready_main);
+                        continue;
+                }
+
+                if (a->jobs.thread_count > 1) {
+                        sync_wait(&g->stages_done, signal);
+                        continue;
+                }
+
+                // No workers. Every main stage before next_main is done, so everything the worker
+                // stages it needs depend on has been submitted and jobs_wait can run it all here.
+                uint32_t waiting_on = next_main >= 0 ? APP_INIT_STAGES[next_main].prerequisites : worker_stages;
+                for (int i = 0; i < APP_INIT_STAGE_COUNT; i++) {
+                        if ((waiting_on & ~done & APP_INIT_BIT(i)) != 0) {
+                                jobs_wait(&a->jobs, g->runs[i].job);
+                                break;
+                        }
+                }
+        }
 }
 
 // Initialises the application state
-void app_init(app_t *a, android_app *app) {
-        app_set_callbacks_and_wait(a, app);
-        app_init_egl(a);
-        app_init_xr_create_instance(a);
-        app_init_xr_get_system(a);
-        app_init_xr_enum_views(a);
-        app_init_xr_create_session(a);
-        app_init_xr_create_stage_space(a);
-        app_init_xr_create_actions(a);
-        app_init_xr_create_swapchains(a);
-        app_init_opengl_framebuffers(a);
-        app_init_opengl_shaders(a);
+void app_init(app_t *a, platform_t *platform) {
+        a->platform = platform;
+        trace_set_thread_name("main");
+        a->telemetry = (telemetry_t *)malloc(sizeof(telemetry_t));
+        telemetry_init(a->telemetry, "main", APP_STAGE_NAMES, APP_STAGE_COUNT, APP_COUNTER_NAMES, APP_COUNTER_COUNT);
+        a->render_telemetry = (telemetry_t *)malloc(sizeof(telemetry_t));
+        telemetry_init(a->render_telemetry, "render", RENDER_STAGE_NAMES, RENDER_STAGE_COUNT, NULL, 0);
+        jobs_config_t jobs_config;
+        jobs_default_config(&jobs_config, ENABLE_RENDER_THREAD ? 1 : 0);
+        if (a->job_worker_count >= 0) {
+                jobs_config.worker_count = a->job_worker_count < JOBS_MAX_THREADS - 1 ? a->job_worker_count : JOBS_MAX_THREADS - 1;
+        }
+        jobs_init(&a->jobs, &jobs_config);
+        SLOG_INFO("Job Workers: %d\n", jobs_config.worker_count);
+        platform_wait_for_window(platform);
+
+        int64_t start = telemetry_now();
+        app_init_graph_t graph = {};
+        graph.a = a;
+        for (int i = 0; i < APP_INIT_STAGE_COUNT; i++) {
+                assert(APP_INIT_STAGES[i].prerequisites < APP_INIT_BIT(i));
+                graph.runs[i].graph = &graph;
+                graph.runs[i].stage = (app_init_stage_t)i;
+        }
+        app_init_run_graph(&graph);
+        int64_t end = telemetry_now();
+
+        int64_t stage_total = 0;
+        SLOG_INFO("Init stages:\n");
+        for (int i = 0; i < APP_INIT_STAGE_COUNT; i++) {
+                const app_init_run_t *run = &graph.runs[i];
+                int64_t duration = run->end_time - run->start_time;
+                stage_total += duration;
+                if (run->thread == 0) {
+                        SLOG_INFO("        %-18s start %8.3f ms  took %8.3f ms  main\n", APP_INIT_STAGES[i].name,
+                                (run->start_time - start) * 1e-6, duration * 1e-6);
+                } else {
+                        SLOG_INFO("        %-18s start %8.3f ms  took %8.3f ms  worker %d\n", APP_INIT_STAGES[i].name,
+                                (run->start_time - start) * 1e-6, duration * 1e-6, run->thread);
+                }
+        }
+        SLOG_INFO("Init: %.3f ms, stages add up to %.3f ms\n", (end - start) * 1e-6, stage_total * 1e-6);
+
+        // A worker stage is marked done before it bumps stages_done and its job finishes, so make
+        // sure no job still touches the graph before it goes out of scope
+        for (int i = 0; i < APP_INIT_STAGE_COUNT; i++) {
+                if (graph.runs[i].job) {
+                        jobs_wait(&a->jobs, graph.runs[i].job);
+                }
+        }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// FRAME HANDOFF
+//
+// The main thread waits on xrWaitFrame, samples input and fills in a frame packet, the render thread
+// takes packets in order and does xrBeginFrame through xrEndFrame for each. frames_pushed and
+// frames_done only ever grow (wrapping is fine, only their difference matters), the packet for frame
+// n lives in slot n % FRAME_PACKET_COUNT. Neither side takes a lock, they only sleep on the other's
+// counter when the ring is full or empty. A side raises its waiting flag before it sleeps, and the
+// other only makes the wake syscall when the flag is up, so a frame where nobody waits costs none.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Sleep on counter while it still reads value. The flag goes up before counter is looked at again, so
+// the other side's app_handoff_wake either sees the flag or bumped counter before we look.
+void app_handoff_wait(std::atomic<uint32_t> *counter, uint32_t value, std::atomic<uint32_t> *is_waiting) {
+        is_waiting->store(1, std::memory_order_seq_cst);
+        if (counter->load(std::memory_order_seq_cst) == value) {
+                sync_wait(counter, value);
+        }
+}
+
+// Bump counter, and wake the other side only if it's asleep on it
+void app_handoff_advance(std::atomic<uint32_t> *counter, std::atomic<uint32_t> *is_waiting) {
+        counter->fetch_add(1, std::memory_order_seq_cst);
+        if (is_waiting->load(std::memory_order_seq_cst) && is_waiting->exchange(0)) {
+                sync_wake(counter);
+        }
+}
+
+// Get the slot for the next packet, blocking while the render thread is FRAME_PACKET_COUNT behind
+frame_packet_t *app_handoff_begin_push(app_t *a) {
+        uint32_t pushed = a->frames_pushed.load(std::memory_order_relaxed);
+        uint32_t done = a->frames_done.load(std::memory_order_acquire);
+        while (pushed - done == FRAME_PACKET_COUNT) {
+                app_handoff_wait(&a->frames_done, done, &a->is_push_waiting);
+                done = a->frames_done.load(std::memory_order_acquire);
+        }
+        return &a->frame_packets[pushed % FRAME_PACKET_COUNT];
+}
+
+// Publish the packet filled in since app_handoff_begin_push
+void app_handoff_end_push(app_t *a) {
+        app_handoff_advance(&a->frames_pushed, &a->is_pop_waiting);
+}
+
+// Get the oldest packet the render thread hasn't finished, blocking until there is one
+frame_packet_t *app_handoff_begin_pop(app_t *a) {
+        uint32_t done = a->frames_done.load(std::memory_order_relaxed);
+        uint32_t pushed = a->frames_pushed.load(std::memory_order_acquire);
+        while (pushed == done) {
+                app_handoff_wait(&a->frames_pushed, pushed, &a->is_pop_waiting);
+                pushed = a->frames_pushed.load(std::memory_order_acquire);
+        }
+        return &a->frame_packets[done % FRAME_PACKET_COUNT];
+}
+
+// Hand the slot of the packet from app_handoff_begin_pop back to the main thread
+void app_handoff_end_pop(app_t *a) {
+        app_handoff_advance(&a->frames_done, &a->is_push_waiting);
+}
+
+// Block until the render thread has finished every packet pushed so far
+void app_handoff_drain(app_t *a) {
+        uint32_t pushed = a->frames_pushed.load(std::memory_order_relaxed);
+        uint32_t done = a->frames_done.load(std::memory_order_acquire);
+        while (done != pushed) {
+                app_handoff_wait(&a->frames_done, done, &a->is_push_waiting);
+                done = a->frames_done.load(std::memory_order_acquire);
+        }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// INPUT SAMPLING
+//
+// While the session runs, the input thread syncs the actions and reads the trigger states every
+// input_sample_period_ns and pushes them into input_ring. It's made once, at the first session
+// begin, and between sessions (e.g. while the app is paused) parks on a futex rather than exiting, so
+// its trace buffer and log ring are never left behind by a thread that's gone. Each frame the main thread drains the ring,
+// keeps the newest states as the frame's, and records every click edge in between, in order. Poses
+// aren't sampled here, they're located for the frame's display time, see pose_cache.h.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Sync the actions and read both hands' trigger states, on whichever thread samples input
+void app_input_sample(app_t *a, input_sample_t *sample) {
+        XrActiveActionSet active_action_set;
+        active_action_set.actionSet = a->action_set;
+        active_action_set.subactionPath = XR_NULL_PATH;
+        XrActionsSyncInfo action_sync_info;
+        action_sync_info.type = XR_TYPE_ACTIONS_SYNC_INFO;
+        action_sync_info.next = NULL;
+        action_sync_info.countActiveActionSets = 1;
+        action_sync_info.activeActionSets = &active_action_set;
+        XrResult result = xrSyncActions(a->session, &action_sync_info);
+        assert(XR_SUCCEEDED(result));
+        sample->time = telemetry_now();
+
+        XrActionStateGetInfo action_get_info = { XR_TYPE_ACTION_STATE_GET_INFO };
+        for (int i = 0; i < HAND_COUNT; i++) {
+                sample->trigger_states[i] = { XR_TYPE_ACTION_STATE_FLOAT };
+                sample->trigger_click_states[i] = { XR_TYPE_ACTION_STATE_BOOLEAN };
+                action_get_info.subactionPath = a->hand_paths[i];
+                action_get_info.action = a->trigger_action;
+                xrGetActionStateFloat(a->session, &action_get_info, &sample->trigger_states[i]);
+                action_get_info.action = a->trigger_click_action;
+                xrGetActionStateBoolean(a->session, &action_get_info, &sample->trigger_click_states[i]);
+        }
+}
+
+// Samples at a fixed rate while input_request is odd, and parks while it's even, until told to quit.
+// A tick that's overslept is skipped rather than made up.
+void *app_input_thread(void *arg) {
+        app_t *a = (app_t *)arg;
+        trace_set_thread_name("input");
+        int64_t next_time = telemetry_now();
+        while (!a->is_input_quitting.load(std::memory_order_acquire)) {
+                uint32_t request = a->input_request.load(std::memory_order_acquire);
+                if ((request & 1) == 0) {
+                        a->input_parked.store(request, std::memory_order_release);
+                        sync_wake(&a->input_parked);
+                        sync_wait(&a->input_request, request);
+                        next_time = telemetry_now();
+                        continue;
+                }
+
+                input_sample_t sample;
+                app_input_sample(a, &sample);
+                input_ring_push(&a->input_ring, &sample);
+
+                next_time += a->input_sample_period_ns;
+                if (next_time < sample.time) { next_time = sample.time; }
+                struct timespec ts;
+                ts.tv_sec = next_time / 1000000000ll;
+                ts.tv_nsec = next_time % 1000000000ll;
+                while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}
+        }
+        return NULL;
+}
+
+// Actions can only be synced while the session is running, so sampling runs from begin to end. The
+// thread is made the first time, and woken from where it parked after that.
+void app_start_input_thread(app_t *a) {
+        if (!ENABLE_INPUT_THREAD || a->is_replay || a->is_input_running) { return; }
+        input_ring_reset(&a->input_ring);
+        a->input_dropped_seen = 0;
+        a->input_request.fetch_add(1, std::memory_order_release);
+        sync_wake(&a->input_request);
+        if (!a->is_input_thread) {
+                int create_result = pthread_create(&a->input_thread, NULL, app_input_thread, a);
+                assert(create_result == 0);
+                a->is_input_thread = true;
+                LOG_INFO("Input thread started, %.0f Hz\n", 1e9 / a->input_sample_period_ns);
+        }
+        a->is_input_running = true;
+}
+
+// Park the input thread, returning once it has stopped touching the session
+void app_stop_input_thread(app_t *a) {
+        if (!a->is_input_running) { return; }
+        uint32_t request = a->input_request.fetch_add(1, std::memory_order_release) + 1;
+        sync_wake(&a->input_request);
+        uint32_t parked;
+        while ((parked = a->input_parked.load(std::memory_order_acquire)) != request) {
+                sync_wait(&a->input_parked, parked);
+        }
+        a->is_input_running = false;
+}
+
+// Stop the input thread for good, at shutdown. Bumping input_request by two keeps it parked but wakes
+// it to see is_input_quitting.
+void app_quit_input_thread(app_t *a) {
+        app_stop_input_thread(a);
+        if (!a->is_input_thread) { return; }
+        a->is_input_quitting.store(true, std::memory_order_release);
+        a->input_request.fetch_add(2, std::memory_order_release);
+        sync_wake(&a->input_request);
+        pthread_join(a->input_thread, NULL);
+        a->is_input_thread = false;
+}
+
+// Fold one sample into the frame's trigger states, recording a click edge if it changed
+void app_update_apply_input_sample(app_t *a, const input_sample_t *sample) {
+        for (int i = 0; i < HAND_COUNT; i++) {
+                const XrActionStateBoolean *click = &sample->trigger_click_states[i];
+                if (click->currentState != a->trigger_click_states[i].currentState) {
+                        telemetry_count(a->telemetry, APP_COUNTER_TRIGGER_EDGES);
+                        if (a->trigger_edge_count < MAX_INPUT_EDGES) {
+                                input_edge_t *edge = &a->trigger_edges[a->trigger_edge_count++];
+                                edge->change_time = click->lastChangeTime;
+                                edge->sample_time = sample->time;
+                                edge->hand = i;
+                                edge->is_pressed = click->currentState;
+                        }
+                }
+                a->trigger_states[i] = sample->trigger_states[i];
+                a->trigger_click_states[i] = *click;
+        }
+        input_log_frame_t *record = &a->record_frame;
+        if (input_log_is_recording(&a->record_log) && record->sample_count < INPUT_LOG_MAX_SAMPLES) {
+                record->samples[record->sample_count++] = *sample;
+        }
+}
+
+// Take every sample the input thread has pushed since the last frame
+void app_update_drain_input(app_t *a) {
+        input_sample_t sample;
+        while (input_ring_pop(&a->input_ring, &sample)) {
+                app_update_apply_input_sample(a, &sample);
+        }
+        uint32_t dropped_count = a->input_ring.dropped_count.load(std::memory_order_relaxed);
+        telemetry_count_add(a->telemetry, APP_COUNTER_INPUT_DROPPED, dropped_count - a->input_dropped_seen);
+        a->input_dropped_seen = dropped_count;
+}
+
+// Held at the end of the frame, or pressed at any point during it, so a tap shorter than a frame
+// still shows for one
+bool app_is_trigger_clicked(const frame_packet_t *f, int hand) {
+        if (f->trigger_click_states[hand].currentState) { return true; }
+        for (int i = 0; i < f->trigger_edge_count; i++) {
+                if (f->trigger_edges[i].hand == hand && f->trigger_edges[i].is_pressed) { return true; }
+        }
+        return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// INPUT RECORD AND REPLAY
+//
+// Recording logs each event as it's polled and each frame once its inputs are in, see input_log.h.
+// A replay swaps the runtime's frame state, hand poses and input samples for the logged ones as the
+// frame loop takes them. Events aren't swapped, on the host the mock runtime is scripted from the
+// same log so it sends the same session states between the same frames (see app_main), and the
+// frame loop has to stay in step with the runtime's session anyway.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void app_record_event(app_t *a, const XrEventDataBuffer *event) {
+        if (!input_log_is_recording(&a->record_log)) { return; }
+        input_log_event_t logged = { a->frames_waited, event->type, XR_SESSION_STATE_UNKNOWN };
+        if (event->type == XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED) {
+                logged.state = ((const XrEventDataSessionStateChanged *)event)->state;
+        }
+        input_log_write_event(&a->record_log, &logged);
+}
+
+// Log the frame the main thread just took inputs for, along with the samples folded in for it
+void app_record_frame(app_t *a) {
+        if (!input_log_is_recording(&a->record_log)) { return; }
+        input_log_frame_t *record = &a->record_frame;
+        record->display_time = a->frame_state.predictedDisplayTime;
+        record->display_period = a->frame_state.predictedDisplayPeriod;
+        record->should_render = a->frame_state.shouldRender;
+        for (int i = 0; i < HAND_COUNT; i++) {
+                record->hand_flags[i] = a->hand_locations[i].locationFlags;
+                record->hand_poses[i] = a->hand_locations[i].pose;
+        }
+        input_log_write_frame(&a->record_log, record);
+        record->sample_count = 0;
+}
+
+// Read the next logged frame and use its frame state in place of the one xrWaitFrame returned,
+// skipping the events before it. Returns false once the log runs out.
+bool app_replay_frame_state(app_t *a) {
+        input_log_record_type_t type;
+        input_log_event_t event;
+        do {
+                if (!input_log_read(&a->replay_log, &type, &event, &a->replay_frame)) { return false; }
+        } while (type != INPUT_LOG_RECORD_FRAME);
+        a->frame_state.predictedDisplayTime = a->replay_frame.display_time;
+        a->frame_state.predictedDisplayPeriod = a->replay_frame.display_period;
+        a->frame_state.shouldRender = a->replay_frame.should_render ? XR_TRUE : XR_FALSE;
+        return true;
+}
+
+// Use the logged hand poses in place of the located ones
+void app_replay_poses(app_t *a) {
+        for (int i = 0; i < HAND_COUNT; i++) {
+                XrSpaceLocation location = { XR_TYPE_SPACE_LOCATION };
+                location.locationFlags = a->replay_frame.hand_flags[i];
+                location.pose = a->replay_frame.hand_poses[i];
+                pose_cache_set_location(&a->pose_cache, i, &location);
+        }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1054,7 +1976,7 @@ void app_init(app_t *a, android_app *app) {
 
 // Begin the OpenXR session
 void app_update_begin_session(app_t *a) {
-        printf("Beginning Session");
+        SLOG_INFO("Beginning Session\n");
         XrSessionBeginInfo begin_desc;
         begin_desc.type = XR_TYPE_SESSION_BEGIN_INFO;
         begin_desc.next = NULL;
@@ -1063,6 +1985,19 @@ void app_update_begin_session(app_t *a) {
         assert(XR_SUCCEEDED(result));
         a->is_session_begin_ever = true;
         a->is_session_ready = true;
+        app_start_input_thread(a);
+}
+
+// End the OpenXR session once the runtime asks us to stop, the frame loop stops submitting. Every
+// frame already waited on has to be ended first.
+void app_update_end_session(app_t *a) {
+        SLOG_INFO("Ending Session\n");
+        app_handoff_drain(a);
+        app_stop_input_thread(a);
+        XrResult result = xrEndSession(a->session);
+        assert(XR_SUCCEEDED(result));
+        a->is_session_begin_ever = false;
+        a->is_session_ready = false;
 }
 
 // Handle session state changes
@@ -1070,45 +2005,94 @@ void app_update_session_state_change(app_t *a, XrSessionState state) {
         a->session_state = state;
         switch (a->session_state) {
         case XR_SESSION_STATE_IDLE:
-                printf("XR_SESSION_STATE_IDLE\n");
+                SLOG_INFO("XR_SESSION_STATE_IDLE\n");
                 break;
         case XR_SESSION_STATE_READY:
-                printf("XR_SESSION_STATE_READY\n");
+                SLOG_INFO("XR_SESSION_STATE_READY\n");
                 app_update_begin_session(a);
                 break;
         case XR_SESSION_STATE_SYNCHRONIZED:
-                printf("XR_SESSION_STATE_SYNCHRONIZED\n");
+                SLOG_INFO("XR_SESSION_STATE_SYNCHRONIZED\n");
                 break;
         case XR_SESSION_STATE_VISIBLE:
-                printf("XR_SESSION_STATE_VISIBLE\n");
+                SLOG_INFO("XR_SESSION_STATE_VISIBLE\n");
                 break;
         case XR_SESSION_STATE_FOCUSED:
-                printf("XR_SESSION_STATE_FOCUSED\n");
+                SLOG_INFO("XR_SESSION_STATE_FOCUSED\n");
                 break;
         case XR_SESSION_STATE_STOPPING:
-                printf("XR_SESSION_STATE_STOPPING\n");
+                SLOG_INFO("XR_SESSION_STATE_STOPPING\n");
+                app_update_end_session(a);
                 break;
         case XR_SESSION_STATE_LOSS_PENDING:
-                printf("XR_SESSION_STATE_LOSS_PENDING\n");
+                SLOG_INFO("XR_SESSION_STATE_LOSS_PENDING\n");
+                a->is_running = false;
                 break;
         case XR_SESSION_STATE_EXITING:
-                printf("XR_SESSION_STATE_EXITING\n");
+                SLOG_INFO("XR_SESSION_STATE_EXITING\n");
+                a->is_running = false;
                 break;
         default:
-                printf("XR_SESSION_STATE_??? %d\n", (int)a->session_state);
+                SLOG_WARN("XR_SESSION_STATE_??? %d\n", (int)a->session_state);
                 break;
         }
 }
 
-// Pump the android and OpenXR event loops
+// Ask the runtime to wind the session down, it then goes through STOPPING and EXITING as usual
+void app_update_request_exit(app_t *a) {
+        SLOG_INFO("Requesting Exit\n");
+        if (a->is_session_ready) {
+                XrResult result = xrRequestExitSession(a->session);
+                assert(XR_SUCCEEDED(result));
+        } else {
+                a->is_running = false;
+        }
+}
+
+static int64_t app_clock_ns(clockid_t clock) {
+        struct timespec ts;
+        clock_gettime(clock, &ts);
+        return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// How much CPU the whole process used over an idle stretch, proof the app really sleeps when
+// there's nothing to render. Stretches that never slept aren't worth a line.
+void app_update_report_idle(app_t *a) {
+        if (!a->is_idle || a->idle_pump_count < 2) { return; }
+        double seconds = (app_clock_ns(CLOCK_MONOTONIC) - a->idle_start_time) * 1e-9;
+        double cpu_seconds = (app_clock_ns(CLOCK_PROCESS_CPUTIME_ID) - a->idle_start_cpu_time) * 1e-9;
+        LOG_INFO("Idle for %.2f s: %lld wakeups, %.3f s CPU (%.2f%% of a core)\n", seconds,
+               (long long)a->idle_pump_count, cpu_seconds, seconds > 0.0 ? 100.0 * cpu_seconds / seconds : 0.0);
+}
+
+// How long the pump sleeps for OS events. Never with a session, xrWaitFrame paces the loop. Without
+// one, until the OS wakes us while it has the app in the background (the runtime holds its events
+// until we're resumed anyway), otherwise IDLE_POLL_MS at a time so runtime events still get seen.
+// The first pump of an idle stretch doesn't sleep, the runtime usually has the next state queued.
+int app_update_idle_timeout(app_t *a) {
+        if (a->is_session_ready) {
+                app_update_report_idle(a);
+                a->is_idle = false;
+                return 0;
+        }
+        if (!a->is_idle) {
+                a->is_idle = true;
+                a->idle_pump_count = 0;
+                a->idle_start_time = app_clock_ns(CLOCK_MONOTONIC);
+                a->idle_start_cpu_time = app_clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+        }
+        return a->idle_pump_count++ == 0 ? 0 : a->platform->is_paused ? -1 : IDLE_POLL_MS;
+}
+
+// Pump the platform and OpenXR event loops
 void app_update_pump_events(app_t *a) {
-        // Pump Android Event Loop
-        int events;
-        struct android_poll_source *source;
-        while (ALooper_pollAll(0, 0, &events, (void **)&source) >= 0 ) {
-                if (source != NULL) {
-                        source->process(a->app, source );
-                }
+        trace_scope_t scope = trace_begin("app_update_pump_events", a->frame_state.predictedDisplayTime);
+
+        // Pump Platform Event Loop, sleeping in it while there's no session
+        bool was_quit_requested = a->platform->is_quit_requested;
+        platform_pump_events(a->platform, app_update_idle_timeout(a));
+        if (a->platform->is_quit_requested && !was_quit_requested) {
+                app_update_request_exit(a);
         }
 
         // Pump OpenXR Event Loop
@@ -1121,52 +2105,67 @@ void app_update_pump_events(app_t *a) {
                         is_remaining_events = false;
                         continue;
                 }
+                app_record_event(a, &event_data);
 
                 switch (event_data.type) {
                 case XR_TYPE_EVENT_DATA_INSTANCE_LOSS_PENDING:
-                        printf("Event: XR_TYPE_EVENT_DATA_INSTANCE_LOSS_PENDING\n");
+                        LOG_INFO("Event: XR_TYPE_EVENT_DATA_INSTANCE_LOSS_PENDING\n");
                         // TODO: Handle, or prefer to handle loss pending in session state?
                         break;
                 case XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED: {
-                        printf("Event: XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED -> ");
                         XrEventDataSessionStateChanged* ssc = (XrEventDataSessionStateChanged*)&event_data;
                         app_update_session_state_change(a, ssc->state);
                         break;
                 }
                 case XR_TYPE_EVENT_DATA_REFERENCE_SPACE_CHANGE_PENDING:
-                        printf("Event: XR_TYPE_EVENT_DATA_REFERENCE_SPACE_CHANGE_PENDING\n");
+                        LOG_INFO("Event: XR_TYPE_EVENT_DATA_REFERENCE_SPACE_CHANGE_PENDING\n");
                         // TODO: Handle Reference Spaces changes
                         break;
                 case XR_TYPE_EVENT_DATA_EVENTS_LOST:
-                        printf("Event: XR_TYPE_EVENT_DATA_EVENTS_LOST\n");
+                        LOG_INFO("Event: XR_TYPE_EVENT_DATA_EVENTS_LOST\n");
                         // TODO: print warning
                         break;
                 case XR_TYPE_EVENT_DATA_INTERACTION_PROFILE_CHANGED:
-                        printf("Event: XR_TYPE_EVENT_DATA_INTERACTION_PROFILE_CHANGED\n");
+                        LOG_INFO("Event: XR_TYPE_EVENT_DATA_INTERACTION_PROFILE_CHANGED\n");
                         // TODO: this shouldn't happen but handle
                         break;
                 default:
-                        printf("Event: Unhandled event type %d\n", event_data.type);
+                        LOG_WARN("Event: Unhandled event type %d\n", event_data.type);
                         break;
                 }
         }
+
+        trace_end(&scope);
+}
+
+// Count frames we were told not to render, and display times we skipped past
+void app_update_count_frame_state(app_t *a) {
+        if (!a->frame_state.shouldRender) {
+                bool is_visible = a->session_state == XR_SESSION_STATE_VISIBLE || a->session_state == XR_SESSION_STATE_FOCUSED;
+                telemetry_count(a->telemetry, APP_COUNTER_NOT_RENDERED);
+                telemetry_count(a->telemetry, is_visible ? APP_COUNTER_NOT_RENDERED_VISIBLE : APP_COUNTER_NOT_RENDERED_HIDDEN);
+        }
+        XrDuration period = a->frame_state.predictedDisplayPeriod;
+        if (a->last_display_time != 0 && a->frame_state.predictedDisplayTime - a->last_display_time > period + period / 2) {
+                telemetry_count(a->telemetry, APP_COUNTER_MISSED_DISPLAY);
+        }
+        a->last_display_time = a->frame_state.predictedDisplayTime;
 }
 
 // Wait for the next frame, and get the transforms and button inputs of the controllers
-void app_update_begin_frame_and_get_inputs(app_t *a) {
+void app_update_wait_frame_and_get_inputs(app_t *a) {
         XrResult result;
 
-        // Sync Input
-        XrActiveActionSet active_action_set;
-        active_action_set.actionSet = a->action_set;
-        active_action_set.subactionPath = XR_NULL_PATH;
-        XrActionsSyncInfo action_sync_info;
-        action_sync_info.type = XR_TYPE_ACTIONS_SYNC_INFO;
-        action_sync_info.next = NULL;
-        action_sync_info.countActiveActionSets = 1;
-        action_sync_info.activeActionSets = &active_action_set;
-        result = xrSyncActions(a->session, &action_sync_info);
-        assert(XR_SUCCEEDED(result));
+        // The display time is only known once xrWaitFrame returns, the scope gets it then
+        trace_scope_t scope = trace_begin("app_update_wait_frame_and_get_inputs", 0);
+
+        // Sync Input, unless the input thread is
+        input_sample_t frame_sample;
+        if (!ENABLE_INPUT_THREAD) {
+                telemetry_stage_begin(a->telemetry, APP_STAGE_SYNC_ACTIONS);
+                app_input_sample(a, &frame_sample);
+                telemetry_stage_end(a->telemetry, APP_STAGE_SYNC_ACTIONS);
+        }
 
         // Wait Frame
         a->frame_state.type = XR_TYPE_FRAME_STATE;
@@ -1174,45 +2173,278 @@ void app_update_begin_frame_and_get_inputs(app_t *a) {
         XrFrameWaitInfo frame_wait;
         frame_wait.type = XR_TYPE_FRAME_WAIT_INFO;
         frame_wait.next = NULL;
+        telemetry_stage_begin(a->telemetry, APP_STAGE_WAIT_FRAME);
         result = xrWaitFrame(a->session, &frame_wait, &a->frame_state);
         assert(XR_SUCCEEDED(result));
+        telemetry_stage_end(a->telemetry, APP_STAGE_WAIT_FRAME);
+        a->frames_waited++;
+        if (input_log_is_replaying(&a->replay_log) && !app_replay_frame_state(a)) {
+                LOG_INFO("Input replay finished after %lld frames\n", (long long)a->replay_log.frame_count);
+                input_log_close(&a->replay_log);
+                app_update_request_exit(a);
+        }
         a->should_render = a->frame_state.shouldRender;
+        app_update_count_frame_state(a);
+        scope.display_time = a->frame_state.predictedDisplayTime;
 
         // TODO: Different code paths for focussed vs. not focussed
 
+        telemetry_stage_begin(a->telemetry, APP_STAGE_GET_INPUTS);
         // Get Action States and Spaces (i.e. current state of the controller inputs)
-        for (int i=0; i < HAND_COUNT; i++) {
+        a->hand_locate_time = telemetry_now();
+        result = pose_cache_locate(&a->pose_cache, a->frame_state.predictedDisplayTime);
+        assert(XR_SUCCEEDED(result));
+        bool is_replaying = input_log_is_replaying(&a->replay_log);
+        if (is_replaying) {
+                app_replay_poses(a);
+        }
+        for (int i = 0; i < HAND_COUNT; i++) {
                 a->hand_locations[i].type = XR_TYPE_SPACE_LOCATION;
-                a->trigger_states[i].type = XR_TYPE_ACTION_STATE_FLOAT;
-                a->trigger_click_states[i].type = XR_TYPE_ACTION_STATE_BOOLEAN;
+                a->hand_locations[i].next = NULL;
+                pose_cache_get_location(&a->pose_cache, i, &a->hand_locations[i]);
         }
 
-        result = xrLocateSpace(a->hand_spaces[0], a->stage_space, a->frame_state.predictedDisplayTime, &a->hand_locations[0]);
-        assert(XR_SUCCEEDED(result));
-        result = xrLocateSpace(a->hand_spaces[1], a->stage_space, a->frame_state.predictedDisplayTime, &a->hand_locations[1]);
-        assert(XR_SUCCEEDED(result));
+        a->trigger_edge_count = 0;
+        if (is_replaying) {
+                for (int i = 0; i < a->replay_frame.sample_count; i++) {
+                        app_update_apply_input_sample(a, &a->replay_frame.samples[i]);
+                }
+        } else if (ENABLE_INPUT_THREAD) {
+                app_update_drain_input(a);
+        } else {
+                app_update_apply_input_sample(a, &frame_sample);
+        }
+        app_record_frame(a);
+        telemetry_stage_end(a->telemetry, APP_STAGE_GET_INPUTS);
 
-        XrActionStateGetInfo action_get_info = { XR_TYPE_ACTION_STATE_GET_INFO };
-        action_get_info.action = a->trigger_action;
-        action_get_info.subactionPath = a->hand_paths[0];
-        xrGetActionStateFloat(a->session, &action_get_info, &a->trigger_states[0]);
-        action_get_info.subactionPath = a->hand_paths[1];
-        xrGetActionStateFloat(a->session, &action_get_info, &a->trigger_states[1]);
-        action_get_info.action = a->trigger_click_action;
-        action_get_info.subactionPath = a->hand_paths[0];
-        xrGetActionStateBoolean(a->session, &action_get_info, &a->trigger_click_states[0]);
-        action_get_info.subactionPath = a->hand_paths[1];
-        xrGetActionStateBoolean(a->session, &action_get_info, &a->trigger_click_states[1]);
+        trace_end(&scope);
+}
+
+void app_update_transforms_range(void *data, int begin, int end) {
+        app_t *a = (app_t *)data;
+        pose_cache_models(&a->pose_cache, &a->hand_models[begin][0], begin, end);
+}
+
+// Compute every model matrix once per frame, so the per-view work is just the view_proj multiply.
+// This is also the place to cull objects once there are more than two boxes. The poses are read
+// straight out of the pose cache, and the work is spread across the job system in batches of
+// TRANSFORM_BATCH, so with just the hands it stays inline.
+void app_update_transforms(app_t *a) {
+        jobs_parallel_for(&a->jobs, HAND_COUNT, TRANSFORM_BATCH, app_update_transforms_range, a);
+}
 
+// Copy the frame's state and inputs into a packet for the render thread
+void app_update_push_frame(app_t *a) {
+        telemetry_stage_begin(a->telemetry, APP_STAGE_PUSH_FRAME);
+        frame_packet_t *f = app_handoff_begin_push(a);
+        telemetry_stage_end(a->telemetry, APP_STAGE_PUSH_FRAME);
+        f->frame_state = a->frame_state;
+        f->should_render = a->should_render;
+        f->is_exit = false;
+        f->input_pose_time = a->hand_locate_time;
+        f->pose_time = a->hand_locate_time;
+        memcpy(f->hand_locations, a->hand_locations, sizeof(f->hand_locations));
+        memcpy(f->trigger_states, a->trigger_states, sizeof(f->trigger_states));
+        memcpy(f->trigger_click_states, a->trigger_click_states, sizeof(f->trigger_click_states));
+        memcpy(f->trigger_edges, a->trigger_edges, a->trigger_edge_count * sizeof(input_edge_t));
+        f->trigger_edge_count = a->trigger_edge_count;
+        memcpy(f->hand_models, a->hand_models, sizeof(f->hand_models));
+        app_handoff_end_push(a);
+}
+
+// Begin the frame a packet was waited on for, on the render thread
+void app_update_begin_frame(app_t *a, const frame_packet_t *f) {
+        trace_scope_t scope = trace_begin("app_update_begin_frame", f->frame_state.predictedDisplayTime);
         XrFrameBeginInfo frame_begin;
         frame_begin.type = XR_TYPE_FRAME_BEGIN_INFO;
         frame_begin.next = NULL;
-        result = xrBeginFrame(a->session, &frame_begin);
+        telemetry_stage_begin(a->render_telemetry, RENDER_STAGE_BEGIN_FRAME);
+        XrResult result = xrBeginFrame(a->session, &frame_begin);
+        assert(XR_SUCCEEDED(result));
+        telemetry_stage_end(a->render_telemetry, RENDER_STAGE_BEGIN_FRAME);
+        trace_end(&scope);
+}
+
+// Acquire and wait for the next image of a swapchain, returns the image index
+uint32_t app_update_acquire_swapchain_image(app_t *a, int swapchain) {
+        uint32_t image_index;
+        XrSwapchainImageAcquireInfo acquire_info = { XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO };
+        XrResult result = xrAcquireSwapchainImage(a->swapchains[swapchain], &acquire_info, &image_index);
+        assert(XR_SUCCEEDED(result));
+        XrSwapchainImageWaitInfo wait_info = { XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO };
+        wait_info.timeout = XR_INFINITE_DURATION;
+        result = xrWaitSwapchainImage(a->swapchains[swapchain], &wait_info);
+        assert(XR_SUCCEEDED(result));
+        return image_index;
+}
+
+// Release the image acquired by app_update_acquire_swapchain_image
+void app_update_release_swapchain_image(app_t *a, int swapchain) {
+        XrSwapchainImageReleaseInfo release_info = { XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
+        XrResult result = xrReleaseSwapchainImage(a->swapchains[swapchain], &release_info);
+        assert(XR_SUCCEEDED(result));
+}
+
+// Read back the frame of timer queries issued GPU_TIMER_FRAMES ago into the telemetry, then reuse its
+// slot for this frame. Results that still aren't ready, or that a disjoint event (e.g. a GPU
+// frequency change) made meaningless, are dropped rather than waited on.
+void app_update_gpu_timers_begin_frame(app_t *a) {
+        if (!a->is_gpu_timer) { return; }
+        uint32_t slot = a->gpu_timer_frame % GPU_TIMER_FRAMES;
+        uint32_t view_count = a->gpu_timer_view_counts[slot];
+
+        GLint is_disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &is_disjoint);
+        if (view_count > 0 && !is_disjoint) {
+                GLuint is_available = 0;
+                glGetQueryObjectuiv(a->gpu_timer_queries[slot][view_count - 1][GPU_MARK_COUNT - 1], GL_QUERY_RESULT_AVAILABLE, &is_available);
+                for (uint32_t v = 0; v < view_count && is_available; v++) {
+                        GLuint64 stamps[GPU_MARK_COUNT];
+                        for (int m = 0; m < GPU_MARK_COUNT; m++) {
+                                a->gl_get_query_object_ui64v(a->gpu_timer_queries[slot][v][m], GL_QUERY_RESULT, &stamps[m]);
+                        }
+                        telemetry_stage_add(a->render_telemetry, RENDER_STAGE_GPU_CLEAR, stamps[GPU_MARK_CLEARED] - stamps[GPU_MARK_BEGIN]);
+                        telemetry_stage_add(a->render_telemetry, RENDER_STAGE_GPU_BOXES, stamps[GPU_MARK_BOXES] - stamps[GPU_MARK_CLEARED]);
+                        telemetry_stage_add(a->render_telemetry, RENDER_STAGE_GPU_BACKGROUND, stamps[GPU_MARK_BACKGROUND] - stamps[GPU_MARK_BOXES]);
+                        if (v < 2) {
+                                telemetry_stage_add(a->render_telemetry, RENDER_STAGE_GPU_VIEW_0 + v, stamps[GPU_MARK_BACKGROUND] - stamps[GPU_MARK_BEGIN]);
+                        }
+                }
+        }
+        a->gpu_timer_view_counts[slot] = 0;
+}
+
+// Take a GPU timestamp in a view's pass of this frame
+void app_update_gpu_timestamp(app_t *a, int view, gpu_mark_t mark) {
+        if (!a->is_gpu_timer) { return; }
+        uint32_t slot = a->gpu_timer_frame % GPU_TIMER_FRAMES;
+        a->gl_query_counter(a->gpu_timer_queries[slot][view][mark], GL_TIMESTAMP_EXT);
+        if (a->gpu_timer_view_counts[slot] < view + 1) {
+                a->gpu_timer_view_counts[slot] = view + 1;
+        }
+}
+
+void app_update_gpu_timers_end_frame(app_t *a) {
+        if (!a->is_gpu_timer) { return; }
+        a->gpu_timer_frame++;
+}
+
+// Start a pass on the bound framebuffer. The background doesn't cover the whole view, so colour and
+// depth are both cleared, which also keeps a tiler from loading their old contents from memory.
+void app_update_begin_pass(app_t *a, int width, int height) {
+        glViewport(0, 0, width, height);
+        glClearColor(0.4, 0.4, 0.8, 1);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// End a pass on the bound framebuffer. Depth/stencil are never read after the pass, so tell the
+// driver not to write them back out of tile memory.
+void app_update_end_pass(app_t *a) {
+        const GLenum discards[2] = { GL_DEPTH_ATTACHMENT, GL_STENCIL_ATTACHMENT };
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, 2, discards);
+}
+
+// Locate the controllers again for the frame's display time and rebuild their model matrices, right
+// before they're drawn. Runs once per frame, not per view, so both eyes get the same pose. Only the
+// poses are refreshed, the button states stay as sampled.
+void app_update_late_latch(app_t *a, frame_packet_t *f) {
+        if (!ENABLE_LATE_LATCH) { return; }
+        telemetry_stage_begin(a->render_telemetry, RENDER_STAGE_LATE_LATCH);
+        f->pose_time = telemetry_now();
+        XrResult result = pose_cache_locate(&a->late_pose_cache, f->frame_state.predictedDisplayTime);
         assert(XR_SUCCEEDED(result));
+
+        // Keep the sampled pose if tracking dropped out since, and always in a replay (the locate still
+        // runs so the frame costs the same)
+        for (int i = 0; i < HAND_COUNT; i++) {
+                if (pose_cache_is_valid(&a->late_pose_cache, i) && !a->is_replay) {
+                        pose_cache_get_location(&a->late_pose_cache, i, &f->hand_locations[i]);
+                        pose_cache_models(&a->late_pose_cache, f->hand_models[i], i, i + 1);
+                }
+        }
+        telemetry_stage_end(a->render_telemetry, RENDER_STAGE_LATE_LATCH);
+}
+
+// Render a single view into its own swapchain
+void app_update_render_view(app_t *a, frame_packet_t *f, int v, float *view_proj) {
+        static const char *SCOPE_NAMES[MAX_VIEWS] = { "render_view_0", "render_view_1", "render_view_2", "render_view_3" };
+        trace_scope_t scope = trace_begin(SCOPE_NAMES[v], f->frame_state.predictedDisplayTime);
+        uint32_t image_index = app_update_acquire_swapchain_image(a, v);
+        int width = a->projection_layer_views[v].subImage.imageRect.extent.width;
+        int height = a->projection_layer_views[v].subImage.imageRect.extent.height;
+
+        // Hand MVPs, the model matrices come from app_update_transforms or the late latch
+        float hand_mvps[HAND_COUNT][16];
+        for (int i = 0; i < HAND_COUNT; i++) {
+                matrix_multiply(hand_mvps[i], view_proj, f->hand_models[i]);
+        }
+
+        // Render into the swapchain directly
+        glBindFramebuffer(GL_FRAMEBUFFER, a->framebuffers[v][image_index]);
+        app_update_gpu_timestamp(a, v, GPU_MARK_BEGIN);
+        app_update_begin_pass(a, width, height);
+        app_update_gpu_timestamp(a, v, GPU_MARK_CLEARED);
+
+        // Render Hands
+        glUseProgram(app_get_program(a, APP_PROGRAM_BOX));
+        for (int i = 0; i < HAND_COUNT; i++) {
+                glUniformMatrix4fv(0, 1, GL_FALSE, hand_mvps[i]);
+                glUniform2f(1, f->trigger_states[i].currentState, app_is_trigger_clicked(f, i) ? 1.0f : 0.0f);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+        }
+        app_update_gpu_timestamp(a, v, GPU_MARK_BOXES);
+
+        // Render Background
+        glUseProgram(app_get_program(a, APP_PROGRAM_BACKGROUND));
+        glUniformMatrix4fv(0, 1, GL_FALSE, view_proj);
+        glUniform3fv(1, 1, (float *)&f->hand_locations[0].pose.position);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        app_update_gpu_timestamp(a, v, GPU_MARK_BACKGROUND);
+
+        app_update_end_pass(a);
+        app_update_release_swapchain_image(a, v);
+        trace_end(&scope);
+}
+
+// Render every view in one pass into the layers of the array swapchain
+void app_update_render_multiview(app_t *a, frame_packet_t *f, float (*view_projs)[16]) {
+        trace_scope_t scope = trace_begin("render_multiview", f->frame_state.predictedDisplayTime);
+        uint32_t image_index = app_update_acquire_swapchain_image(a, 0);
+        int width = a->swapchain_widths[0];
+        int height = a->swapchain_heights[0];
+
+        // Both view_proj matrices go up in one uniform block, the shaders index it by gl_ViewID_OVR
+        glBindBuffer(GL_UNIFORM_BUFFER, a->view_proj_buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, a->view_count * 16 * sizeof(float), view_projs);
+
+        // Render into every layer of the swapchain directly, timed as view 0
+        glBindFramebuffer(GL_FRAMEBUFFER, a->framebuffers[0][image_index]);
+        app_update_gpu_timestamp(a, 0, GPU_MARK_BEGIN);
+        app_update_begin_pass(a, width, height);
+        app_update_gpu_timestamp(a, 0, GPU_MARK_CLEARED);
+
+        // Render Hands
+        glUseProgram(app_get_program(a, APP_PROGRAM_BOX));
+        for (int i = 0; i < HAND_COUNT; i++) {
+                glUniformMatrix4fv(0, 1, GL_FALSE, f->hand_models[i]);
+                glUniform2f(1, f->trigger_states[i].currentState, app_is_trigger_clicked(f, i) ? 1.0f : 0.0f);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+        }
+        app_update_gpu_timestamp(a, 0, GPU_MARK_BOXES);
+
+        // Render Background
+        glUseProgram(app_get_program(a, APP_PROGRAM_BACKGROUND));
+        glUniform3fv(1, 1, (float *)&f->hand_locations[0].pose.position);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        app_update_gpu_timestamp(a, 0, GPU_MARK_BACKGROUND);
+
+        app_update_end_pass(a);
+        app_update_release_swapchain_image(a, 0);
+        trace_end(&scope);
 }
 
 // Locate the views, and render into the swapchains
-void app_update_render(app_t *a) {
+void app_update_render(app_t *a, frame_packet_t *f) {
         XrResult result;
 
         // Reset Composition Layer
@@ -1231,40 +2463,30 @@ void app_update_render(app_t *a) {
         XrViewLocateInfo view_locate_info;
         view_locate_info.type = XR_TYPE_VIEW_LOCATE_INFO;
         view_locate_info.viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
-        view_locate_info.displayTime = a->frame_state.predictedDisplayTime;
+        view_locate_info.displayTime = f->frame_state.predictedDisplayTime;
         view_locate_info.space = a->stage_space;
+        telemetry_stage_begin(a->render_telemetry, RENDER_STAGE_LOCATE_VIEWS);
         result = xrLocateViews(a->session, &view_locate_info, &view_state, a->view_count, &a->view_submit_count, views);
         assert(XR_SUCCEEDED(result));
+        telemetry_stage_end(a->render_telemetry, RENDER_STAGE_LOCATE_VIEWS);
 
-        // Fill in Projection Views info
+        // Fill in Projection Views info, in multiview mode every view is a layer of swapchain 0
         for (int i = 0; i < a->view_submit_count; i++) {
+                int swapchain = a->is_multiview ? 0 : i;
                 a->projection_layer_views[i].type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW;
                 a->projection_layer_views[i].pose = views[i].pose;
                 a->projection_layer_views[i].fov = views[i].fov;
-                a->projection_layer_views[i].subImage.swapchain = a->swapchains[i];
+                a->projection_layer_views[i].subImage.swapchain = a->swapchains[swapchain];
                 a->projection_layer_views[i].subImage.imageRect.offset.x = 0;
                 a->projection_layer_views[i].subImage.imageRect.offset.y = 0;
-                a->projection_layer_views[i].subImage.imageRect.extent.width = a->swapchain_widths[i];
-                a->projection_layer_views[i].subImage.imageRect.extent.height = a->swapchain_heights[i];
-                a->projection_layer_views[i].subImage.imageArrayIndex = 0;
+                a->projection_layer_views[i].subImage.imageRect.extent.width = a->swapchain_widths[swapchain];
+                a->projection_layer_views[i].subImage.imageRect.extent.height = a->swapchain_heights[swapchain];
+                a->projection_layer_views[i].subImage.imageArrayIndex = a->is_multiview ? i : 0;
         }
 
+        // View Projections
+        float view_projs[MAX_VIEWS][16];
         for (int v = 0; v < a->view_submit_count; v++) {
-                // Acquire and wait for the swapchain image
-                uint32_t image_index;
-                XrSwapchainImageAcquireInfo acquire_info = { XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO };
-                result = xrAcquireSwapchainImage(a->swapchains[v], &acquire_info, &image_index);
-                assert(XR_SUCCEEDED(result));
-                XrSwapchainImageWaitInfo wait_info = { XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO };
-                wait_info.timeout = XR_INFINITE_DURATION;
-                result = xrWaitSwapchainImage(a->swapchains[v], &wait_info);
-                assert(XR_SUCCEEDED(result));
-                XrSwapchainImageOpenGLESKHR swapchain_image = a->swapchain_images[v][image_index];
-                uint32_t colour_tex = swapchain_image.image;
-                int width = a->projection_layer_views[v].subImage.imageRect.extent.width;
-                int height = a->projection_layer_views[v].subImage.imageRect.extent.height;
-
-                // Projection
                 float left = a->projection_layer_views[v].fov.angleLeft;
                 float right = a->projection_layer_views[v].fov.angleRight;
                 float up = a->projection_layer_views[v].fov.angleUp;
@@ -1272,100 +2494,148 @@ void app_update_render(app_t *a) {
                 float proj[16];
                 matrix_proj_opengl(proj, left, right, up, down, 0.01, 100.0);
 
-                // View, View Projection
-                float translation[16];
-                float rotation[16];
                 float view[16];
-                float view_proj[16];
-                float inverse_view_proj[16];
-                matrix_identity(translation);
-                matrix_translate(translation, translation, (float *)&a->projection_layer_views[v].pose.position);
-                matrix_rotation_from_quat(rotation, (float *)&a->projection_layer_views[v].pose.orientation);
-                matrix_multiply(view, translation, rotation);
-                matrix_inverse(view, view);
-                matrix_multiply(view_proj, proj, view);
-                matrix_inverse(inverse_view_proj, view_proj);
-
-                // Left MVP
-                float left_translation[16];
-                float left_rotation[16];
-                float left_model[16];
-                float left_mvp[16];
-                matrix_identity(left_translation);
-                matrix_translate(left_translation, left_translation, (float *)&a->hand_locations[0].pose.position);
-                matrix_rotation_from_quat(left_rotation, (float *)&a->hand_locations[0].pose.orientation);
-                matrix_multiply(left_model, left_translation, left_rotation);
-                matrix_multiply(left_mvp, view_proj, left_model);
-
-                // Right Model
-                float right_translation[16];
-                float right_rotation[16];
-                float right_model[16];
-                float right_mvp[16];
-                matrix_identity(right_translation);
-                matrix_translate(right_translation, right_translation, (float *)&a->hand_locations[1].pose.position);
-                matrix_rotation_from_quat(right_rotation, (float *)&a->hand_locations[1].pose.orientation);
-                matrix_multiply(right_model, right_translation, right_rotation);
-                matrix_multiply(right_mvp, view_proj, right_model);
-        
-                // Render into the swapchain directly
-                glBindFramebuffer(GL_FRAMEBUFFER, a->framebuffer);
-                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour_tex, 0);
-                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, a->depth_targets[v], 0);
-                glViewport(0, 0, width, height);
-                glClearColor(0.4, 0.4, 0.8, 1);
-                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-                // Render Left Hand
-                glUseProgram(a->box_program);
-                glUniformMatrix4fv(0, 1, GL_FALSE, left_mvp);
-                glUniform2f(1, a->trigger_states[0].currentState, (float)(a->trigger_click_states[0].currentState));
-                glDrawArrays(GL_TRIANGLES, 0, 36);
+                matrix_view_from_pose(view, &a->projection_layer_views[v].pose);
+                matrix_multiply(view_projs[v], proj, view);
+        }
 
-                // Render Right Hand
-                glUseProgram(a->box_program);
-                glUniformMatrix4fv(0, 1, GL_FALSE, right_mvp);
-                glUniform2f(1, a->trigger_states[1].currentState, (float)(a->trigger_click_states[1].currentState));
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-                
-                // Render Background
-                glUseProgram(a->background_program);
-                glUniformMatrix4fv(0, 1, GL_FALSE, view_proj);
-                glUniform3fv(1, 1, (float *)&a->hand_locations[0].pose.position);
-                glDrawArrays(GL_TRIANGLES, 0, 3);
-
-                // Release Image
-                XrSwapchainImageReleaseInfo release_info = { XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
-                result = xrReleaseSwapchainImage(a->swapchains[v], &release_info);
-                assert(XR_SUCCEEDED(result));
+        app_update_late_latch(a, f);
+
+        telemetry_stage_begin(a->render_telemetry, RENDER_STAGE_DRAW);
+        app_update_gpu_timers_begin_frame(a);
+        if (a->is_multiview) {
+                app_update_render_multiview(a, f, view_projs);
+        } else {
+                for (int v = 0; v < a->view_submit_count; v++) {
+                        app_update_render_view(a, f, v, view_projs[v]);
+                }
         }
+        app_update_gpu_timers_end_frame(a);
+        telemetry_stage_end(a->render_telemetry, RENDER_STAGE_DRAW);
 
         a->projection_layer.viewCount = a->view_submit_count;
         a->projection_layer.views = &a->projection_layer_views[0];
 }
 
 // Submit the frame
-void app_update_end_frame(app_t *a) {
+void app_update_end_frame(app_t *a, frame_packet_t *f) {
+        trace_scope_t scope = trace_begin("app_update_end_frame", f->frame_state.predictedDisplayTime);
         const XrCompositionLayerBaseHeader * layers[1] = { (XrCompositionLayerBaseHeader *)&a->projection_layer };
         XrFrameEndInfo frame_end = { XR_TYPE_FRAME_END_INFO };
-        frame_end.displayTime = a->frame_state.predictedDisplayTime;
+        frame_end.displayTime = f->frame_state.predictedDisplayTime;
         frame_end.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
-        frame_end.layerCount = a->should_render ? 1 : 0;
-        frame_end.layers = a->should_render ? layers : NULL;
+        frame_end.layerCount = f->should_render ? 1 : 0;
+        frame_end.layers = f->should_render ? layers : NULL;
+
+        // How stale the drawn poses are by the time the frame is handed to the compositor
+        if (f->should_render) {
+                int64_t now = telemetry_now();
+                telemetry_stage_add(a->render_telemetry, RENDER_STAGE_INPUT_POSE_AGE, now - f->input_pose_time);
+                telemetry_stage_add(a->render_telemetry, RENDER_STAGE_POSE_AGE, now - f->pose_time);
+        }
 
+        telemetry_stage_begin(a->render_telemetry, RENDER_STAGE_END_FRAME);
         XrResult result = xrEndFrame(a->session, &frame_end);
         assert(XR_SUCCEEDED(result));
+        telemetry_stage_end(a->render_telemetry, RENDER_STAGE_END_FRAME);
+        trace_end(&scope);
 }
 
-// Update the application while it is running
+// Take the next packet from the main thread and submit its frame, returns false once told to exit
+bool app_update_render_frame(app_t *a) {
+        telemetry_stage_begin(a->render_telemetry, RENDER_STAGE_POP_FRAME);
+        frame_packet_t *f = app_handoff_begin_pop(a);
+        telemetry_stage_end(a->render_telemetry, RENDER_STAGE_POP_FRAME);
+        if (f->is_exit) {
+                app_handoff_end_pop(a);
+                return false;
+        }
+
+        telemetry_stage_begin(a->render_telemetry, RENDER_STAGE_FRAME);
+        app_update_begin_frame(a, f);
+        if (f->should_render) {
+                app_update_render(a, f);
+        }
+        app_update_end_frame(a, f);
+        telemetry_stage_end(a->render_telemetry, RENDER_STAGE_FRAME);
+        app_handoff_end_pop(a);
+        telemetry_end_frame(a->render_telemetry);
+        return true;
+}
+
+// Update the application while it is running. With the render thread the frame is only handed over
+// here, otherwise it's rendered straight away.
 void app_update(app_t *a) {
+        bool was_session_ready = a->is_session_ready;
+        telemetry_stage_begin(a->telemetry, APP_STAGE_FRAME);
+        telemetry_stage_begin(a->telemetry, APP_STAGE_PUMP_EVENTS);
         app_update_pump_events(a);
-        if (!a->is_session_ready) { return; }
-        app_update_begin_frame_and_get_inputs(a);
+        telemetry_stage_end(a->telemetry, APP_STAGE_PUMP_EVENTS);
+
+        // Without a session the pump sleeps, for minutes while paused. Those pumps aren't frames, so
+        // drop their time rather than let it pile up into the first frame that does get committed.
+        if (!a->is_session_ready) {
+                telemetry_discard_frame(a->telemetry);
+                return;
+        }
+        if (!was_session_ready) {
+                telemetry_discard_frame(a->telemetry);
+                telemetry_stage_begin(a->telemetry, APP_STAGE_FRAME);
+        }
+        app_update_wait_frame_and_get_inputs(a);
         if (a->should_render) {
-                app_update_render(a);
+                telemetry_stage_begin(a->telemetry, APP_STAGE_TRANSFORMS);
+                app_update_transforms(a);
+                telemetry_stage_end(a->telemetry, APP_STAGE_TRANSFORMS);
+        }
+        app_update_push_frame(a);
+        if (!ENABLE_RENDER_THREAD) {
+                app_update_render_frame(a);
+        }
+        telemetry_stage_end(a->telemetry, APP_STAGE_FRAME);
+        telemetry_end_frame(a->telemetry);
+        if (!ENABLE_RENDER_THREAD) {
+                app_shaders_poll(a);
+        }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// RENDER THREAD
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Owns the GL context while the app runs, and submits every frame the main thread hands over
+void *app_render_thread(void *arg) {
+        app_t *a = (app_t *)arg;
+        trace_set_thread_name("render");
+        int egl_make_current_success = eglMakeCurrent(a->egl_display, a->egl_surface, a->egl_surface, a->egl_context);
+        assert(egl_make_current_success);
+
+        while (app_update_render_frame(a)) {
+                app_shaders_poll(a);
         }
-        app_update_end_frame(a);
+
+        eglMakeCurrent(a->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        return NULL;
+}
+
+// Hand the GL context over to a new render thread, called once init is done
+void app_start_render_thread(app_t *a) {
+        if (!ENABLE_RENDER_THREAD) { return; }
+        eglMakeCurrent(a->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        int create_result = pthread_create(&a->render_thread, NULL, app_render_thread, a);
+        assert(create_result == 0);
+        LOG_INFO("Render thread started\n");
+}
+
+// Let the render thread finish the frames it has, stop it, and take the GL context back for shutdown
+void app_stop_render_thread(app_t *a) {
+        if (!ENABLE_RENDER_THREAD) { return; }
+        frame_packet_t *f = app_handoff_begin_push(a);
+        f->is_exit = true;
+        app_handoff_end_push(a);
+        pthread_join(a->render_thread, NULL);
+        int egl_make_current_success = eglMakeCurrent(a->egl_display, a->egl_surface, a->egl_surface, a->egl_context);
+        assert(egl_make_current_success);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1376,10 +2646,14 @@ void app_update(app_t *a) {
 void app_shutdown(app_t *a) {
         XrResult result;
 
-        printf("Shutting Down\n");
+        LOG_INFO("Shutting Down\n");
+        app_update_report_idle(a);
+        app_quit_input_thread(a);
 
         // Clean up
-        for (int i=0; i < a->view_count; i++) {
+        app_destroy_opengl_gpu_timers(a);
+        app_destroy_opengl_framebuffers(a);
+        for (int i=0; i < a->swapchain_count; i++) {
                 result = xrDestroySwapchain(a->swapchains[i]);
                 assert(XR_SUCCEEDED(result));
         }
@@ -1397,21 +2671,219 @@ void app_shutdown(app_t *a) {
 
 	result = xrDestroyInstance(a->instance);
         assert(XR_SUCCEEDED(result));
+
+        jobs_shutdown(&a->jobs);
+
+        telemetry_report(a->telemetry);
+        telemetry_report(a->render_telemetry);
+        free(a->telemetry);
+        free(a->render_telemetry);
+
+        if (input_log_is_recording(&a->record_log)) {
+                LOG_INFO("Input log: recorded %lld frames and %lld events\n", (long long)a->record_log.frame_count, (long long)a->record_log.event_count);
+                input_log_close(&a->record_log);
+        }
+        input_log_close(&a->replay_log);
+
+        if (ENABLE_TRACE) {
+                char trace_path[512];
+                snprintf(trace_path, sizeof(trace_path), "%s/trace.json", platform_get_storage_path(a->platform));
+                trace_write(trace_path, APPNAME);
+        }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // ENTRY POINT
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-// Entrypoint called by the OS when using native activity
-extern "C" void android_main(android_app *app) {
+static int64_t app_now_ns() {
+        return app_clock_ns(CLOCK_MONOTONIC);
+}
+
+static int app_compare_int64(const void *lhs, const void *rhs) {
+        int64_t l = *(const int64_t *)lhs, r = *(const int64_t *)rhs;
+        return (l > r) - (l < r);
+}
+
+// Nearest rank percentile of an already sorted array
+static int64_t app_percentile(const int64_t *sorted, int count, int percent) {
+        int rank = (percent * count + 99) / 100;
+        return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Called by the platform's entrypoint (android_main, or main on the host). Runs the frame loop until
+// the runtime exits the session, then reports percentiles of the app_update time of the first
+// frames the session ran. Logs how long after this was called the first frame went through
+// app_update, the time to first frame. Arguments only exist on the host:
+//
+//      --frames N       frames to render before the mock runtime asks the app to exit (default 1000)
+//      --period-ms X    mock display period (default 1000/72)
+//      --unthrottled    don't sleep in the mock's xrWaitFrame, so frame times are pure CPU cost
+//      --no-locate-spaces  hide XR_KHR_locate_spaces in the mock, to run the xrLocateSpace fallback
+//      --input-hz N     input thread sample rate (default INPUT_SAMPLE_RATE_HZ)
+//      --record FILE    record what the frame loop observes to FILE, see input_log.h
+//      --replay FILE    run the session recorded in FILE, instead of the mock's script and inputs
+//      --idle-ms X      keep the app waiting X ms for the session to become ready
+//      --log-file FILE  write the log to FILE as well, see log.h
+//      --no-program-cache  compile every program from source, and leave the program cache alone
+//      --job-workers N  job pool workers (default one per core, less one for the render thread)
+//      --xr-latency-ms X   make each of the mock's init calls take X ms, like a real runtime's IPC
+int app_main(platform_t *platform, int argc, char **argv) {
+        int64_t launch_time = app_now_ns();
+        int frame_count = 1000;
+        double period_ms = 1000.0 / 72.0;
+        bool is_throttled = true;
+        bool is_locate_spaces = true;
+        double input_hz = INPUT_SAMPLE_RATE_HZ;
+        const char *record_path = NULL;
+        const char *replay_path = NULL;
+        double idle_ms = 0.0;
+        const char *log_path = NULL;
+        bool is_program_cache = ENABLE_PROGRAM_CACHE;
+        int job_worker_count = -1;
+        double xr_latency_ms = 0.0;
+        for (int i = 1; i < argc; i++) {
+                if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+                        frame_count = atoi(argv[++i]);
+                } else if (!strcmp(argv[i], "--period-ms") && i + 1 < argc) {
+                        period_ms = atof(argv[++i]);
+                } else if (!strcmp(argv[i], "--unthrottled")) {
+                        is_throttled = false;
+                } else if (!strcmp(argv[i], "--no-locate-spaces")) {
+                        is_locate_spaces = false;
+                } else if (!strcmp(argv[i], "--input-hz") && i + 1 < argc) {
+                        input_hz = atof(argv[++i]);
+                } else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+                        record_path = argv[++i];
+                } else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+                        replay_path = argv[++i];
+                } else if (!strcmp(argv[i], "--idle-ms") && i + 1 < argc) {
+                        idle_ms = atof(argv[++i]);
+                } else if (!strcmp(argv[i], "--log-file") && i + 1 < argc) {
+                        log_path = argv[++i];
+                } else if (!strcmp(argv[i], "--no-program-cache")) {
+                        is_program_cache = false;
+                } else if (!strcmp(argv[i], "--job-workers") && i + 1 < argc) {
+                        job_worker_count = atoi(argv[++i]);
+                } else if (!strcmp(argv[i], "--xr-latency-ms") && i + 1 < argc) {
+                        xr_latency_ms = atof(argv[++i]);
+                } else {
+                        LOG_INFO("usage: %s [--frames N] [--period-ms X] [--unthrottled] [--no-locate-spaces] [--input-hz N] [--record FILE] [--replay FILE] [--idle-ms X] [--log-file FILE] [--no-program-cache] [--job-workers N] [--xr-latency-ms X]\n", argv[0]);
+                        return 1;
+                }
+        }
+        assert(frame_count > 0);
+        assert(input_hz > 0.0);
+
+        char storage_record_path[512];
+        if (ENABLE_INPUT_RECORD && !record_path) {
+                snprintf(storage_record_path, sizeof(storage_record_path), "%s/input.qxrlog", platform_get_storage_path(platform));
+                record_path = storage_record_path;
+        }
+        char storage_log_path[512];
+        if (ENABLE_LOG_FILE && !log_path) {
+                snprintf(storage_log_path, sizeof(storage_log_path), "%s/log.qxrbin", platform_get_storage_path(platform));
+                log_path = storage_log_path;
+        }
+        if (log_path && !log_open_file(log_path)) {
+                LOG_ERROR("Can't write log file %s\n", log_path);
+        }
+        input_log_t replay_log = {};
+        if (replay_path && !input_log_open_replay(&replay_log, replay_path)) {
+                LOG_ERROR("Can't read input log %s\n", replay_path);
+                return 1;
+        }
+
+#ifdef XR_MOCK
+        xr_mock_config_t config;
+        xr_mock_default_config(&config, frame_count);
+        config.display_period_ns = (int64_t)(period_ms * 1e6);
+        config.is_throttled = is_throttled;
+        config.is_locate_spaces = is_locate_spaces;
+        config.ready_delay_ns = (int64_t)(idle_ms * 1e6);
+        config.call_latency_ns = (int64_t)(xr_latency_ms * 1e6);
+
+        // A replay scripts the session states from the log, and runs as many frames as it has
+        if (input_log_is_replaying(&replay_log)) {
+                input_log_frame_t *frame = (input_log_frame_t *)malloc(sizeof(input_log_frame_t));
+                input_log_record_type_t type;
+                input_log_event_t event;
+                config.state_event_count = 0;
+                config.is_script_on_wait = true;
+                while (input_log_read(&replay_log, &type, &event, frame)) {
+                        bool is_state = type == INPUT_LOG_RECORD_EVENT && event.type == XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED;
+                        if (is_state && config.state_event_count < XR_MOCK_MAX_STATE_EVENTS) {
+                                config.state_events[config.state_event_count++] = { event.frame, event.state };
+                        }
+                }
+                frame_count = (int)replay_log.frame_count;
+                input_log_rewind(&replay_log);
+                free(frame);
+        }
+        xr_mock_configure(&config);
+#else
+        (void)period_ms;
+        (void)is_throttled;
+        (void)is_locate_spaces;
+        (void)idle_ms;
+        (void)xr_latency_ms;
+#endif
+
+        log_start(APPNAME);
         app_t a{};
-        app_init(&a, app);
+        platform->save_state = &a;
+        platform->save_state_size = sizeof(app_t);
+        a.is_program_cache = is_program_cache;
+        a.job_worker_count = job_worker_count;
+        app_init(&a, platform);
+        a.input_sample_period_ns = (int64_t)(1e9 / input_hz);
+        a.replay_log = replay_log;
+        a.is_replay = input_log_is_replaying(&replay_log);
+        if (a.is_replay) {
+                LOG_INFO("Replaying input log %s\n", replay_path);
+        }
+        if (record_path) {
+                if (input_log_open_record(&a.record_log, record_path)) {
+                        LOG_INFO("Recording input log to %s\n", record_path);
+                } else {
+                        LOG_ERROR("Can't record input log to %s\n", record_path);
+                }
+        }
+        app_start_render_thread(&a);
+
+        // Room for the mock's frames plus the handful the state transitions take, a real runtime
+        // runs until exited so only the first frame_capacity frames count
+        int frame_capacity = frame_count + 64;
+        int64_t *frame_times = (int64_t *)malloc(frame_capacity * sizeof(int64_t));
+        int frames = 0;
 
         a.is_running = true;
         while (a.is_running) {
+                bool is_frame = a.is_session_ready;
+                int64_t start = app_now_ns();
                 app_update(&a);
+                int64_t end = app_now_ns();
+                if (is_frame && frames == 0) {
+                        SLOG_INFO("First frame: %.3f ms after launch\n", (end - launch_time) * 1e-6);
+                }
+                if (is_frame && frames < frame_capacity) {
+                        frame_times[frames++] = end - start;
+                }
         }
 
+        app_stop_render_thread(&a);
         app_shutdown(&a);
+        platform->save_state = NULL;
+        log_stop();
+
+        if (frames > 0) {
+                qsort(frame_times, frames, sizeof(int64_t), app_compare_int64);
+                LOG_INFO("Frame times over %d frames:\n", frames);
+                LOG_INFO("        p50: %8.3f ms\n", app_percentile(frame_times, frames, 50) * 1e-6);
+                LOG_INFO("        p95: %8.3f ms\n", app_percentile(frame_times, frames, 95) * 1e-6);
+                LOG_INFO("        p99: %8.3f ms\n", app_percentile(frame_times, frames, 99) * 1e-6);
+                LOG_INFO("        max: %8.3f ms\n", frame_times[frames - 1] * 1e-6);
+        }
+        free(frame_times);
+        return 0;
 }
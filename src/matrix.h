@@ -0,0 +1,778 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// MATRIX HELPERS
+//
+// Column major 4x4 float matrices (float[16]) and xyzw quaternions (float[4]), matching the
+// layout OpenXR and OpenGL use. The vector paths use NEON on aarch64 and SSE on x86-64, so the
+// same header builds for the headset and for host side benchmarks. Anything else falls back to
+// the scalar reference implementations below, which are also what the vector paths get
+// cross-checked against in `src/bench.cpp`.
+//
+// Scalar reference code is based on code from https://github.com/felselva/mathc
+// Copyright © 2018 Felipe Ferreira da Silva
+// https://github.com/felselva/mathc/blob/master/LICENSE
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "openxr/openxr.h"
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MATRIX_NEON
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define MATRIX_SSE
+#else
+#define MATRIX_SCALAR
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SCALAR REFERENCE
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline void matrix_identity_scalar(float *result) {
+	result[0] = (1.0);
+	result[1] = (0.0);
+	result[2] = (0.0);
+	result[3] = (0.0);
+	result[4] = (0.0);
+	result[5] = (1.0);
+	result[6] = (0.0);
+	result[7] = (0.0);
+	result[8] = (0.0);
+	result[9] = (0.0);
+	result[10] = (1.0);
+	result[11] = (0.0);
+	result[12] = (0.0);
+	result[13] = (0.0);
+	result[14] = (0.0);
+	result[15] = (1.0);
+}
+
+inline void matrix_translate_scalar(float *result, const float *m0, const float *v0) {
+	result[0] = m0[0];
+	result[1] = m0[1];
+	result[2] = m0[2];
+	result[3] = m0[3];
+	result[4] = m0[4];
+	result[5] = m0[5];
+	result[6] = m0[6];
+	result[7] = m0[7];
+	result[8] = m0[8];
+	result[9] = m0[9];
+	result[10] = m0[10];
+	result[11] = m0[11];
+	result[12] = m0[12] + v0[0];
+	result[13] = m0[13] + v0[1];
+	result[14] = m0[14] + v0[2];
+	result[15] = m0[15];
+}
+
+inline void matrix_rotation_from_quat_scalar(float *result, const float *q0) {
+	float xx = q0[0] * q0[0];
+	float yy = q0[1] * q0[1];
+	float zz = q0[2] * q0[2];
+	float xy = q0[0] * q0[1];
+	float zw = q0[2] * q0[3];
+	float xz = q0[0] * q0[2];
+	float yw = q0[1] * q0[3];
+	float yz = q0[1] * q0[2];
+	float xw = q0[0] * q0[3];
+	result[0] = (1.0) - (2.0) * (yy + zz);
+	result[1] = (2.0) * (xy + zw);
+	result[2] = (2.0) * (xz - yw);
+	result[3] = (0.0);
+	result[4] = (2.0) * (xy - zw);
+	result[5] = (1.0) - (2.0) * (xx + zz);
+	result[6] = (2.0) * (yz + xw);
+	result[7] = (0.0);
+	result[8] = (2.0) * (xz + yw);
+	result[9] = (2.0) * (yz - xw);
+	result[10] = (1.0) - (2.0) * (xx + yy);
+	result[11] = (0.0);
+	result[12] = (0.0);
+	result[13] = (0.0);
+	result[14] = (0.0);
+	result[15] = (1.0);
+}
+
+inline void matrix_inverse_scalar(float *result, const float *m0) {
+	float inverse[16];
+	float inverted_determinant;
+	float m11 = m0[0];
+	float m21 = m0[1];
+	float m31 = m0[2];
+	float m41 = m0[3];
+	float m12 = m0[4];
+	float m22 = m0[5];
+	float m32 = m0[6];
+	float m42 = m0[7];
+	float m13 = m0[8];
+	float m23 = m0[9];
+	float m33 = m0[10];
+	float m43 = m0[11];
+	float m14 = m0[12];
+	float m24 = m0[13];
+	float m34 = m0[14];
+	float m44 = m0[15];
+	inverse[0] = m22 * m33 * m44 - m22 * m43 * m34 - m23 * m32 * m44 + m23 * m42 * m34 + m24 * m32 * m43 - m24 * m42 * m33;
+	inverse[4] = -m12 * m33 * m44 + m12 * m43 * m34 + m13 * m32 * m44 - m13 * m42 * m34 - m14 * m32 * m43 + m14 * m42 * m33;
+	inverse[8] = m12 * m23 * m44 - m12 * m43 * m24 - m13 * m22 * m44 + m13 * m42 * m24 + m14 * m22 * m43 - m14 * m42 * m23;
+	inverse[12] = -m12 * m23 * m34 + m12 * m33 * m24 + m13 * m22 * m34 - m13 * m32 * m24 - m14 * m22 * m33 + m14 * m32 * m23;
+	inverse[1] = -m21 * m33 * m44 + m21 * m43 * m34 + m23 * m31 * m44 - m23 * m41 * m34 - m24 * m31 * m43 + m24 * m41 * m33;
+	inverse[5] =m11 * m33 * m44 -m11 * m43 * m34 - m13 * m31 * m44 + m13 * m41 * m34 + m14 * m31 * m43 - m14 * m41 * m33;
+	inverse[9] = -m11 * m23 * m44 +m11 * m43 * m24 + m13 * m21 * m44 - m13 * m41 * m24 - m14 * m21 * m43 + m14 * m41 * m23;
+	inverse[13] =m11 * m23 * m34 -m11 * m33 * m24 - m13 * m21 * m34 + m13 * m31 * m24 + m14 * m21 * m33 - m14 * m31 * m23;
+	inverse[2] = m21 * m32 * m44 - m21 * m42 * m34 - m22 * m31 * m44 + m22 * m41 * m34 + m24 * m31 * m42 - m24 * m41 * m32;
+	inverse[6] = -m11 * m32 * m44 +m11 * m42 * m34 + m12 * m31 * m44 - m12 * m41 * m34 - m14 * m31 * m42 + m14 * m41 * m32;
+	inverse[10] =m11 * m22 * m44 -m11 * m42 * m24 - m12 * m21 * m44 + m12 * m41 * m24 + m14 * m21 * m42 - m14 * m41 * m22;
+	inverse[14] = -m11 * m22 * m34 +m11 * m32 * m24 + m12 * m21 * m34 - m12 * m31 * m24 - m14 * m21 * m32 + m14 * m31 * m22;
+	inverse[3] = -m21 * m32 * m43 + m21 * m42 * m33 + m22 * m31 * m43 - m22 * m41 * m33 - m23 * m31 * m42 + m23 * m41 * m32;
+	inverse[7] = m11 * m32 * m43 - m11 * m42 * m33 - m12 * m31 * m43 + m12 * m41 * m33 + m13 * m31 * m42 - m13 * m41 * m32;
+	inverse[11] = -m11 * m22 * m43 + m11 * m42 * m23 + m12 * m21 * m43 - m12 * m41 * m23 - m13 * m21 * m42 + m13 * m41 * m22;
+	inverse[15] = m11 * m22 * m33 - m11 * m32 * m23 - m12 * m21 * m33 + m12 * m31 * m23 + m13 * m21 * m32 - m13 * m31 * m22;
+	inverted_determinant = (1.0) / (m11 * inverse[0] + m21 * inverse[4] + m31 * inverse[8] + m41 * inverse[12]);
+	result[0] = inverse[0] * inverted_determinant;
+	result[1] = inverse[1] * inverted_determinant;
+	result[2] = inverse[2] * inverted_determinant;
+	result[3] = inverse[3] * inverted_determinant;
+	result[4] = inverse[4] * inverted_determinant;
+	result[5] = inverse[5] * inverted_determinant;
+	result[6] = inverse[6] * inverted_determinant;
+	result[7] = inverse[7] * inverted_determinant;
+	result[8] = inverse[8] * inverted_determinant;
+	result[9] = inverse[9] * inverted_determinant;
+	result[10] = inverse[10] * inverted_determinant;
+	result[11] = inverse[11] * inverted_determinant;
+	result[12] = inverse[12] * inverted_determinant;
+	result[13] = inverse[13] * inverted_determinant;
+	result[14] = inverse[14] * inverted_determinant;
+	result[15] = inverse[15] * inverted_determinant;
+}
+
+inline void matrix_multiply_scalar(float *result, const float *m0, const float *m1) {
+	float multiplied[16];
+	multiplied[0] = m0[0] * m1[0] + m0[4] * m1[1] + m0[8] * m1[2] + m0[12] * m1[3];
+	multiplied[1] = m0[1] * m1[0] + m0[5] * m1[1] + m0[9] * m1[2] + m0[13] * m1[3];
+	multiplied[2] = m0[2] * m1[0] + m0[6] * m1[1] + m0[10] * m1[2] + m0[14] * m1[3];
+	multiplied[3] = m0[3] * m1[0] + m0[7] * m1[1] + m0[11] * m1[2] + m0[15] * m1[3];
+	multiplied[4] = m0[0] * m1[4] + m0[4] * m1[5] + m0[8] * m1[6] + m0[12] * m1[7];
+	multiplied[5] = m0[1] * m1[4] + m0[5] * m1[5] + m0[9] * m1[6] + m0[13] * m1[7];
+	multiplied[6] = m0[2] * m1[4] + m0[6] * m1[5] + m0[10] * m1[6] + m0[14] * m1[7];
+	multiplied[7] = m0[3] * m1[4] + m0[7] * m1[5] + m0[11] * m1[6] + m0[15] * m1[7];
+	multiplied[8] = m0[0] * m1[8] + m0[4] * m1[9] + m0[8] * m1[10] + m0[12] * m1[11];
+	multiplied[9] = m0[1] * m1[8] + m0[5] * m1[9] + m0[9] * m1[10] + m0[13] * m1[11];
+	multiplied[10] = m0[2] * m1[8] + m0[6] * m1[9] + m0[10] * m1[10] + m0[14] * m1[11];
+	multiplied[11] = m0[3] * m1[8] + m0[7] * m1[9] + m0[11] * m1[10] + m0[15] * m1[11];
+	multiplied[12] = m0[0] * m1[12] + m0[4] * m1[13] + m0[8] * m1[14] + m0[12] * m1[15];
+	multiplied[13] = m0[1] * m1[12] + m0[5] * m1[13] + m0[9] * m1[14] + m0[13] * m1[15];
+	multiplied[14] = m0[2] * m1[12] + m0[6] * m1[13] + m0[10] * m1[14] + m0[14] * m1[15];
+	multiplied[15] = m0[3] * m1[12] + m0[7] * m1[13] + m0[11] * m1[14] + m0[15] * m1[15];
+	result[0] = multiplied[0];
+	result[1] = multiplied[1];
+	result[2] = multiplied[2];
+	result[3] = multiplied[3];
+	result[4] = multiplied[4];
+	result[5] = multiplied[5];
+	result[6] = multiplied[6];
+	result[7] = multiplied[7];
+	result[8] = multiplied[8];
+	result[9] = multiplied[9];
+	result[10] = multiplied[10];
+	result[11] = multiplied[11];
+	result[12] = multiplied[12];
+	result[13] = multiplied[13];
+	result[14] = multiplied[14];
+	result[15] = multiplied[15];
+}
+
+// Inverse of a rotation + translation matrix: transpose the rotation, rotate and negate the translation
+inline void matrix_inverse_rigid_scalar(float *result, const float *m0) {
+	float t0 = m0[12];
+	float t1 = m0[13];
+	float t2 = m0[14];
+	float inverse[16];
+	inverse[0] = m0[0];
+	inverse[1] = m0[4];
+	inverse[2] = m0[8];
+	inverse[3] = (0.0);
+	inverse[4] = m0[1];
+	inverse[5] = m0[5];
+	inverse[6] = m0[9];
+	inverse[7] = (0.0);
+	inverse[8] = m0[2];
+	inverse[9] = m0[6];
+	inverse[10] = m0[10];
+	inverse[11] = (0.0);
+	inverse[12] = -(m0[0] * t0 + m0[1] * t1 + m0[2] * t2);
+	inverse[13] = -(m0[4] * t0 + m0[5] * t1 + m0[6] * t2);
+	inverse[14] = -(m0[8] * t0 + m0[9] * t1 + m0[10] * t2);
+	inverse[15] = (1.0);
+	memcpy(result, inverse, sizeof(inverse));
+}
+
+// Inverse of any matrix with a (0, 0, 0, 1) bottom row: invert the upper 3x3, then the translation
+inline void matrix_inverse_affine_scalar(float *result, const float *m0) {
+	float inverse[16];
+	inverse[0] = m0[5] * m0[10] - m0[9] * m0[6];
+	inverse[1] = m0[9] * m0[2] - m0[1] * m0[10];
+	inverse[2] = m0[1] * m0[6] - m0[5] * m0[2];
+	inverse[4] = m0[8] * m0[6] - m0[4] * m0[10];
+	inverse[5] = m0[0] * m0[10] - m0[8] * m0[2];
+	inverse[6] = m0[4] * m0[2] - m0[0] * m0[6];
+	inverse[8] = m0[4] * m0[9] - m0[8] * m0[5];
+	inverse[9] = m0[8] * m0[1] - m0[0] * m0[9];
+	inverse[10] = m0[0] * m0[5] - m0[4] * m0[1];
+	float inverted_determinant = (1.0) / (m0[0] * inverse[0] + m0[4] * inverse[1] + m0[8] * inverse[2]);
+	for (int i = 0; i < 12; i++) {
+		inverse[i] *= inverted_determinant;
+	}
+	inverse[3] = (0.0);
+	inverse[7] = (0.0);
+	inverse[11] = (0.0);
+	inverse[12] = -(inverse[0] * m0[12] + inverse[4] * m0[13] + inverse[8] * m0[14]);
+	inverse[13] = -(inverse[1] * m0[12] + inverse[5] * m0[13] + inverse[9] * m0[14]);
+	inverse[14] = -(inverse[2] * m0[12] + inverse[6] * m0[13] + inverse[10] * m0[14]);
+	inverse[15] = (1.0);
+	memcpy(result, inverse, sizeof(inverse));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// FLOAT4 VECTOR OPS
+//
+// Just enough of a 4-wide float type to write the matrix kernels once for both NEON and SSE.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if defined(MATRIX_NEON)
+
+typedef float32x4_t f32x4;
+
+inline f32x4 f32x4_load(const float *p) { return vld1q_f32(p); }
+inline void f32x4_store(float *p, f32x4 v) { vst1q_f32(p, v); }
+inline f32x4 f32x4_splat(float s) { return vdupq_n_f32(s); }
+inline f32x4 f32x4_set(float x, float y, float z, float w) {
+        float v[4] = { x, y, z, w };
+        return vld1q_f32(v);
+}
+inline f32x4 f32x4_add(f32x4 a, f32x4 b) { return vaddq_f32(a, b); }
+inline f32x4 f32x4_sub(f32x4 a, f32x4 b) { return vsubq_f32(a, b); }
+inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { return vmulq_f32(a, b); }
+// a + b * c
+inline f32x4 f32x4_madd(f32x4 a, f32x4 b, f32x4 c) { return vfmaq_f32(a, b, c); }
+// a + b * c[lane]
+#define f32x4_madd_lane(a, b, c, lane) vfmaq_laneq_f32((a), (b), (c), (lane))
+#define f32x4_mul_lane(b, c, lane) vmulq_laneq_f32((b), (c), (lane))
+inline float f32x4_get_w(f32x4 v) { return vgetq_lane_f32(v, 3); }
+// Zeroes the w lane
+inline f32x4 f32x4_xyz0(f32x4 v) { return vsetq_lane_f32(0.0f, v, 3); }
+// (y, z, x, w)
+inline f32x4 f32x4_yzxw(f32x4 v) {
+        float32x2_t lo = vget_low_f32(v);
+        float32x2_t hi = vget_high_f32(v);
+        return vcombine_f32(vext_f32(lo, hi, 1), vtrn1_f32(lo, vrev64_f32(hi)));
+}
+inline float f32x4_dot3(f32x4 a, f32x4 b) {
+        f32x4 m = vmulq_f32(a, b);
+        return vgetq_lane_f32(m, 0) + vgetq_lane_f32(m, 1) + vgetq_lane_f32(m, 2);
+}
+inline f32x4 f32x4_set_w(f32x4 v, float w) { return vsetq_lane_f32(w, v, 3); }
+inline void f32x4_transpose(f32x4 *r0, f32x4 *r1, f32x4 *r2, f32x4 *r3) {
+        float32x4x2_t t01 = vtrnq_f32(*r0, *r1);
+        float32x4x2_t t23 = vtrnq_f32(*r2, *r3);
+        *r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+        *r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+        *r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+        *r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+
+#elif defined(MATRIX_SSE)
+
+typedef __m128 f32x4;
+
+inline f32x4 f32x4_load(const float *p) { return _mm_loadu_ps(p); }
+inline void f32x4_store(float *p, f32x4 v) { _mm_storeu_ps(p, v); }
+inline f32x4 f32x4_splat(float s) { return _mm_set1_ps(s); }
+inline f32x4 f32x4_set(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+inline f32x4 f32x4_add(f32x4 a, f32x4 b) { return _mm_add_ps(a, b); }
+inline f32x4 f32x4_sub(f32x4 a, f32x4 b) { return _mm_sub_ps(a, b); }
+inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { return _mm_mul_ps(a, b); }
+// a + b * c
+inline f32x4 f32x4_madd(f32x4 a, f32x4 b, f32x4 c) { return _mm_add_ps(a, _mm_mul_ps(b, c)); }
+// a + b * c[lane]
+#define f32x4_madd_lane(a, b, c, lane) \
+        _mm_add_ps((a), _mm_mul_ps((b), _mm_shuffle_ps((c), (c), _MM_SHUFFLE(lane, lane, lane, lane))))
+#define f32x4_mul_lane(b, c, lane) \
+        _mm_mul_ps((b), _mm_shuffle_ps((c), (c), _MM_SHUFFLE(lane, lane, lane, lane)))
+inline float f32x4_get_w(f32x4 v) { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))); }
+// Zeroes the w lane
+inline f32x4 f32x4_xyz0(f32x4 v) {
+        const __m128 mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+        return _mm_and_ps(v, mask);
+}
+// (y, z, x, w)
+inline f32x4 f32x4_yzxw(f32x4 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1)); }
+inline float f32x4_dot3(f32x4 a, f32x4 b) {
+        float m[4];
+        _mm_storeu_ps(m, _mm_mul_ps(a, b));
+        return m[0] + m[1] + m[2];
+}
+inline f32x4 f32x4_set_w(f32x4 v, float w) {
+        // (z, w) of v with w replaced, then recombined with (x, y)
+        f32x4 zw = _mm_shuffle_ps(v, _mm_set_ss(w), _MM_SHUFFLE(0, 0, 3, 2));
+        return _mm_shuffle_ps(v, zw, _MM_SHUFFLE(2, 0, 1, 0));
+}
+inline void f32x4_transpose(f32x4 *r0, f32x4 *r1, f32x4 *r2, f32x4 *r3) {
+        _MM_TRANSPOSE4_PS(*r0, *r1, *r2, *r3);
+}
+
+#endif
+
+#if !defined(MATRIX_SCALAR)
+
+// Cross product of the xyz lanes, the w lane of the result is a.w * b.w - a.w * b.w (0 if finite)
+inline f32x4 f32x4_cross3(f32x4 a, f32x4 b) {
+        f32x4 t = f32x4_sub(f32x4_mul(a, f32x4_yzxw(b)), f32x4_mul(f32x4_yzxw(a), b));
+        return f32x4_yzxw(t);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// MATRIX API
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Poses as a structure of arrays: a row of `stride` floats per component, orientation x, y, z, w
+// then position x, y, z, with pose i in column i of every row
+enum matrix_pose_component_t {
+        MATRIX_POSE_QX,
+        MATRIX_POSE_QY,
+        MATRIX_POSE_QZ,
+        MATRIX_POSE_QW,
+        MATRIX_POSE_PX,
+        MATRIX_POSE_PY,
+        MATRIX_POSE_PZ,
+        MATRIX_POSE_COMPONENTS,
+};
+
+inline void matrix_pose_from_soa(XrPosef *pose, const float *poses, int stride, int i) {
+        pose->orientation.x = poses[MATRIX_POSE_QX * stride + i];
+        pose->orientation.y = poses[MATRIX_POSE_QY * stride + i];
+        pose->orientation.z = poses[MATRIX_POSE_QZ * stride + i];
+        pose->orientation.w = poses[MATRIX_POSE_QW * stride + i];
+        pose->position.x = poses[MATRIX_POSE_PX * stride + i];
+        pose->position.y = poses[MATRIX_POSE_PY * stride + i];
+        pose->position.z = poses[MATRIX_POSE_PZ * stride + i];
+}
+
+#if defined(MATRIX_SCALAR)
+
+inline void matrix_identity(float *result) { matrix_identity_scalar(result); }
+inline void matrix_translate(float *result, const float *m0, const float *v0) { matrix_translate_scalar(result, m0, v0); }
+inline void matrix_rotation_from_quat(float *result, const float *q0) { matrix_rotation_from_quat_scalar(result, q0); }
+inline void matrix_inverse(float *result, const float *m0) { matrix_inverse_scalar(result, m0); }
+inline void matrix_inverse_rigid(float *result, const float *m0) { matrix_inverse_rigid_scalar(result, m0); }
+inline void matrix_inverse_affine(float *result, const float *m0) { matrix_inverse_affine_scalar(result, m0); }
+inline void matrix_multiply(float *result, const float *m0, const float *m1) { matrix_multiply_scalar(result, m0, m1); }
+
+inline void matrix_model_from_pose(float *result, const XrPosef *pose) {
+        matrix_rotation_from_quat_scalar(result, &pose->orientation.x);
+        result[12] = pose->position.x;
+        result[13] = pose->position.y;
+        result[14] = pose->position.z;
+}
+
+inline void matrix_view_from_pose(float *result, const XrPosef *pose) {
+        const XrVector3f *p = &pose->position;
+        float conjugate[4] = { -pose->orientation.x, -pose->orientation.y, -pose->orientation.z, pose->orientation.w };
+        matrix_rotation_from_quat_scalar(result, conjugate);
+        result[12] = -(result[0] * p->x + result[4] * p->y + result[8] * p->z);
+        result[13] = -(result[1] * p->x + result[5] * p->y + result[9] * p->z);
+        result[14] = -(result[2] * p->x + result[6] * p->y + result[10] * p->z);
+}
+
+inline void matrix_model_from_poses(float *results, const XrPosef *poses, int count) {
+        for (int i = 0; i < count; i++) {
+                matrix_model_from_pose(results + i * 16, poses + i);
+        }
+}
+
+inline void matrix_model_from_poses_soa(float *results, const float *poses, int stride, int count) {
+        for (int i = 0; i < count; i++) {
+                XrPosef pose;
+                matrix_pose_from_soa(&pose, poses, stride, i);
+                matrix_model_from_pose(results + i * 16, &pose);
+        }
+}
+
+#else
+
+inline void matrix_identity(float *result) {
+        f32x4_store(result + 0, f32x4_set(1.0f, 0.0f, 0.0f, 0.0f));
+        f32x4_store(result + 4, f32x4_set(0.0f, 1.0f, 0.0f, 0.0f));
+        f32x4_store(result + 8, f32x4_set(0.0f, 0.0f, 1.0f, 0.0f));
+        f32x4_store(result + 12, f32x4_set(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+// Note: v0 is a vec3, so only the first three floats are read
+inline void matrix_translate(float *result, const float *m0, const float *v0) {
+        f32x4 c3 = f32x4_add(f32x4_load(m0 + 12), f32x4_set(v0[0], v0[1], v0[2], 0.0f));
+        f32x4_store(result + 0, f32x4_load(m0 + 0));
+        f32x4_store(result + 4, f32x4_load(m0 + 4));
+        f32x4_store(result + 8, f32x4_load(m0 + 8));
+        f32x4_store(result + 12, c3);
+}
+
+// The rotation columns of an xyzw quaternion. The nine products all come out of three vector
+// multiplies, as 2 * (xx, yy, zz), 2 * (xy, yz, zx) and 2 * (zw, xw, yw), and the sums and
+// differences of the last two give every off-diagonal term, so only the final gather is scalar.
+inline void matrix_quat_columns(f32x4 q, f32x4 *c0, f32x4 *c1, f32x4 *c2) {
+        f32x4 q2 = f32x4_add(q, q);
+        f32x4 squares = f32x4_mul(q2, q);
+        f32x4 cross = f32x4_mul(q2, f32x4_yzxw(q));
+        f32x4 scaled_w = f32x4_mul_lane(f32x4_yzxw(f32x4_yzxw(q2)), q, 3);
+        f32x4 squares_yzx = f32x4_yzxw(squares);
+
+        float diag[4], sum[4], diff[4];
+        f32x4_store(diag, f32x4_sub(f32x4_splat(1.0f), f32x4_add(squares_yzx, f32x4_yzxw(squares_yzx))));
+        f32x4_store(sum, f32x4_add(cross, scaled_w));
+        f32x4_store(diff, f32x4_sub(cross, scaled_w));
+
+        *c0 = f32x4_set(diag[0], sum[0], diff[2], 0.0f);
+        *c1 = f32x4_set(diff[0], diag[1], sum[1], 0.0f);
+        *c2 = f32x4_set(sum[2], diff[1], diag[2], 0.0f);
+}
+
+inline void matrix_rotation_from_quat(float *result, const float *q0) {
+        f32x4 c0, c1, c2;
+        matrix_quat_columns(f32x4_load(q0), &c0, &c1, &c2);
+        f32x4_store(result + 0, c0);
+        f32x4_store(result + 4, c1);
+        f32x4_store(result + 8, c2);
+        f32x4_store(result + 12, f32x4_set(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+// Model matrix (translation * rotation) straight from an XrPosef, in one pass
+inline void matrix_model_from_pose(float *result, const XrPosef *pose) {
+        const XrQuaternionf *q = &pose->orientation;
+        const XrVector3f *p = &pose->position;
+        f32x4 c0, c1, c2;
+        matrix_quat_columns(f32x4_load(&q->x), &c0, &c1, &c2);
+        f32x4_store(result + 0, c0);
+        f32x4_store(result + 4, c1);
+        f32x4_store(result + 8, c2);
+        f32x4_store(result + 12, f32x4_set(p->x, p->y, p->z, 1.0f));
+}
+
+// View matrix (inverse of the pose's rigid transform) straight from an XrPosef. The inverse
+// rotation is just the rotation of the conjugate quaternion, so nothing actually gets inverted.
+inline void matrix_view_from_pose(float *result, const XrPosef *pose) {
+        const XrQuaternionf *q = &pose->orientation;
+        const XrVector3f *p = &pose->position;
+        f32x4 c0, c1, c2;
+        matrix_quat_columns(f32x4_mul(f32x4_load(&q->x), f32x4_set(-1.0f, -1.0f, -1.0f, 1.0f)), &c0, &c1, &c2);
+        f32x4 c3 = f32x4_mul(c0, f32x4_splat(-p->x));
+        c3 = f32x4_madd(c3, c1, f32x4_splat(-p->y));
+        c3 = f32x4_madd(c3, c2, f32x4_splat(-p->z));
+        f32x4_store(result + 0, c0);
+        f32x4_store(result + 4, c1);
+        f32x4_store(result + 8, c2);
+        f32x4_store(result + 12, f32x4_set_w(c3, 1.0f));
+}
+
+// Model matrices for an array of poses, results is count * 16 floats. Works on four poses at a
+// time with one pose per lane, then transposes the rotation columns back out per pose.
+inline void matrix_model_from_poses(float *results, const XrPosef *poses, int count) {
+        const f32x4 one = f32x4_splat(1.0f);
+        const f32x4 two = f32x4_splat(2.0f);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+                const XrPosef *p = poses + i;
+                float *r = results + i * 16;
+
+                // Lane k of x/y/z/w is the quaternion of pose i + k
+                f32x4 x = f32x4_load(&p[0].orientation.x);
+                f32x4 y = f32x4_load(&p[1].orientation.x);
+                f32x4 z = f32x4_load(&p[2].orientation.x);
+                f32x4 w = f32x4_load(&p[3].orientation.x);
+                f32x4_transpose(&x, &y, &z, &w);
+
+                f32x4 xx = f32x4_mul(x, x), yy = f32x4_mul(y, y), zz = f32x4_mul(z, z);
+                f32x4 xy = f32x4_mul(x, y), zw = f32x4_mul(z, w), xz = f32x4_mul(x, z);
+                f32x4 yw = f32x4_mul(y, w), yz = f32x4_mul(y, z), xw = f32x4_mul(x, w);
+
+                // rRC is row R, column C of the rotation, for all four poses
+                f32x4 r00 = f32x4_sub(one, f32x4_mul(two, f32x4_add(yy, zz)));
+                f32x4 r10 = f32x4_mul(two, f32x4_add(xy, zw));
+                f32x4 r20 = f32x4_mul(two, f32x4_sub(xz, yw));
+                f32x4 r01 = f32x4_mul(two, f32x4_sub(xy, zw));
+                f32x4 r11 = f32x4_sub(one, f32x4_mul(two, f32x4_add(xx, zz)));
+                f32x4 r21 = f32x4_mul(two, f32x4_add(yz, xw));
+                f32x4 r02 = f32x4_mul(two, f32x4_add(xz, yw));
+                f32x4 r12 = f32x4_mul(two, f32x4_sub(yz, xw));
+                f32x4 r22 = f32x4_sub(one, f32x4_mul(two, f32x4_add(xx, yy)));
+                f32x4 r30 = f32x4_splat(0.0f), r31 = r30, r32 = r30;
+
+                f32x4_transpose(&r00, &r10, &r20, &r30);
+                f32x4_transpose(&r01, &r11, &r21, &r31);
+                f32x4_transpose(&r02, &r12, &r22, &r32);
+
+                f32x4_store(r + 0, r00);
+                f32x4_store(r + 4, r01);
+                f32x4_store(r + 8, r02);
+                f32x4_store(r + 12, f32x4_set(p[0].position.x, p[0].position.y, p[0].position.z, 1.0f));
+                f32x4_store(r + 16, r10);
+                f32x4_store(r + 20, r11);
+                f32x4_store(r + 24, r12);
+                f32x4_store(r + 28, f32x4_set(p[1].position.x, p[1].position.y, p[1].position.z, 1.0f));
+                f32x4_store(r + 32, r20);
+                f32x4_store(r + 36, r21);
+                f32x4_store(r + 40, r22);
+                f32x4_store(r + 44, f32x4_set(p[2].position.x, p[2].position.y, p[2].position.z, 1.0f));
+                f32x4_store(r + 48, r30);
+                f32x4_store(r + 52, r31);
+                f32x4_store(r + 56, r32);
+                f32x4_store(r + 60, f32x4_set(p[3].position.x, p[3].position.y, p[3].position.z, 1.0f));
+        }
+        for (; i < count; i++) {
+                matrix_model_from_pose(results + i * 16, poses + i);
+        }
+}
+
+// As above, for poses already laid out as a structure of arrays (see matrix_pose_component_t), so
+// the quaternion lanes load straight from memory and only the results get transposed
+inline void matrix_model_from_poses_soa(float *results, const float *poses, int stride, int count) {
+        const f32x4 one = f32x4_splat(1.0f);
+        const f32x4 two = f32x4_splat(2.0f);
+        const f32x4 zero = f32x4_splat(0.0f);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+                float *r = results + i * 16;
+                f32x4 x = f32x4_load(poses + MATRIX_POSE_QX * stride + i);
+                f32x4 y = f32x4_load(poses + MATRIX_POSE_QY * stride + i);
+                f32x4 z = f32x4_load(poses + MATRIX_POSE_QZ * stride + i);
+                f32x4 w = f32x4_load(poses + MATRIX_POSE_QW * stride + i);
+
+                f32x4 xx = f32x4_mul(x, x), yy = f32x4_mul(y, y), zz = f32x4_mul(z, z);
+                f32x4 xy = f32x4_mul(x, y), zw = f32x4_mul(z, w), xz = f32x4_mul(x, z);
+                f32x4 yw = f32x4_mul(y, w), yz = f32x4_mul(y, z), xw = f32x4_mul(x, w);
+
+                // rRC is row R, column C of the model matrix, for all four poses
+                f32x4 r00 = f32x4_sub(one, f32x4_mul(two, f32x4_add(yy, zz)));
+                f32x4 r10 = f32x4_mul(two, f32x4_add(xy, zw));
+                f32x4 r20 = f32x4_mul(two, f32x4_sub(xz, yw));
+                f32x4 r01 = f32x4_mul(two, f32x4_sub(xy, zw));
+                f32x4 r11 = f32x4_sub(one, f32x4_mul(two, f32x4_add(xx, zz)));
+                f32x4 r21 = f32x4_mul(two, f32x4_add(yz, xw));
+                f32x4 r02 = f32x4_mul(two, f32x4_add(xz, yw));
+                f32x4 r12 = f32x4_mul(two, f32x4_sub(yz, xw));
+                f32x4 r22 = f32x4_sub(one, f32x4_mul(two, f32x4_add(xx, yy)));
+                f32x4 r03 = f32x4_load(poses + MATRIX_POSE_PX * stride + i);
+                f32x4 r13 = f32x4_load(poses + MATRIX_POSE_PY * stride + i);
+                f32x4 r23 = f32x4_load(poses + MATRIX_POSE_PZ * stride + i);
+                f32x4 r30 = zero, r31 = zero, r32 = zero, r33 = one;
+
+                f32x4_transpose(&r00, &r10, &r20, &r30);
+                f32x4_transpose(&r01, &r11, &r21, &r31);
+                f32x4_transpose(&r02, &r12, &r22, &r32);
+                f32x4_transpose(&r03, &r13, &r23, &r33);
+
+                f32x4_store(r + 0, r00);
+                f32x4_store(r + 4, r01);
+                f32x4_store(r + 8, r02);
+                f32x4_store(r + 12, r03);
+                f32x4_store(r + 16, r10);
+                f32x4_store(r + 20, r11);
+                f32x4_store(r + 24, r12);
+                f32x4_store(r + 28, r13);
+                f32x4_store(r + 32, r20);
+                f32x4_store(r + 36, r21);
+                f32x4_store(r + 40, r22);
+                f32x4_store(r + 44, r23);
+                f32x4_store(r + 48, r30);
+                f32x4_store(r + 52, r31);
+                f32x4_store(r + 56, r32);
+                f32x4_store(r + 60, r33);
+        }
+        for (; i < count; i++) {
+                XrPosef pose;
+                matrix_pose_from_soa(&pose, poses, stride, i);
+                matrix_model_from_pose(results + i * 16, &pose);
+        }
+}
+
+// General inverse using the column cross product form (Lengyel, Foundations of Game Engine
+// Development Vol. 1, 1.7.5). Columns are a, b, c, d with bottom row (x, y, z, w).
+inline void matrix_inverse(float *result, const float *m0) {
+        f32x4 ca = f32x4_load(m0 + 0);
+        f32x4 cb = f32x4_load(m0 + 4);
+        f32x4 cc = f32x4_load(m0 + 8);
+        f32x4 cd = f32x4_load(m0 + 12);
+        float x = f32x4_get_w(ca);
+        float y = f32x4_get_w(cb);
+        float z = f32x4_get_w(cc);
+        float w = f32x4_get_w(cd);
+        f32x4 a = f32x4_xyz0(ca);
+        f32x4 b = f32x4_xyz0(cb);
+        f32x4 c = f32x4_xyz0(cc);
+        f32x4 d = f32x4_xyz0(cd);
+
+        f32x4 s = f32x4_cross3(a, b);
+        f32x4 t = f32x4_cross3(c, d);
+        f32x4 u = f32x4_sub(f32x4_mul(a, f32x4_splat(y)), f32x4_mul(b, f32x4_splat(x)));
+        f32x4 v = f32x4_sub(f32x4_mul(c, f32x4_splat(w)), f32x4_mul(d, f32x4_splat(z)));
+
+        f32x4 inv_det = f32x4_splat(1.0f / (f32x4_dot3(s, v) + f32x4_dot3(t, u)));
+        s = f32x4_mul(s, inv_det);
+        t = f32x4_mul(t, inv_det);
+        u = f32x4_mul(u, inv_det);
+        v = f32x4_mul(v, inv_det);
+
+        // Rows of the inverse
+        f32x4 r0 = f32x4_madd(f32x4_cross3(b, v), t, f32x4_splat(y));
+        f32x4 r1 = f32x4_sub(f32x4_cross3(v, a), f32x4_mul(t, f32x4_splat(x)));
+        f32x4 r2 = f32x4_madd(f32x4_cross3(d, u), s, f32x4_splat(w));
+        f32x4 r3 = f32x4_sub(f32x4_cross3(u, c), f32x4_mul(s, f32x4_splat(z)));
+
+        // Transpose rows into columns, the w lanes of the rows are zero so the last column is
+        // filled in from the dot products instead
+        float w0 = -f32x4_dot3(b, t);
+        float w1 = f32x4_dot3(a, t);
+        float w2 = -f32x4_dot3(d, s);
+        float w3 = f32x4_dot3(c, s);
+        f32x4_transpose(&r0, &r1, &r2, &r3);
+        f32x4_store(result + 0, r0);
+        f32x4_store(result + 4, r1);
+        f32x4_store(result + 8, r2);
+        f32x4_store(result + 12, f32x4_set(w0, w1, w2, w3));
+}
+
+// Inverse of a rotation + translation matrix: transpose the rotation, rotate and negate the translation
+inline void matrix_inverse_rigid(float *result, const float *m0) {
+        f32x4 r0 = f32x4_xyz0(f32x4_load(m0 + 0));
+        f32x4 r1 = f32x4_xyz0(f32x4_load(m0 + 4));
+        f32x4 r2 = f32x4_xyz0(f32x4_load(m0 + 8));
+        f32x4 r3 = f32x4_splat(0.0f);
+        f32x4 t = f32x4_load(m0 + 12);
+        f32x4_transpose(&r0, &r1, &r2, &r3);
+
+        f32x4 c3 = f32x4_mul_lane(r0, t, 0);
+        c3 = f32x4_madd_lane(c3, r1, t, 1);
+        c3 = f32x4_madd_lane(c3, r2, t, 2);
+        c3 = f32x4_set_w(f32x4_sub(r3, c3), 1.0f);
+
+        f32x4_store(result + 0, r0);
+        f32x4_store(result + 4, r1);
+        f32x4_store(result + 8, r2);
+        f32x4_store(result + 12, c3);
+}
+
+// Inverse of any matrix with a (0, 0, 0, 1) bottom row: the rows of the inverse 3x3 are the cross
+// products of its columns over the determinant, then the translation is rotated and negated
+inline void matrix_inverse_affine(float *result, const float *m0) {
+        f32x4 a = f32x4_xyz0(f32x4_load(m0 + 0));
+        f32x4 b = f32x4_xyz0(f32x4_load(m0 + 4));
+        f32x4 c = f32x4_xyz0(f32x4_load(m0 + 8));
+        f32x4 t = f32x4_load(m0 + 12);
+
+        f32x4 r0 = f32x4_cross3(b, c);
+        f32x4 inv_det = f32x4_splat(1.0f / f32x4_dot3(a, r0));
+        r0 = f32x4_mul(r0, inv_det);
+        f32x4 r1 = f32x4_mul(f32x4_cross3(c, a), inv_det);
+        f32x4 r2 = f32x4_mul(f32x4_cross3(a, b), inv_det);
+        f32x4 r3 = f32x4_splat(0.0f);
+        f32x4_transpose(&r0, &r1, &r2, &r3);
+
+        f32x4 c3 = f32x4_mul_lane(r0, t, 0);
+        c3 = f32x4_madd_lane(c3, r1, t, 1);
+        c3 = f32x4_madd_lane(c3, r2, t, 2);
+        c3 = f32x4_set_w(f32x4_sub(r3, c3), 1.0f);
+
+        f32x4_store(result + 0, r0);
+        f32x4_store(result + 4, r1);
+        f32x4_store(result + 8, r2);
+        f32x4_store(result + 12, c3);
+}
+
+// One column of m0 * m1, from the columns of m0 and a column b of m1
+inline f32x4 matrix_multiply_column(f32x4 a0, f32x4 a1, f32x4 a2, f32x4 a3, f32x4 b) {
+        f32x4 col = f32x4_mul_lane(a0, b, 0);
+        col = f32x4_madd_lane(col, a1, b, 1);
+        col = f32x4_madd_lane(col, a2, b, 2);
+        return f32x4_madd_lane(col, a3, b, 3);
+}
+
+// result = m0 * m1, result may alias either input
+inline void matrix_multiply(float *result, const float *m0, const float *m1) {
+        f32x4 a0 = f32x4_load(m0 + 0);
+        f32x4 a1 = f32x4_load(m0 + 4);
+        f32x4 a2 = f32x4_load(m0 + 8);
+        f32x4 a3 = f32x4_load(m0 + 12);
+
+        f32x4 b0 = f32x4_load(m1 + 0);
+        f32x4 b1 = f32x4_load(m1 + 4);
+        f32x4 b2 = f32x4_load(m1 + 8);
+        f32x4 b3 = f32x4_load(m1 + 12);
+
+        // Written out rather than looped over a temporary: GCC kept the loop and bounced every column
+        // through the stack, which made this slower than the scalar version
+        f32x4_store(result + 0, matrix_multiply_column(a0, a1, a2, a3, b0));
+        f32x4_store(result + 4, matrix_multiply_column(a0, a1, a2, a3, b1));
+        f32x4_store(result + 8, matrix_multiply_column(a0, a1, a2, a3, b2));
+        f32x4_store(result + 12, matrix_multiply_column(a0, a1, a2, a3, b3));
+}
+
+#endif
+
+// True if the bottom row is exactly (0, 0, 0, 1), i.e. no projective part
+inline bool matrix_is_affine(const float *m0) {
+        return m0[3] == 0.0f && m0[7] == 0.0f && m0[11] == 0.0f && m0[15] == 1.0f;
+}
+
+// Picks the cheapest inverse that is exact for m0. Use matrix_inverse_rigid directly when the
+// matrix is known to be rotation + translation only (e.g. built from an XrPosef).
+inline void matrix_inverse_auto(float *result, const float *m0) {
+        if (matrix_is_affine(m0)) {
+                matrix_inverse_affine(result, m0);
+        } else {
+                matrix_inverse(result, m0);
+        }
+}
+
+inline void matrix_proj_opengl(float *proj, float left, float right, float up, float down, float near, float far) {
+        assert(near < far);
+
+        const float tan_left = tan(left);
+        const float tan_right = tan(right);
+
+        const float tan_down = tan(down);
+        const float tan_up = tan(up);
+
+        const float tan_width = tan_right - tan_left;
+        const float tan_height = (tan_up - tan_down);
+
+        const float offset = near;
+
+        proj[0] = 2 / tan_width;
+        proj[4] = 0;
+        proj[8] = (tan_right + tan_left) / tan_width;
+        proj[12] = 0;
+
+        proj[1] = 0;
+        proj[5] = 2 / tan_height;
+        proj[9] = (tan_up + tan_down) / tan_height;
+        proj[13] = 0;
+
+        proj[2] = 0;
+        proj[6] = 0;
+        proj[10] = -(far + offset) / (far - near);
+        proj[14] = -(far * (near + offset)) / (far - near);
+
+        proj[3] = 0;
+        proj[7] = 0;
+        proj[11] = -1;
+        proj[15] = 0;
+}
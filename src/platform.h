@@ -0,0 +1,72 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// PLATFORM LAYER
+//
+// The little the app needs from the OS: an entry point, an EGL display and surface, the OpenXR
+// loader init, and an event loop to pump between frames. `src/platform_android.cpp` is the native
+// activity backend for the headset, `src/platform_linux.cpp` is a headless backend for running the
+// same renderer and frame loop on a desktop machine (with a desktop runtime or `src/xr_mock.cpp`).
+// Link exactly one of them.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <EGL/egl.h>
+
+// Pick the matching OpenXR platform, the host binds the session through XR_MNDX_egl_enable
+#ifdef __ANDROID__
+#define XR_USE_PLATFORM_ANDROID
+#include <jni.h>
+#else
+#define XR_USE_PLATFORM_EGL
+#endif
+
+#ifdef __ANDROID__
+struct android_app;
+#endif
+
+struct platform_t {
+#ifdef __ANDROID__
+        android_app *app;
+#else
+        int epoll_fd;
+        int signal_fd;
+        bool is_surfaceless;
+#endif
+        bool is_window_init;
+
+        // Set when the OS wants the app gone, the app should then ask the runtime to exit
+        bool is_quit_requested;
+
+        // Set while the OS has the app in the background (between pause and resume on Android), never
+        // on the host
+        bool is_paused;
+
+        // Snapshot handed to the OS when it asks to save state, registered by the app
+        void *save_state;
+        size_t save_state_size;
+};
+
+// Defined by the app, called by the platform's entry point once the platform is initialised
+int app_main(platform_t *platform, int argc, char **argv);
+
+// Blocks until the platform has somewhere to render (the native window on Android)
+void platform_wait_for_window(platform_t *platform);
+
+// The (uninitialised) EGL display, and the EGL_SURFACE_TYPE bits configs need for our surface
+EGLDisplay platform_get_egl_display(platform_t *platform);
+EGLint platform_get_egl_surface_type(platform_t *platform);
+
+// The surface to make current with the context, EGL_NO_SURFACE when rendering surfaceless
+EGLSurface platform_create_egl_surface(platform_t *platform, EGLDisplay display, EGLConfig config);
+
+// Anything the OpenXR loader needs before xrCreateInstance
+void platform_init_xr_loader(platform_t *platform);
+
+// A writable directory for output files like traces, app storage on Android, the working directory
+// on the host
+const char *platform_get_storage_path(platform_t *platform);
+
+// Handle pending OS events, waiting up to timeout_ms for the first one (0 never blocks, -1 blocks
+// until there is one)
+void platform_pump_events(platform_t *platform, int timeout_ms);
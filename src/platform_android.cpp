@@ -0,0 +1,131 @@
+// Android platform backend, see platform.h
+
+#include "android_native_app_glue.h"
+#include <jni.h>
+#include <android/native_activity.h>
+#include <android/log.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EGL/egl.h>
+
+#include "log.h"
+#include "platform.h"
+#define XR_USE_GRAPHICS_API_OPENGL_ES
+#include "openxr/openxr.h"
+#include "openxr/openxr_platform.h"
+
+// Callback handling android commands
+extern "C" void platform_android_handle_cmd(android_app *app, int32_t cmd) {
+        platform_t *p = (platform_t *)app->userData;
+
+        switch (cmd) {
+        case APP_CMD_DESTROY:
+                // Handle application shutdown
+                ANativeActivity_finish(app->activity);
+                p->is_quit_requested = true;
+                break;
+        case APP_CMD_INIT_WINDOW:
+                if (!p->is_window_init) {
+                        p->is_window_init = true;
+                        LOG_INFO( "Got start event\n" );
+                }
+                else {
+                        // TODO: Handle Resume
+                }
+                break;
+        case APP_CMD_TERM_WINDOW:
+                // Turns up when focus is lost
+                // Seems like the main loop just xrWaitFrame hitches
+        	break;
+        case APP_CMD_SAVE_STATE:
+                if (p->save_state) {
+                        LOG_INFO("Saving application state\n");
+                        app->savedState = malloc(p->save_state_size);
+                        memcpy(app->savedState, p->save_state, p->save_state_size);
+                        app->savedStateSize = p->save_state_size;
+                }
+                break;
+        case APP_CMD_PAUSE:
+                p->is_paused = true;
+                break;
+        case APP_CMD_RESUME:
+                p->is_paused = false;
+                // Nope, that doesn't work
+                // LOG_INFO("Resumed, loading state\n");
+                // memcpy(a, app->savedState, sizeof(app_t));
+                break;
+        default:
+                LOG_INFO("event not handled: %d\n", cmd);
+        }
+}
+
+// Blocks until the native window is ready, sleeping in the looper rather than spinning on it
+void platform_wait_for_window(platform_t *p) {
+        while (!p->is_window_init) {
+                platform_pump_events(p, -1);
+        }
+        LOG_INFO("Window Initialized\n");
+}
+
+EGLDisplay platform_get_egl_display(platform_t *p) {
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+EGLint platform_get_egl_surface_type(platform_t *p) {
+        return EGL_WINDOW_BIT;
+}
+
+// A window surface for the native window, OpenXR renders into its own swapchains but the context
+// still wants something current
+EGLSurface platform_create_egl_surface(platform_t *p, EGLDisplay display, EGLConfig config) {
+        assert(p->app->window);
+        int win_width = ANativeWindow_getWidth(p->app->window);
+        int win_height = ANativeWindow_getHeight(p->app->window);
+        LOG_INFO("Width/Height: %dx%d\n", win_width, win_height);
+        EGLint window_attribute_list[] = { EGL_NONE };
+        EGLSurface surface = eglCreateWindowSurface(display, config, p->app->window, window_attribute_list);
+        LOG_INFO("Got Surface: %p\n", surface);
+        assert(surface != EGL_NO_SURFACE);
+        return surface;
+}
+
+// The Android loader needs the JVM and activity before anything else
+void platform_init_xr_loader(platform_t *p) {
+        PFN_xrInitializeLoaderKHR loader_func;
+	XrResult result = xrGetInstanceProcAddr(XR_NULL_HANDLE, "xrInitializeLoaderKHR", (PFN_xrVoidFunction*)&loader_func);
+        assert(XR_SUCCEEDED(result));
+	XrLoaderInitInfoAndroidKHR init_data = { XR_TYPE_LOADER_INIT_INFO_ANDROID_KHR };
+	init_data.applicationVM = p->app->activity->vm;
+	init_data.applicationContext = p->app->activity->clazz;
+	result = loader_func((XrLoaderInitInfoBaseHeaderKHR*)&init_data);
+        assert(XR_SUCCEEDED(result));
+}
+
+const char *platform_get_storage_path(platform_t *p) {
+        return p->app->activity->internalDataPath;
+}
+
+// Pump the android event loop
+void platform_pump_events(platform_t *p, int timeout_ms) {
+        int events;
+        struct android_poll_source *source;
+        while (ALooper_pollAll(timeout_ms, 0, &events, (void **)&source) >= 0 ) {
+                if (source != NULL) {
+                        source->process(p->app, source );
+                }
+                timeout_ms = 0;
+        }
+}
+
+// Entrypoint called by the OS when using native activity
+extern "C" void android_main(android_app *app) {
+        platform_t p{};
+        p.app = app;
+        app->userData = &p;
+        app->onAppCmd = platform_android_handle_cmd;
+
+        app_main(&p, 0, NULL);
+}
@@ -0,0 +1,124 @@
+// Linux host platform backend, see platform.h
+//
+// There's no window, the context is made current surfaceless when the display supports it and
+// against a tiny pbuffer otherwise. Events come through an epoll loop, for now just SIGINT and
+// SIGTERM through a signalfd so ctrl-c ends the session cleanly instead of killing the process.
+
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "log.h"
+#include "platform.h"
+
+#define PLATFORM_MAX_EVENTS (8)
+
+static bool platform_has_egl_extension(EGLDisplay display, const char *name) {
+        const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+        if (!extensions) { return false; }
+        size_t length = strlen(name);
+        for (const char *s = strstr(extensions, name); s; s = strstr(s + length, name)) {
+                if ((s == extensions || s[-1] == ' ') && (s[length] == ' ' || s[length] == '\0')) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+// Nothing to wait for, there's no window
+void platform_wait_for_window(platform_t *p) {
+        p->is_window_init = true;
+}
+
+// Mesa's surfaceless platform needs no X or Wayland, otherwise whatever the default display is
+EGLDisplay platform_get_egl_display(platform_t *p) {
+        if (platform_has_egl_extension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+                PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+                if (get_platform_display) {
+                        LOG_INFO("EGL Platform: surfaceless\n");
+                        return get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+                }
+        }
+        LOG_INFO("EGL Platform: default\n");
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+EGLint platform_get_egl_surface_type(platform_t *p) {
+        return EGL_PBUFFER_BIT;
+}
+
+// No surface at all with EGL_KHR_surfaceless_context, otherwise a 16x16 pbuffer that never gets
+// drawn to, OpenXR renders into its own swapchains
+EGLSurface platform_create_egl_surface(platform_t *p, EGLDisplay display, EGLConfig config) {
+        p->is_surfaceless = platform_has_egl_extension(display, "EGL_KHR_surfaceless_context");
+        if (p->is_surfaceless) {
+                LOG_INFO("Surface: none (surfaceless)\n");
+                return EGL_NO_SURFACE;
+        }
+        EGLint pbuffer_attribute_list[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+        EGLSurface surface = eglCreatePbufferSurface(display, config, pbuffer_attribute_list);
+        LOG_INFO("Got Surface: %p (pbuffer)\n", surface);
+        assert(surface != EGL_NO_SURFACE);
+        return surface;
+}
+
+// Desktop loaders find the runtime through the active_runtime.json, nothing to do
+void platform_init_xr_loader(platform_t *p) {
+}
+
+const char *platform_get_storage_path(platform_t *p) {
+        return ".";
+}
+
+// Wait on the epoll set and handle whatever is ready
+void platform_pump_events(platform_t *p, int timeout_ms) {
+        struct epoll_event events[PLATFORM_MAX_EVENTS];
+        int event_count;
+        while ((event_count = epoll_wait(p->epoll_fd, events, PLATFORM_MAX_EVENTS, timeout_ms)) > 0) {
+                for (int i = 0; i < event_count; i++) {
+                        if (events[i].data.fd == p->signal_fd) {
+                                struct signalfd_siginfo info;
+                                while (read(p->signal_fd, &info, sizeof(info)) == sizeof(info)) {
+                                        LOG_INFO("Got signal %d, quitting\n", (int)info.ssi_signo);
+                                        p->is_quit_requested = true;
+                                }
+                        }
+                }
+                timeout_ms = 0;
+        }
+}
+
+// Host entrypoint, sets up the event loop and hands over to the app
+int main(int argc, char **argv) {
+        platform_t p{};
+
+        // Route SIGINT/SIGTERM into the event loop instead of their default handlers
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        int mask_result = sigprocmask(SIG_BLOCK, &signals, NULL);
+        assert(mask_result == 0);
+        p.signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        assert(p.signal_fd >= 0);
+
+        p.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        assert(p.epoll_fd >= 0);
+        struct epoll_event signal_event = {};
+        signal_event.events = EPOLLIN;
+        signal_event.data.fd = p.signal_fd;
+        int ctl_result = epoll_ctl(p.epoll_fd, EPOLL_CTL_ADD, p.signal_fd, &signal_event);
+        assert(ctl_result == 0);
+
+        int result = app_main(&p, argc, argv);
+
+        close(p.epoll_fd);
+        close(p.signal_fd);
+        return result;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// POSE CACHE
+//
+// Every tracked space (controllers now, trackers, anchors and props later) is registered once, then
+// the whole set is located against one base space with a single XR_KHR_locate_spaces call per
+// frame, or one xrLocateSpace per space when the runtime doesn't have the extension. The results
+// land in a structure of arrays laid out for matrix_model_from_poses_soa, so the transform stage
+// reads them straight out of the cache.
+//
+// A pose keeps its last valid orientation and position when tracking drops out, the flags say
+// what the runtime actually reported. The poses from the locate before are kept alongside, which
+// is what motion vectors for XR_FB_space_warp are built from.
+//
+// A pose_cache_t belongs to one thread, threads that locate the same spaces keep their own.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <string.h>
+
+#include "openxr/openxr.h"
+#include "matrix.h"
+#include "xr_locate_spaces.h"
+
+#define POSE_CACHE_MAX_SPACES (64) // Must be a multiple of 4, rows are loaded four lanes at a time
+
+struct pose_cache_t {
+        XrSession session;
+        XrSpace base_space;
+        PFN_xrLocateSpacesKHR locate_spaces; // NULL falls back to xrLocateSpace per space
+
+        int count;
+        XrSpace spaces[POSE_CACHE_MAX_SPACES];
+
+        // Results of the last locate, MATRIX_POSE_COMPONENTS rows of POSE_CACHE_MAX_SPACES, and the
+        // poses from the one before
+        XrTime time;
+        alignas(16) float poses[MATRIX_POSE_COMPONENTS][POSE_CACHE_MAX_SPACES];
+        alignas(16) float previous_poses[MATRIX_POSE_COMPONENTS][POSE_CACHE_MAX_SPACES];
+        XrSpaceLocationFlags flags[POSE_CACHE_MAX_SPACES];
+
+        // Where the runtime writes, in its array of structs layout
+        XrSpaceLocationDataKHR locations[POSE_CACHE_MAX_SPACES];
+};
+
+// locate_spaces is xrLocateSpacesKHR from xrGetInstanceProcAddr, or NULL without the extension
+inline void pose_cache_init(pose_cache_t *cache, XrSession session, XrSpace base_space, PFN_xrLocateSpacesKHR locate_spaces) {
+        memset(cache, 0, sizeof(*cache));
+        cache->session = session;
+        cache->base_space = base_space;
+        cache->locate_spaces = locate_spaces;
+        for (int i = 0; i < POSE_CACHE_MAX_SPACES; i++) {
+                cache->poses[MATRIX_POSE_QW][i] = 1.0f;
+                cache->previous_poses[MATRIX_POSE_QW][i] = 1.0f;
+        }
+}
+
+// Add a space to locate every frame, returns its index into the results
+inline int pose_cache_add(pose_cache_t *cache, XrSpace space) {
+        assert(cache->count < POSE_CACHE_MAX_SPACES);
+        cache->spaces[cache->count] = space;
+        return cache->count++;
+}
+
+// Locate every registered space at time. Spaces the runtime couldn't locate keep their last pose.
+inline XrResult pose_cache_locate(pose_cache_t *cache, XrTime time) {
+        XrResult result = XR_SUCCESS;
+        int count = cache->count;
+        if (cache->locate_spaces) {
+                XrSpacesLocateInfoKHR info = { XR_TYPE_SPACES_LOCATE_INFO_KHR };
+                info.baseSpace = cache->base_space;
+                info.time = time;
+                info.spaceCount = count;
+                info.spaces = cache->spaces;
+                XrSpaceLocationsKHR locations = { XR_TYPE_SPACE_LOCATIONS_KHR };
+                locations.locationCount = count;
+                locations.locations = cache->locations;
+                result = cache->locate_spaces(cache->session, &info, &locations);
+                if (XR_FAILED(result)) { return result; }
+        } else {
+                // Carry on past a failure so the other spaces still update, and report it at the end
+                for (int i = 0; i < count; i++) {
+                        XrSpaceLocation location = { XR_TYPE_SPACE_LOCATION };
+                        XrResult space_result = xrLocateSpace(cache->spaces[i], cache->base_space, time, &location);
+                        if (XR_FAILED(space_result)) {
+                                result = space_result;
+                                location.locationFlags = 0;
+                        }
+                        cache->locations[i].locationFlags = location.locationFlags;
+                        cache->locations[i].pose = location.pose;
+                }
+        }
+
+        // Scatter into the rows, a component only overwrites the last one if it's valid
+        memcpy(cache->previous_poses, cache->poses, sizeof(cache->poses));
+        cache->time = time;
+        for (int i = 0; i < count; i++) {
+                const XrSpaceLocationDataKHR *l = &cache->locations[i];
+                cache->flags[i] = l->locationFlags;
+                if (l->locationFlags & XR_SPACE_LOCATION_ORIENTATION_VALID_BIT) {
+                        cache->poses[MATRIX_POSE_QX][i] = l->pose.orientation.x;
+                        cache->poses[MATRIX_POSE_QY][i] = l->pose.orientation.y;
+                        cache->poses[MATRIX_POSE_QZ][i] = l->pose.orientation.z;
+                        cache->poses[MATRIX_POSE_QW][i] = l->pose.orientation.w;
+                }
+                if (l->locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT) {
+                        cache->poses[MATRIX_POSE_PX][i] = l->pose.position.x;
+                        cache->poses[MATRIX_POSE_PY][i] = l->pose.position.y;
+                        cache->poses[MATRIX_POSE_PZ][i] = l->pose.position.z;
+                }
+        }
+        return result;
+}
+
+// Both orientation and position were valid at the last locate
+inline bool pose_cache_is_valid(const pose_cache_t *cache, int index) {
+        const XrSpaceLocationFlags valid = XR_SPACE_LOCATION_ORIENTATION_VALID_BIT | XR_SPACE_LOCATION_POSITION_VALID_BIT;
+        return (cache->flags[index] & valid) == valid;
+}
+
+// The pose and flags of one space, as xrLocateSpace would have returned them (bar the held poses)
+inline void pose_cache_get_location(const pose_cache_t *cache, int index, XrSpaceLocation *location) {
+        location->locationFlags = cache->flags[index];
+        matrix_pose_from_soa(&location->pose, &cache->poses[0][0], POSE_CACHE_MAX_SPACES, index);
+}
+
+// Overwrite one space's results with a location from elsewhere (e.g. a replayed log), as if the
+// last locate had returned it
+inline void pose_cache_set_location(pose_cache_t *cache, int index, const XrSpaceLocation *location) {
+        const XrPosef *pose = &location->pose;
+        cache->flags[index] = location->locationFlags;
+        cache->poses[MATRIX_POSE_QX][index] = pose->orientation.x;
+        cache->poses[MATRIX_POSE_QY][index] = pose->orientation.y;
+        cache->poses[MATRIX_POSE_QZ][index] = pose->orientation.z;
+        cache->poses[MATRIX_POSE_QW][index] = pose->orientation.w;
+        cache->poses[MATRIX_POSE_PX][index] = pose->position.x;
+        cache->poses[MATRIX_POSE_PY][index] = pose->position.y;
+        cache->poses[MATRIX_POSE_PZ][index] = pose->position.z;
+}
+
+// Model matrices of the spaces [begin, end), results is (end - begin) * 16 floats
+inline void pose_cache_models(const pose_cache_t *cache, float *results, int begin, int end) {
+        matrix_model_from_poses_soa(results, &cache->poses[0][begin], POSE_CACHE_MAX_SPACES, end - begin);
+}
@@ -0,0 +1,115 @@
+// Program binary cache, see program_cache.h
+
+#include "program_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLES3/gl3.h>
+
+#include "log.h"
+
+uint64_t program_cache_hash(uint64_t hash, const void *data, size_t size) {
+        const unsigned char *bytes = (const unsigned char *)data;
+        for (size_t i = 0; i < size; i++) {
+                hash ^= bytes[i];
+                hash *= 0x100000001b3ull;
+        }
+        return hash;
+}
+
+uint64_t program_cache_hash_string(uint64_t hash, const char *string) {
+        uint64_t length = strlen(string);
+        hash = program_cache_hash(hash, &length, sizeof(length));
+        return program_cache_hash(hash, string, length);
+}
+
+uint64_t program_cache_driver_hash() {
+        uint64_t hash = PROGRAM_CACHE_HASH_SEED;
+        const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+        for (GLenum name : names) {
+                const char *string = (const char *)glGetString(name);
+                hash = program_cache_hash_string(hash, string ? string : "");
+        }
+        return hash;
+}
+
+bool program_cache_is_supported() {
+        GLint format_count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+        return format_count > 0;
+}
+
+uint32_t program_cache_load(const char *path, uint64_t key) {
+        FILE *file = fopen(path, "rb");
+        if (!file) { return 0; }
+
+        program_cache_header_t header;
+        void *binary = NULL;
+        bool is_valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                        header.magic == PROGRAM_CACHE_MAGIC && header.version == PROGRAM_CACHE_VERSION &&
+                        header.key == key && header.size > 0 && header.size <= PROGRAM_CACHE_MAX_BINARY;
+        if (is_valid) {
+                binary = malloc(header.size);
+                is_valid = binary && fread(binary, 1, header.size, file) == header.size &&
+                           program_cache_hash(PROGRAM_CACHE_HASH_SEED, binary, header.size) == header.binary_hash;
+        }
+        fclose(file);
+        if (!is_valid) {
+                free(binary);
+                return 0;
+        }
+
+        // The driver may still refuse it (e.g. an update that kept the version string), which shows
+        // as a failed link
+        uint32_t program = glCreateProgram();
+        glProgramBinary(program, header.format, binary, (GLsizei)header.size);
+        free(binary);
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+                LOG_WARN("Program cache: %s rejected by the driver\n", path);
+                glDeleteProgram(program);
+                return 0;
+        }
+        return program;
+}
+
+bool program_cache_store(const char *path, uint64_t key, uint32_t program) {
+        GLint size = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+        if (size <= 0 || size > PROGRAM_CACHE_MAX_BINARY) { return false; }
+
+        void *binary = malloc(size);
+        if (!binary) { return false; }
+        GLsizei length = 0;
+        GLenum format = 0;
+        glGetProgramBinary(program, size, &length, &format, binary);
+        if (length <= 0) {
+                free(binary);
+                return false;
+        }
+
+        // Write beside the old file and rename over it, so a crash part way leaves the old one or
+        // nothing rather than half a binary
+        char temp_path[512];
+        snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+        FILE *file = fopen(temp_path, "wb");
+        if (!file) {
+                free(binary);
+                return false;
+        }
+        program_cache_header_t header = {
+                PROGRAM_CACHE_MAGIC, PROGRAM_CACHE_VERSION, key, format, (uint32_t)length,
+                program_cache_hash(PROGRAM_CACHE_HASH_SEED, binary, length),
+        };
+        bool is_written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                          fwrite(binary, 1, length, file) == (size_t)length;
+        is_written = fclose(file) == 0 && is_written;
+        free(binary);
+        if (!is_written || rename(temp_path, path) != 0) {
+                remove(temp_path);
+                return false;
+        }
+        return true;
+}
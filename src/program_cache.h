@@ -0,0 +1,52 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// PROGRAM CACHE
+//
+// Linked GL programs saved with glGetProgramBinary to app storage, one file per program, and loaded
+// with glProgramBinary on later launches instead of compiling and linking their GLSL again.
+//
+// Each file is a program_cache_header_t then the driver's binary. The header carries the key the
+// program was built for, a hash of every source string that went into it and the GL renderer and
+// version strings, so editing a shader or a driver update misses rather than loading something
+// stale. A short or corrupt file (checked with a hash of the binary) or one the driver rejects is a
+// miss too. After a miss the caller compiles from source and stores the result over the old file.
+//
+// Needs a current context, and a driver that reports at least one program binary format.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PROGRAM_CACHE_MAGIC (0x50435851u) // "QXCP"
+#define PROGRAM_CACHE_VERSION (1)
+#define PROGRAM_CACHE_MAX_BINARY (4 << 20)
+
+struct program_cache_header_t {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t format;      // The driver's binary format, from glGetProgramBinary
+        uint32_t size;        // Bytes of binary after the header
+        uint64_t binary_hash;
+};
+
+// 64 bit FNV-1a, chain calls by passing the last result as hash, starting from PROGRAM_CACHE_HASH_SEED
+#define PROGRAM_CACHE_HASH_SEED (0xcbf29ce484222325ull)
+uint64_t program_cache_hash(uint64_t hash, const void *data, size_t size);
+
+// Hash a NUL terminated string along with its length, so adjacent strings can't run together
+uint64_t program_cache_hash_string(uint64_t hash, const char *string);
+
+// Hash of the GL renderer and version strings, to mix into every key
+uint64_t program_cache_driver_hash();
+
+// Whether the driver can hand back program binaries at all
+bool program_cache_is_supported();
+
+// A new program loaded from the file at path if it was built for key, otherwise 0
+uint32_t program_cache_load(const char *path, uint64_t key);
+
+// Save a linked program's binary to path for key. Link it with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+// set, or some drivers won't hand the binary back. Returns false if nothing was written.
+bool program_cache_store(const char *path, uint64_t key, uint32_t program);
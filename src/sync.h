@@ -0,0 +1,34 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// THREAD SYNC
+//
+// Sleeping on a 32 bit atomic with Linux futexes (which Android has too), for the lock free queues
+// between threads. The data never goes through a lock, a thread only sleeps here when the other
+// side hasn't caught up yet, and the other side wakes it after publishing.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <limits.h>
+#include <stdint.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32 bit word");
+
+// Sleep while *word == expected, returns straight away if it's already changed. Can wake spuriously,
+// so always re-check in a loop.
+inline void sync_wait(std::atomic<uint32_t> *word, uint32_t expected) {
+        syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+// Wake every thread sleeping on word
+inline void sync_wake(std::atomic<uint32_t> *word) {
+        syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+// Wake at most one thread sleeping on word, for when any one of them can handle what changed
+inline void sync_wake_one(std::atomic<uint32_t> *word) {
+        syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
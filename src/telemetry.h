@@ -0,0 +1,203 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// FRAME TELEMETRY
+//
+// Per stage CPU timings for the frame loop. Each stage is timed with a pair of monotonic clock
+// reads, summed per frame (a stage can run more than once, e.g. per eye), or has durations measured
+// elsewhere (e.g. GPU timer queries) added to it. The per frame totals
+// go into a preallocated ring buffer covering the last TELEMETRY_RING_LENGTH frames. Every stage
+// also keeps a log-linear histogram of that same window, updated as samples enter and leave the
+// ring, so p50/p95/p99 come from a bucket scan rather than a sort. A summary is printed every
+// TELEMETRY_REPORT_PERIOD_NS, alongside a set of plain event counters.
+//
+// A telemetry_t belongs to one thread, each thread that times stages keeps its own.
+//
+// Build with -DENABLE_TELEMETRY=0 and every call below compiles to nothing.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ENABLE_TELEMETRY
+#define ENABLE_TELEMETRY 1
+#endif
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "log.h"
+
+#define TELEMETRY_MAX_STAGES (16)
+#define TELEMETRY_MAX_COUNTERS (8)
+#define TELEMETRY_RING_LENGTH (512)
+#define TELEMETRY_REPORT_PERIOD_NS (5000000000ll)
+
+// Histogram buckets, 8 linear buckets per power of two of nanoseconds, so every bucket is within
+// 12.5% of its neighbours. 256 buckets reach past 8 seconds, anything longer goes in the last one.
+#define TELEMETRY_SUB_BUCKET_BITS (3)
+#define TELEMETRY_SUB_BUCKETS (1 << TELEMETRY_SUB_BUCKET_BITS)
+#define TELEMETRY_BUCKET_COUNT (256)
+
+struct telemetry_t {
+        const char *name;
+        const char *const *stage_names;
+        int stage_count;
+        const char *const *counter_names;
+        int counter_count;
+
+        // The frame being recorded
+        int64_t stage_starts[TELEMETRY_MAX_STAGES];
+        int64_t frame_stages[TELEMETRY_MAX_STAGES];
+
+        // Rolling window, the ring holds per frame stage totals and the histograms mirror it
+        int64_t ring[TELEMETRY_RING_LENGTH][TELEMETRY_MAX_STAGES];
+        int ring_head;
+        int ring_fill;
+        uint16_t histograms[TELEMETRY_MAX_STAGES][TELEMETRY_BUCKET_COUNT];
+
+        // Totals since init
+        int64_t frame_count;
+        int64_t counters[TELEMETRY_MAX_COUNTERS];
+        int64_t last_report_time;
+};
+
+inline int64_t telemetry_now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+inline int telemetry_bucket(int64_t ns) {
+        uint64_t v = ns > 0 ? (uint64_t)ns : 0;
+        if (v < TELEMETRY_SUB_BUCKETS) { return (int)v; }
+        int octave = 63 - __builtin_clzll(v);
+        int sub = (int)(v >> (octave - TELEMETRY_SUB_BUCKET_BITS)) & (TELEMETRY_SUB_BUCKETS - 1);
+        int bucket = (octave - TELEMETRY_SUB_BUCKET_BITS + 1) * TELEMETRY_SUB_BUCKETS + sub;
+        return bucket < TELEMETRY_BUCKET_COUNT ? bucket : TELEMETRY_BUCKET_COUNT - 1;
+}
+
+// Midpoint of a bucket in nanoseconds
+inline int64_t telemetry_bucket_value(int bucket) {
+        if (bucket < TELEMETRY_SUB_BUCKETS) { return bucket; }
+        int octave = bucket / TELEMETRY_SUB_BUCKETS + TELEMETRY_SUB_BUCKET_BITS - 1;
+        int sub = bucket % TELEMETRY_SUB_BUCKETS;
+        int shift = octave - TELEMETRY_SUB_BUCKET_BITS;
+        return ((int64_t)(TELEMETRY_SUB_BUCKETS + sub) << shift) + ((1ll << shift) >> 1);
+}
+
+// Percentile (0-100) of a stage over the rolling window
+inline int64_t telemetry_percentile(const telemetry_t *t, int stage, int percent) {
+        int rank = (percent * t->ring_fill + 99) / 100;
+        int seen = 0;
+        for (int b = 0; b < TELEMETRY_BUCKET_COUNT; b++) {
+                seen += t->histograms[stage][b];
+                if (seen >= rank && seen > 0) { return telemetry_bucket_value(b); }
+        }
+        return 0;
+}
+
+inline void telemetry_init(telemetry_t *t, const char *name, const char *const *stage_names, int stage_count, const char *const *counter_names, int counter_count) {
+        memset(t, 0, sizeof(*t));
+        t->name = name;
+        t->stage_names = stage_names;
+        t->stage_count = stage_count < TELEMETRY_MAX_STAGES ? stage_count : TELEMETRY_MAX_STAGES;
+        t->counter_names = counter_names;
+        t->counter_count = counter_count < TELEMETRY_MAX_COUNTERS ? counter_count : TELEMETRY_MAX_COUNTERS;
+        t->last_report_time = telemetry_now();
+}
+
+inline void telemetry_stage_begin(telemetry_t *t, int stage) {
+#if ENABLE_TELEMETRY
+        t->stage_starts[stage] = telemetry_now();
+#endif
+}
+
+inline void telemetry_stage_end(telemetry_t *t, int stage) {
+#if ENABLE_TELEMETRY
+        t->frame_stages[stage] += telemetry_now() - t->stage_starts[stage];
+#endif
+}
+
+// Add a duration measured some other way (e.g. on the GPU) to a stage of the current frame
+inline void telemetry_stage_add(telemetry_t *t, int stage, int64_t ns) {
+#if ENABLE_TELEMETRY
+        t->frame_stages[stage] += ns;
+#endif
+}
+
+inline void telemetry_count(telemetry_t *t, int counter) {
+#if ENABLE_TELEMETRY
+        t->counters[counter]++;
+#endif
+}
+
+inline void telemetry_count_add(telemetry_t *t, int counter, int64_t n) {
+#if ENABLE_TELEMETRY
+        t->counters[counter] += n;
+#endif
+}
+
+// Append to a report being built in text, dropping whatever doesn't fit
+inline void telemetry_append(char *text, int size, int *length, const char *format, ...) __attribute__((format(printf, 4, 5)));
+inline void telemetry_append(char *text, int size, int *length, const char *format, ...) {
+        if (*length >= size - 1) { return; }
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(text + *length, size - *length, format, args);
+        va_end(args);
+        if (written > 0) { *length += written < size - *length ? written : size - 1 - *length; }
+}
+
+// Print the rolling percentiles of every stage and the counters. The block is built up here and
+// logged as one message, so it stays in one piece even if another thread reports at the same time.
+inline void telemetry_report(const telemetry_t *t) {
+#if ENABLE_TELEMETRY
+        char text[2048];
+        int length = 0;
+        text[0] = '\0';
+        telemetry_append(text, sizeof(text), &length, "Frame telemetry (%s), last %d of %lld frames:\n", t->name, t->ring_fill, (long long)t->frame_count);
+        telemetry_append(text, sizeof(text), &length, "        %-20s %9s %9s %9s\n", "stage", "p50 ms", "p95 ms", "p99 ms");
+        for (int s = 0; s < t->stage_count; s++) {
+                telemetry_append(text, sizeof(text), &length, "        %-20s %9.3f %9.3f %9.3f\n", t->stage_names[s],
+                        telemetry_percentile(t, s, 50) * 1e-6,
+                        telemetry_percentile(t, s, 95) * 1e-6,
+                        telemetry_percentile(t, s, 99) * 1e-6);
+        }
+        for (int c = 0; c < t->counter_count; c++) {
+                telemetry_append(text, sizeof(text), &length, "        %-20s %9lld\n", t->counter_names[c], (long long)t->counters[c]);
+        }
+        LOG_INFO("%s", text);
+#endif
+}
+
+// Drop the frame's stage totals without committing them, for a frame that didn't happen
+inline void telemetry_discard_frame(telemetry_t *t) {
+#if ENABLE_TELEMETRY
+        memset(t->frame_stages, 0, sizeof(t->frame_stages));
+#endif
+}
+
+// Commit the frame's stage totals to the ring, and report if it's been long enough
+inline void telemetry_end_frame(telemetry_t *t) {
+#if ENABLE_TELEMETRY
+        int64_t *slot = t->ring[t->ring_head];
+        for (int s = 0; s < t->stage_count; s++) {
+                if (t->ring_fill == TELEMETRY_RING_LENGTH) {
+                        t->histograms[s][telemetry_bucket(slot[s])]--;
+                }
+                slot[s] = t->frame_stages[s];
+                t->histograms[s][telemetry_bucket(slot[s])]++;
+                t->frame_stages[s] = 0;
+        }
+        t->ring_head = (t->ring_head + 1) % TELEMETRY_RING_LENGTH;
+        if (t->ring_fill < TELEMETRY_RING_LENGTH) { t->ring_fill++; }
+        t->frame_count++;
+
+        int64_t now = telemetry_now();
+        if (now - t->last_report_time >= TELEMETRY_REPORT_PERIOD_NS) {
+                t->last_report_time = now;
+                telemetry_report(t);
+        }
+#endif
+}
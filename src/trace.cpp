@@ -0,0 +1,114 @@
+// Frame tracing, see trace.h
+
+#include "trace.h"
+
+#if ENABLE_TRACE
+
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "log.h"
+
+struct trace_event_t {
+        const char *name;
+        int64_t begin_ns;
+        int64_t end_ns;
+        int64_t display_time;
+};
+
+struct trace_buffer_t {
+        trace_buffer_t *next;
+        const char *thread_name;
+        int thread_id;
+
+        // Only the owning thread writes, the count is published after the event so a reader
+        // never sees a half written one (short of the buffer wrapping under it)
+        std::atomic<uint64_t> event_count;
+        trace_event_t events[TRACE_BUFFER_EVENTS];
+};
+
+static std::atomic<trace_buffer_t *> trace_buffers(nullptr);
+static thread_local trace_buffer_t *trace_thread_buffer = nullptr;
+
+static trace_buffer_t *trace_get_thread_buffer() {
+        trace_buffer_t *buffer = trace_thread_buffer;
+        if (buffer) { return buffer; }
+
+        buffer = (trace_buffer_t *)calloc(1, sizeof(trace_buffer_t));
+        if (!buffer) { return NULL; }
+        buffer->thread_id = (int)syscall(SYS_gettid);
+        buffer->thread_name = NULL;
+        buffer->event_count.store(0, std::memory_order_relaxed);
+
+        // Lock free push onto the global list, buffers live until the process exits
+        trace_buffer_t *head = trace_buffers.load(std::memory_order_relaxed);
+        do {
+                buffer->next = head;
+        } while (!trace_buffers.compare_exchange_weak(head, buffer, std::memory_order_release, std::memory_order_relaxed));
+
+        trace_thread_buffer = buffer;
+        return buffer;
+}
+
+void trace_set_thread_name(const char *name) {
+        trace_buffer_t *buffer = trace_get_thread_buffer();
+        if (buffer) { buffer->thread_name = name; }
+}
+
+void trace_record(const trace_scope_t *scope, int64_t end_ns) {
+        trace_buffer_t *buffer = trace_get_thread_buffer();
+        if (!buffer) { return; }
+        uint64_t count = buffer->event_count.load(std::memory_order_relaxed);
+        trace_event_t *event = &buffer->events[count % TRACE_BUFFER_EVENTS];
+        event->name = scope->name;
+        event->begin_ns = scope->begin_ns;
+        event->end_ns = end_ns;
+        event->display_time = scope->display_time;
+        buffer->event_count.store(count + 1, std::memory_order_release);
+}
+
+bool trace_write(const char *path, const char *process_name) {
+        FILE *file = fopen(path, "w");
+        if (!file) {
+                LOG_ERROR("Trace: couldn't open %s\n", path);
+                return false;
+        }
+
+        // Timestamps are microseconds relative to the earliest event, so they stay readable
+        int64_t origin = INT64_MAX;
+        for (trace_buffer_t *b = trace_buffers.load(std::memory_order_acquire); b; b = b->next) {
+                uint64_t count = b->event_count.load(std::memory_order_acquire);
+                uint64_t first = count > TRACE_BUFFER_EVENTS ? count - TRACE_BUFFER_EVENTS : 0;
+                for (uint64_t i = first; i < count; i++) {
+                        int64_t begin = b->events[i % TRACE_BUFFER_EVENTS].begin_ns;
+                        if (begin < origin) { origin = begin; }
+                }
+        }
+
+        int event_total = 0;
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"%s\"}}", process_name);
+        for (trace_buffer_t *b = trace_buffers.load(std::memory_order_acquire); b; b = b->next) {
+                if (b->thread_name) {
+                        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", b->thread_id, b->thread_name);
+                }
+                uint64_t count = b->event_count.load(std::memory_order_acquire);
+                uint64_t first = count > TRACE_BUFFER_EVENTS ? count - TRACE_BUFFER_EVENTS : 0;
+                for (uint64_t i = first; i < count; i++) {
+                        const trace_event_t *e = &b->events[i % TRACE_BUFFER_EVENTS];
+                        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"predictedDisplayTime\":%lld}}",
+                                e->name, b->thread_id, (e->begin_ns - origin) * 1e-3, (e->end_ns - e->begin_ns) * 1e-3, (long long)e->display_time);
+                        event_total++;
+                }
+        }
+        fprintf(file, "\n]}\n");
+        fclose(file);
+        LOG_INFO("Trace: wrote %d events to %s\n", event_total, path);
+        return true;
+}
+
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// FRAME TRACING
+//
+// Records begin/end scopes of the frame loop and writes them out as Chrome trace event JSON, which
+// opens in https://ui.perfetto.dev (or chrome://tracing) to see individual bad frames in context.
+// Every scope carries the predictedDisplayTime of the frame it belongs to.
+//
+// Each thread records into its own fixed size buffer, allocated on its first scope and linked into
+// a global list with a single compare and swap, so recording never takes a lock or allocates. A
+// full buffer wraps and keeps the most recent TRACE_BUFFER_EVENTS scopes. trace_write reads every
+// buffer, so call it once the recording threads are done (e.g. at shutdown).
+//
+// Build with -DENABLE_TRACE=1 to record, otherwise every call compiles to nothing.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ENABLE_TRACE
+#define ENABLE_TRACE 0
+#endif
+
+#include <stdint.h>
+#include <time.h>
+
+#define TRACE_BUFFER_EVENTS (1 << 16)
+
+struct trace_scope_t {
+        const char *name;
+        int64_t begin_ns;
+        int64_t display_time;
+};
+
+#if ENABLE_TRACE
+
+// Name the calling thread in the trace, the name must outlive the trace
+void trace_set_thread_name(const char *name);
+
+// Record a finished scope into the calling thread's buffer
+void trace_record(const trace_scope_t *scope, int64_t end_ns);
+
+// Write every thread's scopes to path as Chrome trace event JSON, returns false if it can't
+bool trace_write(const char *path, const char *process_name);
+
+inline int64_t trace_now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// The name must be a string literal (or otherwise outlive the trace), only the pointer is kept
+inline trace_scope_t trace_begin(const char *name, int64_t display_time) {
+        trace_scope_t scope = { name, trace_now(), display_time };
+        return scope;
+}
+
+inline void trace_end(const trace_scope_t *scope) {
+        trace_record(scope, trace_now());
+}
+
+#else
+
+inline void trace_set_thread_name(const char *name) {}
+inline bool trace_write(const char *path, const char *process_name) { return false; }
+inline trace_scope_t trace_begin(const char *name, int64_t display_time) { return trace_scope_t{}; }
+inline void trace_end(const trace_scope_t *scope) {}
+
+#endif
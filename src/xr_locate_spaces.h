@@ -0,0 +1,43 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// XR_KHR_LOCATE_SPACES
+//
+// Locates any number of spaces against one base space in a single call. The vendored OpenXR
+// headers (1.0.27) predate the extension, so the parts of it we use are declared here, matching the
+// registry. Once the headers are updated the #ifndef turns this file into a no-op.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "openxr/openxr.h"
+
+#ifndef XR_KHR_locate_spaces
+#define XR_KHR_locate_spaces 1
+#define XR_KHR_locate_spaces_SPEC_VERSION 1
+#define XR_KHR_LOCATE_SPACES_EXTENSION_NAME "XR_KHR_locate_spaces"
+
+#define XR_TYPE_SPACES_LOCATE_INFO_KHR ((XrStructureType)1000471000)
+#define XR_TYPE_SPACE_LOCATIONS_KHR ((XrStructureType)1000471001)
+
+typedef struct XrSpacesLocateInfoKHR {
+        XrStructureType type;
+        const void *XR_MAY_ALIAS next;
+        XrSpace baseSpace;
+        XrTime time;
+        uint32_t spaceCount;
+        const XrSpace *spaces;
+} XrSpacesLocateInfoKHR;
+
+typedef struct XrSpaceLocationDataKHR {
+        XrSpaceLocationFlags locationFlags;
+        XrPosef pose;
+} XrSpaceLocationDataKHR;
+
+typedef struct XrSpaceLocationsKHR {
+        XrStructureType type;
+        void *XR_MAY_ALIAS next;
+        uint32_t locationCount;
+        XrSpaceLocationDataKHR *locations;
+} XrSpaceLocationsKHR;
+
+typedef XrResult (XRAPI_PTR *PFN_xrLocateSpacesKHR)(XrSession session, const XrSpacesLocateInfoKHR *locateInfo, XrSpaceLocationsKHR *spaceLocations);
+#endif
@@ -0,0 +1,802 @@
+// Mock OpenXR runtime, see xr_mock.h
+
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+
+#define XR_USE_PLATFORM_EGL
+#define XR_USE_GRAPHICS_API_OPENGL_ES
+#include "openxr/openxr.h"
+#include "openxr/openxr_platform.h"
+
+#include "xr_locate_spaces.h"
+#include "xr_mock.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// MOCK STATE
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define MOCK_VIEW_COUNT (2)
+#define MOCK_SWAPCHAIN_LENGTH (3)
+#define MOCK_MAX_PATHS (64)
+#define MOCK_MAX_ACTIONS (16)
+#define MOCK_MAX_SPACES (16)
+#define MOCK_MAX_SWAPCHAINS (8)
+#define MOCK_IPD (0.064f)
+
+// Handles are just 1 based indices into the arrays below, the instance, session and action set are
+// singletons so always handle 1
+#define MOCK_HANDLE(type, index) ((type)(uintptr_t)((index) + 1))
+#define MOCK_INDEX(handle) ((int)((uintptr_t)(handle) - 1))
+
+enum mock_space_kind_t {
+        MOCK_SPACE_REFERENCE,
+        MOCK_SPACE_ACTION,
+};
+
+struct mock_space_t {
+        mock_space_kind_t kind;
+        XrReferenceSpaceType reference_type;
+        int hand;
+};
+
+struct mock_action_t {
+        XrActionType type;
+};
+
+struct mock_swapchain_t {
+        uint32_t images[MOCK_SWAPCHAIN_LENGTH];
+        uint32_t next_image;
+        uint32_t array_size;
+        bool is_live;
+};
+
+struct mock_t {
+        pthread_mutex_t lock;
+        pthread_cond_t frame_cond; // Signalled when a frame begins or the session ends
+        xr_mock_config_t config;
+        bool is_configured;
+
+        bool is_instance;
+        bool is_session;
+        bool is_session_running;
+        XrSessionState session_state;
+
+        char paths[MOCK_MAX_PATHS][XR_MAX_PATH_LENGTH];
+        int path_count;
+        XrPath hand_paths[2];
+
+        mock_action_t actions[MOCK_MAX_ACTIONS];
+        int action_count;
+
+        mock_space_t spaces[MOCK_MAX_SPACES];
+        int space_count;
+
+        mock_swapchain_t swapchains[MOCK_MAX_SWAPCHAINS];
+        int swapchain_count;
+
+        // Frame timing and ordering, waits and begins are counted from xrBeginSession
+        int64_t frames_waited;
+        int64_t frames_begun;
+        bool is_frame_begun;
+        int64_t frames_ended;
+        int64_t frames_waited_total; // Unlike frames_waited, not reset by xrBeginSession
+        XrTime next_display_time;
+        XrTime sync_time;
+        bool is_clicked[2];           // Trigger click state at the last sync
+        bool is_click_changed[2];
+        XrTime click_change_times[2];
+        int next_state_event;
+        XrTime session_create_time;
+};
+
+static mock_t mock = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static XrTime mock_now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (XrTime)ts.tv_sec * 1000000000ll + (XrTime)ts.tv_nsec;
+}
+
+static void mock_sleep_until(XrTime time) {
+        struct timespec ts;
+        ts.tv_sec = time / 1000000000ll;
+        ts.tv_nsec = time % 1000000000ll;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}
+}
+
+static void mock_quat_from_yaw_pitch(float yaw, float pitch, XrQuaternionf *q) {
+        // yaw about y, then pitch about x
+        float cy = cosf(yaw * 0.5f), sy = sinf(yaw * 0.5f);
+        float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+        q->x = cy * sp;
+        q->y = sy * cp;
+        q->z = -sy * sp;
+        q->w = cy * cp;
+}
+
+static void mock_rotate(const XrQuaternionf *q, const XrVector3f *v, XrVector3f *out) {
+        // v + 2w(q x v) + 2(q x (q x v))
+        float tx = 2.0f * (q->y * v->z - q->z * v->y);
+        float ty = 2.0f * (q->z * v->x - q->x * v->z);
+        float tz = 2.0f * (q->x * v->y - q->y * v->x);
+        out->x = v->x + q->w * tx + (q->y * tz - q->z * ty);
+        out->y = v->y + q->w * ty + (q->z * tx - q->x * tz);
+        out->z = v->z + q->w * tz + (q->x * ty - q->y * tx);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFAULT SCRIPT
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void mock_default_head_pose(XrTime time, XrPosef *pose) {
+        float t = (float)(time % 1000000000000ll) * 1e-9f;
+        mock_quat_from_yaw_pitch(0.3f * sinf(0.5f * t), 0.1f * sinf(0.3f * t), &pose->orientation);
+        pose->position = { 0.0f, 1.6f, 0.0f };
+}
+
+static void mock_default_hand_pose(int hand, XrTime time, XrPosef *pose) {
+        float t = (float)(time % 1000000000000ll) * 1e-9f;
+        float side = hand == 0 ? -1.0f : 1.0f;
+        mock_quat_from_yaw_pitch(side * 0.5f * t, 0.4f * sinf(t), &pose->orientation);
+        pose->position = { side * 0.25f, 1.2f + 0.05f * sinf(2.0f * t + side), -0.4f + 0.1f * cosf(t) };
+}
+
+static float mock_default_trigger_value(int hand, XrTime time) {
+        // A 4ms tap on the left trigger at the top of every second, shorter than a display period
+        if (hand == 0 && time % 1000000000ll < 4000000ll) { return 1.0f; }
+        float t = (float)(time % 1000000000000ll) * 1e-9f;
+        return 0.5f + 0.5f * sinf(1.5f * t + (float)hand);
+}
+
+void xr_mock_default_config(xr_mock_config_t *config, int64_t frame_count) {
+        memset(config, 0, sizeof(*config));
+        config->display_period_ns = 1000000000ll / 72;
+        config->is_throttled = true;
+        config->view_width = 1440;
+        config->view_height = 1584;
+        config->is_locate_spaces = true;
+        config->head_pose = mock_default_head_pose;
+        config->hand_pose = mock_default_hand_pose;
+        config->trigger_value = mock_default_trigger_value;
+
+        xr_mock_state_event_t events[] = {
+                { 0, XR_SESSION_STATE_IDLE },
+                { 0, XR_SESSION_STATE_READY },
+                { 1, XR_SESSION_STATE_SYNCHRONIZED },
+                { 2, XR_SESSION_STATE_VISIBLE },
+                { 3, XR_SESSION_STATE_FOCUSED },
+                { frame_count, XR_SESSION_STATE_VISIBLE },
+                { frame_count, XR_SESSION_STATE_SYNCHRONIZED },
+                { frame_count, XR_SESSION_STATE_STOPPING },
+                { frame_count, XR_SESSION_STATE_IDLE },
+                { frame_count, XR_SESSION_STATE_EXITING },
+        };
+        config->state_event_count = frame_count > 0 ? 10 : 5;
+        memcpy(config->state_events, events, config->state_event_count * sizeof(events[0]));
+}
+
+void xr_mock_configure(const xr_mock_config_t *config) {
+        pthread_mutex_lock(&mock.lock);
+        mock.config = *config;
+        mock.is_configured = true;
+        pthread_mutex_unlock(&mock.lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// HELPERS
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The two call idiom: report the count, or fill the caller's array if it's big enough
+#define MOCK_ENUMERATE(capacity, count_out, items, count, fill)                                   \
+        do {                                                                                       \
+                *(count_out) = (count);                                                            \
+                if ((capacity) == 0) { return XR_SUCCESS; }                                        \
+                if ((capacity) < (uint32_t)(count)) { return XR_ERROR_SIZE_INSUFFICIENT; }         \
+                for (uint32_t i = 0; i < (uint32_t)(count); i++) { fill; }                         \
+        } while (0)
+
+// An init time call's round trip to the runtime, see call_latency_ns. Never under mock.lock, so
+// calls from different threads overlap like they would with a real runtime.
+static void mock_call_latency() {
+        if (mock.config.call_latency_ns > 0) {
+                mock_sleep_until(mock_now() + mock.config.call_latency_ns);
+        }
+}
+
+static int mock_hand_from_path(XrPath path) {
+        if (path == mock.hand_paths[0]) { return 0; }
+        if (path == mock.hand_paths[1]) { return 1; }
+        return -1;
+}
+
+static void mock_locate_view(int eye, XrTime time, XrPosef *pose) {
+        XrPosef head;
+        mock.config.head_pose(time, &head);
+        XrVector3f offset = { (eye == 0 ? -0.5f : 0.5f) * MOCK_IPD, 0.0f, 0.0f };
+        XrVector3f rotated;
+        mock_rotate(&head.orientation, &offset, &rotated);
+        pose->orientation = head.orientation;
+        pose->position.x = head.position.x + rotated.x;
+        pose->position.y = head.position.y + rotated.y;
+        pose->position.z = head.position.z + rotated.z;
+}
+
+static void mock_locate(const mock_space_t *space, XrTime time, XrPosef *pose) {
+        if (space->kind == MOCK_SPACE_ACTION) {
+                mock.config.hand_pose(space->hand, time, pose);
+        } else if (space->reference_type == XR_REFERENCE_SPACE_TYPE_VIEW) {
+                mock.config.head_pose(time, pose);
+        } else {
+                *pose = { { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+        }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// INSTANCE AND SYSTEM
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static XRAPI_ATTR XrResult XRAPI_CALL mock_initialize_loader(const XrLoaderInitInfoBaseHeaderKHR *info) {
+        mock_call_latency();
+        return XR_SUCCESS;
+}
+
+static XRAPI_ATTR XrResult XRAPI_CALL mock_get_gles_requirements(XrInstance instance, XrSystemId system, XrGraphicsRequirementsOpenGLESKHR *reqs) {
+        reqs->minApiVersionSupported = XR_MAKE_VERSION(3, 0, 0);
+        reqs->maxApiVersionSupported = XR_MAKE_VERSION(3, 2, 0);
+        return XR_SUCCESS;
+}
+
+static XRAPI_ATTR XrResult XRAPI_CALL mock_locate_spaces(XrSession session, const XrSpacesLocateInfoKHR *info, XrSpaceLocationsKHR *locations);
+
+XRAPI_ATTR XrResult XRAPI_CALL xrGetInstanceProcAddr(XrInstance instance, const char *name, PFN_xrVoidFunction *function) {
+        *function = NULL;
+        if (!strcmp(name, "xrInitializeLoaderKHR")) {
+                *function = (PFN_xrVoidFunction)mock_initialize_loader;
+        } else if (!strcmp(name, "xrGetOpenGLESGraphicsRequirementsKHR")) {
+                *function = (PFN_xrVoidFunction)mock_get_gles_requirements;
+        } else if (!strcmp(name, "xrLocateSpacesKHR") && mock.config.is_locate_spaces) {
+                *function = (PFN_xrVoidFunction)mock_locate_spaces;
+        }
+        return *function ? XR_SUCCESS : XR_ERROR_FUNCTION_UNSUPPORTED;
+}
+
+// Optional extensions go last, so turning one off just shortens the list
+static const char *mock_extensions[] = {
+        XR_KHR_OPENGL_ES_ENABLE_EXTENSION_NAME,
+        XR_MNDX_EGL_ENABLE_EXTENSION_NAME,
+        XR_KHR_LOCATE_SPACES_EXTENSION_NAME,
+};
+
+XRAPI_ATTR XrResult XRAPI_CALL xrEnumerateInstanceExtensionProperties(const char *layer, uint32_t capacity, uint32_t *count, XrExtensionProperties *props) {
+        mock_call_latency();
+        uint32_t extension_count = sizeof(mock_extensions) / sizeof(mock_extensions[0]);
+        if (mock.is_configured && !mock.config.is_locate_spaces) { extension_count--; }
+        MOCK_ENUMERATE(capacity, count, props, extension_count, {
+                strcpy(props[i].extensionName, mock_extensions[i]);
+                props[i].extensionVersion = 1;
+        });
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrEnumerateApiLayerProperties(uint32_t capacity, uint32_t *count, XrApiLayerProperties *props) {
+        mock_call_latency();
+        *count = 0;
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrCreateInstance(const XrInstanceCreateInfo *info, XrInstance *instance) {
+        mock_call_latency();
+        pthread_mutex_lock(&mock.lock);
+        if (!mock.is_configured) {
+                xr_mock_default_config(&mock.config, 0);
+                mock.is_configured = true;
+        }
+        mock.is_instance = true;
+        *instance = MOCK_HANDLE(XrInstance, 0);
+        pthread_mutex_unlock(&mock.lock);
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrDestroyInstance(XrInstance instance) {
+        pthread_mutex_lock(&mock.lock);
+        mock.is_instance = false;
+        pthread_mutex_unlock(&mock.lock);
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrGetInstanceProperties(XrInstance instance, XrInstanceProperties *props) {
+        mock_call_latency();
+        strcpy(props->runtimeName, "Mock Runtime");
+        props->runtimeVersion = XR_MAKE_VERSION(0, 1, 0);
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrGetSystem(XrInstance instance, const XrSystemGetInfo *info, XrSystemId *system) {
+        mock_call_latency();
+        if (info->formFactor != XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY) { return XR_ERROR_FORM_FACTOR_UNSUPPORTED; }
+        *system = 1;
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrGetSystemProperties(XrInstance instance, XrSystemId system, XrSystemProperties *props) {
+        mock_call_latency();
+        props->systemId = system;
+        props->vendorId = 0;
+        strcpy(props->systemName, "Mock HMD");
+        props->graphicsProperties.maxLayerCount = 16;
+        props->graphicsProperties.maxSwapchainImageWidth = 4096;
+        props->graphicsProperties.maxSwapchainImageHeight = 4096;
+        props->trackingProperties.orientationTracking = XR_TRUE;
+        props->trackingProperties.positionTracking = XR_TRUE;
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrEnumerateViewConfigurationViews(XrInstance instance, XrSystemId system, XrViewConfigurationType type, uint32_t capacity, uint32_t *count, XrViewConfigurationView *views) {
+        mock_call_latency();
+        if (type != XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO) { return XR_ERROR_VIEW_CONFIGURATION_TYPE_UNSUPPORTED; }
+        MOCK_ENUMERATE(capacity, count, views, MOCK_VIEW_COUNT, {
+                views[i].recommendedImageRectWidth = mock.config.view_width;
+                views[i].maxImageRectWidth = 4096;
+                views[i].recommendedImageRectHeight = mock.config.view_height;
+                views[i].maxImageRectHeight = 4096;
+                views[i].recommendedSwapchainSampleCount = 1;
+                views[i].maxSwapchainSampleCount = 1;
+        });
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrStringToPath(XrInstance instance, const char *string, XrPath *path) {
+        mock_call_latency();
+        pthread_mutex_lock(&mock.lock);
+        XrResult result = XR_SUCCESS;
+        int index = -1;
+        for (int i = 0; i < mock.path_count; i++) {
+                if (!strcmp(mock.paths[i], string)) { index = i; }
+        }
+        if (index < 0 && mock.path_count < MOCK_MAX_PATHS) {
+                index = mock.path_count++;
+                strncpy(mock.paths[index], string, XR_MAX_PATH_LENGTH - 1);
+        }
+        if (index < 0) {
+                result = XR_ERROR_PATH_COUNT_EXCEEDED;
+        } else {
+                *path = (XrPath)(index + 1);
+                if (!strcmp(string, "/user/hand/left")) { mock.hand_paths[0] = *path; }
+                if (!strcmp(string, "/user/hand/right")) { mock.hand_paths[1] = *path; }
+        }
+        pthread_mutex_unlock(&mock.lock);
+        return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SESSION
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XRAPI_ATTR XrResult XRAPI_CALL xrCreateSession(XrInstance instance, const XrSessionCreateInfo *info, XrSession *session) {
+        mock_call_latency();
+        pthread_mutex_lock(&mock.lock);
+        mock.is_session = true;
+        mock.session_state = XR_SESSION_STATE_UNKNOWN;
+        mock.frames_ended = 0;
+        mock.frames_waited_total = 0;
+        mock.next_state_event = 0;
+        mock.session_create_time = mock_now();
+        *session = MOCK_HANDLE(XrSession, 0);
+        pthread_mutex_unlock(&mock.lock);
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrDestroySession(XrSession session) {
+        pthread_mutex_lock(&mock.lock);
+        mock.is_session = false;
+        pthread_mutex_unlock(&mock.lock);
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrBeginSession(XrSession session, const XrSessionBeginInfo *info) {
+        pthread_mutex_lock(&mock.lock);
+        XrResult result = XR_SUCCESS;
+        if (mock.is_session_running) {
+                result = XR_ERROR_SESSION_RUNNING;
+        } else if (mock.session_state != XR_SESSION_STATE_READY) {
+                result = XR_ERROR_SESSION_NOT_READY;
+        } else {
+                mock.is_session_running = true;
+                mock.next_display_time = 0;
+                mock.frames_waited = 0;
+                mock.frames_begun = 0;
+                mock.is_frame_begun = false;
+        }
+        pthread_mutex_unlock(&mock.lock);
+        return result;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrEndSession(XrSession session) {
+        pthread_mutex_lock(&mock.lock);
+        XrResult result = XR_SUCCESS;
+        if (!mock.is_session_running) {
+                result = XR_ERROR_SESSION_NOT_RUNNING;
+        } else if (mock.session_state != XR_SESSION_STATE_STOPPING) {
+                result = XR_ERROR_SESSION_NOT_STOPPING;
+        } else {
+                mock.is_session_running = false;
+                pthread_cond_broadcast(&mock.frame_cond);
+        }
+        pthread_mutex_unlock(&mock.lock);
+        return result;
+}
+
+// Replaces the rest of the script with the usual wind down, starting on the next poll
+XRAPI_ATTR XrResult XRAPI_CALL xrRequestExitSession(XrSession session) {
+        pthread_mutex_lock(&mock.lock);
+        XrResult result = XR_SUCCESS;
+        if (!mock.is_session_running) {
+                result = XR_ERROR_SESSION_NOT_RUNNING;
+        } else {
+                // Step down from wherever the session is now, then stop and exit
+                xr_mock_state_event_t *events = mock.config.state_events;
+                int count = 0;
+                if (mock.session_state == XR_SESSION_STATE_FOCUSED) {
+                        events[count++] = { mock.frames_ended, XR_SESSION_STATE_VISIBLE };
+                }
+                if (mock.session_state == XR_SESSION_STATE_FOCUSED || mock.session_state == XR_SESSION_STATE_VISIBLE) {
+                        events[count++] = { mock.frames_ended, XR_SESSION_STATE_SYNCHRONIZED };
+                }
+                events[count++] = { mock.frames_ended, XR_SESSION_STATE_STOPPING };
+                events[count++] = { mock.frames_ended, XR_SESSION_STATE_IDLE };
+                events[count++] = { mock.frames_ended, XR_SESSION_STATE_EXITING };
+                mock.config.state_event_count = count;
+                mock.next_state_event = 0;
+        }
+        pthread_mutex_unlock(&mock.lock);
+        return result;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrPollEvent(XrInstance instance, XrEventDataBuffer *event) {
+        pthread_mutex_lock(&mock.lock);
+        XrResult result = XR_EVENT_UNAVAILABLE;
+        if (mock.is_session && mock.next_state_event < mock.config.state_event_count) {
+                const xr_mock_state_event_t *next = &mock.config.state_events[mock.next_state_event];
+
+                // Hold the script until the app has responded to READY and STOPPING
+                bool is_blocked = (mock.session_state == XR_SESSION_STATE_READY && !mock.is_session_running) ||
+                                  (mock.session_state == XR_SESSION_STATE_STOPPING && mock.is_session_running);
+                if (next->state == XR_SESSION_STATE_READY && mock_now() < mock.session_create_time + mock.config.ready_delay_ns) {
+                        is_blocked = true;
+                }
+                int64_t frames = mock.config.is_script_on_wait ? mock.frames_waited_total : mock.frames_ended;
+                if (next->frame <= frames && !is_blocked) {
+                        XrEventDataSessionStateChanged *changed = (XrEventDataSessionStateChanged *)event;
+                        changed->type = XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED;
+                        changed->next = NULL;
+                        changed->session = MOCK_HANDLE(XrSession, 0);
+                        changed->state = next->state;
+                        changed->time = mock_now();
+                        mock.session_state = next->state;
+                        mock.next_state_event++;
+                        result = XR_SUCCESS;
+                }
+        }
+        pthread_mutex_unlock(&mock.lock);
+        return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SPACES
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const XrReferenceSpaceType mock_reference_spaces[] = {
+        XR_REFERENCE_SPACE_TYPE_VIEW,
+        XR_REFERENCE_SPACE_TYPE_LOCAL,
+        XR_REFERENCE_SPACE_TYPE_STAGE,
+};
+
+XRAPI_ATTR XrResult XRAPI_CALL xrEnumerateReferenceSpaces(XrSession session, uint32_t capacity, uint32_t *count, XrReferenceSpaceType *spaces) {
+        mock_call_latency();
+        MOCK_ENUMERATE(capacity, count, spaces, 3, spaces[i] = mock_reference_spaces[i]);
+        return XR_SUCCESS;
+}
+
+static XrResult mock_create_space(mock_space_t space, XrSpace *handle) {
+        mock_call_latency();
+        pthread_mutex_lock(&mock.lock);
+        XrResult result = XR_ERROR_LIMIT_REACHED;
+        if (mock.space_count < MOCK_MAX_SPACES) {
+                mock.spaces[mock.space_count] = space;
+                *handle = MOCK_HANDLE(XrSpace, mock.space_count);
+                mock.space_count++;
+                result = XR_SUCCESS;
+        }
+        pthread_mutex_unlock(&mock.lock);
+        return result;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrCreateReferenceSpace(XrSession session, const XrReferenceSpaceCreateInfo *info, XrSpace *space) {
+        mock_space_t s = { MOCK_SPACE_REFERENCE, info->referenceSpaceType, -1 };
+        return mock_create_space(s, space);
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrCreateActionSpace(XrSession session, const XrActionSpaceCreateInfo *info, XrSpace *space) {
+        int hand = mock_hand_from_path(info->subactionPath);
+        if (hand < 0) { return XR_ERROR_PATH_UNSUPPORTED; }
+        mock_space_t s = { MOCK_SPACE_ACTION, XR_REFERENCE_SPACE_TYPE_VIEW, hand };
+        return mock_create_space(s, space);
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrDestroySpace(XrSpace space) {
+        return XR_SUCCESS;
+}
+
+// Every space is located relative to the stage, base spaces other than the stage aren't supported
+XRAPI_ATTR XrResult XRAPI_CALL xrLocateSpace(XrSpace space, XrSpace base, XrTime time, XrSpaceLocation *location) {
+        int index = MOCK_INDEX(space);
+        if (index < 0 || index >= mock.space_count) { return XR_ERROR_HANDLE_INVALID; }
+        mock_locate(&mock.spaces[index], time, &location->pose);
+        location->locationFlags = XR_SPACE_LOCATION_ORIENTATION_VALID_BIT | XR_SPACE_LOCATION_POSITION_VALID_BIT |
+                                  XR_SPACE_LOCATION_ORIENTATION_TRACKED_BIT | XR_SPACE_LOCATION_POSITION_TRACKED_BIT;
+        return XR_SUCCESS;
+}
+
+// XR_KHR_locate_spaces, the same as xrLocateSpace for each space in turn
+static XRAPI_ATTR XrResult XRAPI_CALL mock_locate_spaces(XrSession session, const XrSpacesLocateInfoKHR *info, XrSpaceLocationsKHR *locations) {
+        if (locations->locationCount != info->spaceCount) { return XR_ERROR_VALIDATION_FAILURE; }
+        for (uint32_t i = 0; i < info->spaceCount; i++) {
+                XrSpaceLocation location = { XR_TYPE_SPACE_LOCATION };
+                XrResult result = xrLocateSpace(info->spaces[i], info->baseSpace, info->time, &location);
+                if (XR_FAILED(result)) { return result; }
+                locations->locations[i].locationFlags = location.locationFlags;
+                locations->locations[i].pose = location.pose;
+        }
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrLocateViews(XrSession session, const XrViewLocateInfo *info, XrViewState *state, uint32_t capacity, uint32_t *count, XrView *views) {
+        state->viewStateFlags = XR_VIEW_STATE_ORIENTATION_VALID_BIT | XR_VIEW_STATE_POSITION_VALID_BIT |
+                                XR_VIEW_STATE_ORIENTATION_TRACKED_BIT | XR_VIEW_STATE_POSITION_TRACKED_BIT;
+        MOCK_ENUMERATE(capacity, count, views, MOCK_VIEW_COUNT, {
+                mock_locate_view(i, info->displayTime, &views[i].pose);
+                views[i].fov.angleLeft = i == 0 ? -0.942f : -0.698f;
+                views[i].fov.angleRight = i == 0 ? 0.698f : 0.942f;
+                views[i].fov.angleUp = 0.768f;
+                views[i].fov.angleDown = -0.872f;
+        });
+        return XR_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// ACTIONS
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XRAPI_ATTR XrResult XRAPI_CALL xrCreateActionSet(XrInstance instance, const XrActionSetCreateInfo *info, XrActionSet *action_set) {
+        mock_call_latency();
+        *action_set = MOCK_HANDLE(XrActionSet, 0);
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrCreateAction(XrActionSet action_set, const XrActionCreateInfo *info, XrAction *action) {
+        mock_call_latency();
+        pthread_mutex_lock(&mock.lock);
+        XrResult result = XR_ERROR_LIMIT_REACHED;
+        if (mock.action_count < MOCK_MAX_ACTIONS) {
+                mock.actions[mock.action_count].type = info->actionType;
+                *action = MOCK_HANDLE(XrAction, mock.action_count);
+                mock.action_count++;
+                result = XR_SUCCESS;
+        }
+        pthread_mutex_unlock(&mock.lock);
+        return result;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrSuggestInteractionProfileBindings(XrInstance instance, const XrInteractionProfileSuggestedBinding *bindings) {
+        mock_call_latency();
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrAttachSessionActionSets(XrSession session, const XrSessionActionSetsAttachInfo *info) {
+        mock_call_latency();
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrSyncActions(XrSession session, const XrActionsSyncInfo *info) {
+        pthread_mutex_lock(&mock.lock);
+        mock.sync_time = mock_now();
+        for (int hand = 0; hand < 2; hand++) {
+                bool is_clicked = mock.config.trigger_value(hand, mock.sync_time) > 0.5f;
+                mock.is_click_changed[hand] = is_clicked != mock.is_clicked[hand];
+                if (mock.is_click_changed[hand]) { mock.click_change_times[hand] = mock.sync_time; }
+                mock.is_clicked[hand] = is_clicked;
+        }
+        XrResult result = mock.session_state == XR_SESSION_STATE_FOCUSED ? XR_SUCCESS : XR_SESSION_NOT_FOCUSED;
+        pthread_mutex_unlock(&mock.lock);
+        return result;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrGetActionStateFloat(XrSession session, const XrActionStateGetInfo *info, XrActionStateFloat *state) {
+        int hand = mock_hand_from_path(info->subactionPath);
+        if (hand < 0) { return XR_ERROR_PATH_UNSUPPORTED; }
+        pthread_mutex_lock(&mock.lock);
+        state->currentState = mock.config.trigger_value(hand, mock.sync_time);
+        state->changedSinceLastSync = XR_TRUE;
+        state->lastChangeTime = mock.sync_time;
+        state->isActive = XR_TRUE;
+        pthread_mutex_unlock(&mock.lock);
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrGetActionStateBoolean(XrSession session, const XrActionStateGetInfo *info, XrActionStateBoolean *state) {
+        int hand = mock_hand_from_path(info->subactionPath);
+        if (hand < 0) { return XR_ERROR_PATH_UNSUPPORTED; }
+        pthread_mutex_lock(&mock.lock);
+        state->currentState = mock.is_clicked[hand];
+        state->changedSinceLastSync = mock.is_click_changed[hand];
+        state->lastChangeTime = mock.click_change_times[hand];
+        state->isActive = XR_TRUE;
+        pthread_mutex_unlock(&mock.lock);
+        return XR_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SWAPCHAINS
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const int64_t mock_swapchain_formats[] = { GL_SRGB8_ALPHA8, GL_RGBA8 };
+
+XRAPI_ATTR XrResult XRAPI_CALL xrEnumerateSwapchainFormats(XrSession session, uint32_t capacity, uint32_t *count, int64_t *formats) {
+        mock_call_latency();
+        MOCK_ENUMERATE(capacity, count, formats, 2, formats[i] = mock_swapchain_formats[i]);
+        return XR_SUCCESS;
+}
+
+// Needs the app's GL context current on the calling thread
+XRAPI_ATTR XrResult XRAPI_CALL xrCreateSwapchain(XrSession session, const XrSwapchainCreateInfo *info, XrSwapchain *swapchain) {
+        mock_call_latency();
+        pthread_mutex_lock(&mock.lock);
+        int index = -1;
+        for (int i = 0; i < mock.swapchain_count; i++) {
+                if (!mock.swapchains[i].is_live) { index = i; }
+        }
+        if (index < 0 && mock.swapchain_count < MOCK_MAX_SWAPCHAINS) {
+                index = mock.swapchain_count++;
+        }
+        if (index < 0) {
+                pthread_mutex_unlock(&mock.lock);
+                return XR_ERROR_LIMIT_REACHED;
+        }
+
+        mock_swapchain_t *s = &mock.swapchains[index];
+        s->is_live = true;
+        s->next_image = 0;
+        s->array_size = info->arraySize;
+        glGenTextures(MOCK_SWAPCHAIN_LENGTH, s->images);
+        for (int i = 0; i < MOCK_SWAPCHAIN_LENGTH; i++) {
+                if (info->arraySize > 1) {
+                        glBindTexture(GL_TEXTURE_2D_ARRAY, s->images[i]);
+                        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, (GLenum)info->format, info->width, info->height, info->arraySize);
+                } else {
+                        glBindTexture(GL_TEXTURE_2D, s->images[i]);
+                        glTexStorage2D(GL_TEXTURE_2D, 1, (GLenum)info->format, info->width, info->height);
+                }
+        }
+        *swapchain = MOCK_HANDLE(XrSwapchain, index);
+        pthread_mutex_unlock(&mock.lock);
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrDestroySwapchain(XrSwapchain swapchain) {
+        pthread_mutex_lock(&mock.lock);
+        mock_swapchain_t *s = &mock.swapchains[MOCK_INDEX(swapchain)];
+        glDeleteTextures(MOCK_SWAPCHAIN_LENGTH, s->images);
+        s->is_live = false;
+        pthread_mutex_unlock(&mock.lock);
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrEnumerateSwapchainImages(XrSwapchain swapchain, uint32_t capacity, uint32_t *count, XrSwapchainImageBaseHeader *images) {
+        mock_call_latency();
+        mock_swapchain_t *s = &mock.swapchains[MOCK_INDEX(swapchain)];
+        XrSwapchainImageOpenGLESKHR *gles_images = (XrSwapchainImageOpenGLESKHR *)images;
+        MOCK_ENUMERATE(capacity, count, images, MOCK_SWAPCHAIN_LENGTH, gles_images[i].image = s->images[i]);
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrAcquireSwapchainImage(XrSwapchain swapchain, const XrSwapchainImageAcquireInfo *info, uint32_t *index) {
+        mock_swapchain_t *s = &mock.swapchains[MOCK_INDEX(swapchain)];
+        *index = s->next_image;
+        s->next_image = (s->next_image + 1) % MOCK_SWAPCHAIN_LENGTH;
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrWaitSwapchainImage(XrSwapchain swapchain, const XrSwapchainImageWaitInfo *info) {
+        return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrReleaseSwapchainImage(XrSwapchain swapchain, const XrSwapchainImageReleaseInfo *info) {
+        return XR_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// FRAMES
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Like a real runtime, a wait blocks until the frame from the previous wait has begun, so only one
+// frame can be waited on ahead of the frame being rendered
+XRAPI_ATTR XrResult XRAPI_CALL xrWaitFrame(XrSession session, const XrFrameWaitInfo *info, XrFrameState *state) {
+        pthread_mutex_lock(&mock.lock);
+        while (mock.is_session_running && mock.frames_waited > mock.frames_begun) {
+                pthread_cond_wait(&mock.frame_cond, &mock.lock);
+        }
+        if (!mock.is_session_running) {
+                pthread_mutex_unlock(&mock.lock);
+                return XR_ERROR_SESSION_NOT_RUNNING;
+        }
+        int64_t period = mock.config.display_period_ns;
+        bool is_throttled = mock.config.is_throttled;
+        XrTime now = mock_now();
+        if (mock.next_display_time == 0) {
+                mock.next_display_time = now + period;
+        }
+
+        // Missed display times are skipped, like a real compositor would
+        while (mock.next_display_time < now) {
+                mock.next_display_time += period;
+        }
+        mock.frames_waited++;
+        mock.frames_waited_total++;
+        XrTime wake_time = mock.next_display_time - period;
+        XrTime display_time = mock.next_display_time;
+        mock.next_display_time += period;
+        bool should_render = mock.session_state == XR_SESSION_STATE_VISIBLE || mock.session_state == XR_SESSION_STATE_FOCUSED;
+        pthread_mutex_unlock(&mock.lock);
+
+        if (is_throttled && wake_time > now) {
+                mock_sleep_until(wake_time);
+        }
+
+        state->predictedDisplayTime = is_throttled ? display_time : mock_now() + period;
+        state->predictedDisplayPeriod = period;
+        state->shouldRender = should_render ? XR_TRUE : XR_FALSE;
+        return XR_SUCCESS;
+}
+
+// Begins the frame from the last wait. Beginning again without ending discards the previous frame.
+XRAPI_ATTR XrResult XRAPI_CALL xrBeginFrame(XrSession session, const XrFrameBeginInfo *info) {
+        pthread_mutex_lock(&mock.lock);
+        XrResult result = XR_SUCCESS;
+        if (!mock.is_session_running) {
+                result = XR_ERROR_SESSION_NOT_RUNNING;
+        } else if (mock.frames_begun == mock.frames_waited) {
+                result = XR_ERROR_CALL_ORDER_INVALID;
+        } else {
+                result = mock.is_frame_begun ? XR_FRAME_DISCARDED : XR_SUCCESS;
+                mock.frames_begun++;
+                mock.is_frame_begun = true;
+                pthread_cond_broadcast(&mock.frame_cond);
+        }
+        pthread_mutex_unlock(&mock.lock);
+        return result;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL xrEndFrame(XrSession session, const XrFrameEndInfo *info) {
+        pthread_mutex_lock(&mock.lock);
+        XrResult result = XR_SUCCESS;
+        if (!mock.is_session_running) {
+                result = XR_ERROR_SESSION_NOT_RUNNING;
+        } else if (!mock.is_frame_begun) {
+                result = XR_ERROR_CALL_ORDER_INVALID;
+        } else if (info->layerCount > 0 && info->layers == NULL) {
+                result = XR_ERROR_VALIDATION_FAILURE;
+        } else {
+                mock.is_frame_begun = false;
+                mock.frames_ended++;
+        }
+        pthread_mutex_unlock(&mock.lock);
+        return result;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// MOCK OPENXR RUNTIME
+//
+// An in-process stand-in for the OpenXR loader, implementing just the subset of OpenXR that
+// `src/main.cpp` uses, so the whole init and frame loop can run on a Linux host against a software
+// GLES context. Link `src/xr_mock.cpp` instead of `libopenxr_loader.so` and build with -DXR_MOCK.
+//
+// Swapchain images are real GL textures, so the runtime expects the app's GL context to be current
+// on the thread that creates swapchains. Every function can be called from any thread, and the
+// frame functions enforce the spec's ordering: xrWaitFrame blocks until the previous wait's frame has
+// begun, and xrBeginFrame/xrEndFrame fail with XR_ERROR_CALL_ORDER_INVALID when out of order.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+
+#include "openxr/openxr.h"
+
+// A session state change, fired once the app has ended `frame` frames (or waited on them, see
+// is_script_on_wait)
+struct xr_mock_state_event_t {
+        int64_t frame;
+        XrSessionState state;
+};
+
+#define XR_MOCK_MAX_STATE_EVENTS (32)
+
+struct xr_mock_config_t {
+        // Display timing, xrWaitFrame sleeps until the next period boundary unless unthrottled
+        int64_t display_period_ns;
+        bool is_throttled;
+
+        // Per view swapchain size reported by xrEnumerateViewConfigurationViews
+        uint32_t view_width;
+        uint32_t view_height;
+
+        // Advertise XR_KHR_locate_spaces, turn off to exercise the app's xrLocateSpace fallback
+        bool is_locate_spaces;
+
+        // Scripted poses and inputs, all in stage space at the given time
+        void (*head_pose)(XrTime time, XrPosef *pose);
+        void (*hand_pose)(int hand, XrTime time, XrPosef *pose);
+        float (*trigger_value)(int hand, XrTime time);
+
+        // Scripted session state transitions, in order
+        xr_mock_state_event_t state_events[XR_MOCK_MAX_STATE_EVENTS];
+        int state_event_count;
+
+        // Count the script's frames in xrWaitFrame calls rather than xrEndFrame calls. The app's
+        // main thread knows exactly how many frames it has waited on when it polls, so a replayed
+        // script then fires between the same two frames it was recorded between.
+        bool is_script_on_wait;
+
+        // Hold the first READY back until this long after xrCreateSession, like a runtime waiting for
+        // the headset to be put on, so the app sits idle without a session in the meantime
+        int64_t ready_delay_ns;
+
+        // Sleep this long in each init time call (creating the instance, session, spaces, actions
+        // and swapchains, enumerating what they need), like a real runtime's IPC round trips to the
+        // compositor, so how the app overlaps its init shows on the host. 0 returns straight away.
+        int64_t call_latency_ns;
+};
+
+// Fills in a 72Hz, throttled config with animated hands and head, and triggers that sweep slowly
+// plus a tap on the left one every second that's shorter than a frame. The session goes through
+// the usual IDLE -> READY -> ... -> FOCUSED states, renders frame_count frames, then stops and exits
+void xr_mock_default_config(xr_mock_config_t *config, int64_t frame_count);
+
+// Must be called before xrCreateInstance, otherwise the default config with no exit is used
+void xr_mock_configure(const xr_mock_config_t *config);